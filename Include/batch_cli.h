@@ -0,0 +1,87 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef BATCH_CLI_H_
+#define BATCH_CLI_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "currency_rate_aggregation.h"
+#include "currency_rate_resample.h"
+
+struct BatchOptions {
+  std::vector<std::string> load_files;
+  std::vector<std::string> load_directories;
+  std::string load_pattern = "*";
+  std::string filter;
+  std::string sort;  // "date" or "currency"
+  size_t offset = 0;
+  size_t limit = SIZE_MAX;
+  bool newest_first = false;
+  bool aggregate = false;
+  AggregationBucket bucket = AggregationBucket::kDay;
+  bool resample = false;
+  std::string resample_from;
+  std::string resample_to;
+  ResampleCalendar calendar = ResampleCalendar::kWeekdays;
+  GapFill fill = GapFill::kForward;
+  // Lists cycles of same-day quotes gaining more than the threshold.
+  bool arbitrage = false;
+  double arbitrage_threshold = 0.0;
+  bool convert = false;
+  double amount = 0.0;
+  std::string convert_from;
+  std::string convert_to;
+  std::string convert_date;
+  std::string export_file;
+  // Files compared with --diff instead of loading rates.
+  std::string diff_before;
+  std::string diff_after;
+  double diff_tolerance = 0.0;
+  bool canonical_pairs = false;
+  // Read rates as exact decimals with this many digits; -1 uses doubles.
+  int fixed_scale = -1;
+  bool detect_format = false;
+  // Prometheus dump of the built-in metrics written on exit.
+  std::string metrics_file;
+  // Chrome trace of the run written on exit.
+  std::string trace_file;
+  // Soft memory limit of the repository in bytes; 0 means none.
+  size_t memory_budget = 0;
+  // Memory breakdown printed to stderr after loading.
+  bool memory_report = false;
+  // Server mode: keep the loaded repository resident and answer queries.
+  bool serve = false;
+  std::string socket_path;
+  uint16_t tcp_port = 0;
+  size_t server_threads = 4;
+  std::string append_log;
+  bool follow = false;
+  bool help = false;
+};
+
+// Non-interactive mode of currency_rate_manager driven by command-line
+// flags. Results are written through one large buffer instead of being
+// flushed line by line.
+class BatchCommandLine {
+public:
+  static constexpr int kExitOk = 0;
+  static constexpr int kExitUsage = 1;
+  static constexpr int kExitFailure = 2;
+  static constexpr int kExitNotFound = 3;
+
+  // Throws std::invalid_argument on unknown flags or missing values.
+  static BatchOptions Parse(const std::vector<std::string>& args);
+
+  static int Run(const BatchOptions& options, std::ostream& out,
+                 std::ostream& err);
+  static int Main(int argc, char** argv);
+
+  static void PrintUsage(std::ostream& out);
+};
+
+#endif  // BATCH_CLI_H_
@@ -0,0 +1,26 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_DATE_H_
+#define CURRENCY_DATE_H_
+
+#include <string>
+
+// Conversions between "YYYY.MM.DD" dates and serial day numbers
+// (days since 1970.01.01) for bucketing and calendar arithmetic.
+class CurrencyDate {
+public:
+  // Returns the day number of a date in "YYYY.MM.DD" format.
+  // Throws InvalidDateException if the string is not in that format.
+  static int ToDayNumber(const std::string& date);
+  static std::string FromDayNumber(int day_number);
+
+  static int FromCivil(int year, int month, int day);
+  static void ToCivil(int day_number, int* year, int* month, int* day);
+
+  // 0 = Monday ... 6 = Sunday.
+  static int DayOfWeek(int day_number);
+};
+
+#endif  // CURRENCY_DATE_H_
@@ -0,0 +1,48 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_PAIR_H_
+#define CURRENCY_PAIR_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+
+// Ordered pair of currency names (currency1/currency2) used as a key for
+// per-pair series, indexes and statistics.
+struct CurrencyPair {
+  std::string currency1;
+  std::string currency2;
+
+  CurrencyPair() = default;
+  CurrencyPair(std::string first, std::string second)
+      : currency1(std::move(first)), currency2(std::move(second)) {}
+
+  CurrencyPair Inverse() const { return CurrencyPair(currency2, currency1); }
+  std::string ToString() const { return currency1 + "/" + currency2; }
+
+  bool operator==(const CurrencyPair& other) const {
+    return currency1 == other.currency1 && currency2 == other.currency2;
+  }
+  bool operator!=(const CurrencyPair& other) const {
+    return !(*this == other);
+  }
+  bool operator<(const CurrencyPair& other) const {
+    if (currency1 != other.currency1) {
+      return currency1 < other.currency1;
+    }
+    return currency2 < other.currency2;
+  }
+};
+
+struct CurrencyPairHash {
+  size_t operator()(const CurrencyPair& pair) const {
+    size_t h1 = std::hash<std::string>()(pair.currency1);
+    size_t h2 = std::hash<std::string>()(pair.currency2);
+    return h1 ^ (h2 + 0x9e3779b97f4a7c15ULL + (h1 << 6) + (h1 >> 2));
+  }
+};
+
+#endif  // CURRENCY_PAIR_H_
@@ -6,8 +6,11 @@
 #define CURRENCY_RATE_H_
 
 #include <iostream>
+#include <optional>
 #include <string>
 
+#include "fixed_rate.h"
+
 class CurrencyRateException : public std::exception {
  public:
   explicit CurrencyRateException(const std::string& message)
@@ -42,27 +45,44 @@ class InvalidFormatException : public CurrencyRateException {
       : CurrencyRateException(message) {}
 };
 
+class InvalidFilterException : public CurrencyRateException {
+ public:
+  explicit InvalidFilterException(const std::string& message)
+      : CurrencyRateException(message) {}
+};
+
 class CurrencyRate {
  public:
   CurrencyRate(const std::string& currency1, const std::string& currency2,
                double rate, const std::string& date);
+  // Keeps the exact decimal rate next to its double value.
+  CurrencyRate(const std::string& currency1, const std::string& currency2,
+               const FixedRate& rate, const std::string& date);
 
   // Getters
-  std::string currency1() const { return currency1_; }
-  std::string currency2() const { return currency2_; }
+  const std::string& currency1() const { return currency1_; }
+  const std::string& currency2() const { return currency2_; }
   double rate() const { return rate_; }
-  std::string date() const { return date_; }
+  // Set when the rate was given in fixed point.
+  const std::optional<FixedRate>& fixed_rate() const { return fixed_rate_; }
+  const std::string& date() const { return date_; }
 
   // Formatting
   std::string ToString() const;
   std::string ToFileString() const;
 
+  // The same quote seen from the other side: currencies swapped and the
+  // rate inverted, in fixed point at the same scale when the rate is.
+  // Throws InvalidRateException if 1/rate is out of range.
+  CurrencyRate Inverse() const;
+
   // Validation
   void Validate() const;
   bool IsFutureDate() const;
   static bool IsValidDate(int year, int month, int day);
 
-  // Comparison operators
+  // Comparison operators. Rates compare exactly in fixed point when both
+  // records have one.
   bool operator<(const CurrencyRate& other) const;
   bool operator==(const CurrencyRate& other) const;
 
@@ -71,6 +91,7 @@ class CurrencyRate {
   std::string currency2_;
   double rate_;
   std::string date_;
+  std::optional<FixedRate> fixed_rate_;
 };
 
 std::ostream& operator<<(std::ostream& os, const CurrencyRate& rate);
@@ -0,0 +1,66 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_AGGREGATION_H_
+#define CURRENCY_RATE_AGGREGATION_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "currency_pair.h"
+#include "currency_rate.h"
+
+enum class AggregationBucket { kDay, kWeek, kMonth, kYear };
+
+// Inclusive date range in "YYYY.MM.DD" format. An empty bound is open.
+struct DateRange {
+  std::string from;
+  std::string to;
+
+  bool Contains(const std::string& date) const {
+    return (from.empty() || date >= from) && (to.empty() || date <= to);
+  }
+};
+
+// Selects currency pairs. An empty side matches any currency.
+struct PairFilter {
+  std::string currency1;
+  std::string currency2;
+
+  bool Matches(const CurrencyRate& rate) const {
+    return (currency1.empty() || rate.currency1() == currency1) &&
+           (currency2.empty() || rate.currency2() == currency2);
+  }
+};
+
+struct RateAggregate {
+  CurrencyPair pair;
+  // First day of the bucket; weeks start on Monday.
+  std::string bucket_start;
+  double open = 0.0;
+  double high = 0.0;
+  double low = 0.0;
+  double close = 0.0;
+  double mean = 0.0;
+  size_t count = 0;
+};
+
+class CurrencyRateAggregator {
+public:
+  // Groups matching rates by pair and date bucket. Open and close are the
+  // rates with the earliest and latest date in the bucket (ties resolved by
+  // insertion order). Results are ordered by pair, then by bucket start.
+  // Pairs are processed in parallel by up to |max_threads| workers
+  // (0 selects the hardware concurrency).
+  static std::vector<RateAggregate> Aggregate(
+      const std::vector<CurrencyRate>& rates, const PairFilter& pair_filter,
+      const DateRange& date_range, AggregationBucket bucket,
+      size_t max_threads = 0);
+
+  // Returns the first day of the bucket containing |day_number|.
+  static int BucketStart(int day_number, AggregationBucket bucket);
+};
+
+#endif  // CURRENCY_RATE_AGGREGATION_H_
@@ -0,0 +1,55 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_ARBITRAGE_H_
+#define CURRENCY_RATE_ARBITRAGE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "currency_rate.h"
+#include "currency_rate_aggregation.h"
+
+struct ArbitrageOptions {
+  // Smallest relative gain reported: a cycle is inconsistent when its
+  // rates multiply to more than 1 + threshold. Must be positive.
+  double threshold = 1e-3;
+  // Cycles reported per date at most.
+  size_t max_cycles_per_date = 8;
+  DateRange date_range;
+  // 0 selects the hardware concurrency.
+  size_t max_threads = 0;
+};
+
+// Quotes of one date that multiply around a loop to more than one:
+// converting through currencies[0] -> currencies[1] -> ... -> currencies[0]
+// returns |product| times the starting amount.
+struct ArbitrageCycle {
+  std::string date;
+  // Starts with the smallest code; the first currency is not repeated.
+  std::vector<std::string> currencies;
+  double product = 1.0;
+
+  // "YYYY.MM.DD | USD -> EUR -> GBP -> USD | 1.0123"
+  std::string ToString() const;
+};
+
+class ArbitrageDetector {
+public:
+  // Builds one graph per date with an edge per quote and its inverse,
+  // weighted by -log(rate), and finds cycles of negative weight with
+  // Bellman-Ford. A pair quoted several times on a date takes the quote
+  // stored last; quotes of both orientations of a pair are both used, so
+  // two that disagree form a cycle of two. Only the cycles that the
+  // predecessor links of the currencies still relaxing run into are
+  // reported, so not necessarily every cycle of a date. Dates are
+  // processed in parallel; results are in date order. Throws
+  // std::invalid_argument if the threshold is not positive.
+  static std::vector<ArbitrageCycle> Detect(
+      const std::vector<CurrencyRate>& rates,
+      const ArbitrageOptions& options = ArbitrageOptions());
+};
+
+#endif  // CURRENCY_RATE_ARBITRAGE_H_
@@ -0,0 +1,98 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_CACHE_H_
+#define CURRENCY_RATE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "currency_rate_repository.h"
+
+struct QueryCacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+  size_t invalidations = 0;
+  size_t entries = 0;
+  size_t cached_records = 0;
+};
+
+// Repository decorator that keeps an LRU cache of filter results.
+// An Add through the decorator only evicts the results that could contain
+// the new record (its two currencies and its date); any other change to
+// the wrapped repository, such as a file load, a refresh or a sort, drops
+// the whole cache on the next lookup. Keys are taken as given, exactly as
+// the wrapped repository matches them. The cache is bounded both by entry
+// count and by total cached records. Lookups may run concurrently with
+// each other: a miss queries the wrapped repository without holding the
+// cache's lock, which is safe for MemoryCurrencyRateRepository, whose
+// const queries only read.
+class CachingCurrencyRateRepository : public ICurrencyRateRepository {
+public:
+  using SharedRates = std::shared_ptr<const std::vector<CurrencyRate>>;
+
+  explicit CachingCurrencyRateRepository(
+      std::shared_ptr<ICurrencyRateRepository> repository,
+      size_t max_entries = 256, size_t max_cached_records = 1000000);
+
+  void Add(const CurrencyRate& rate) override;
+  std::vector<CurrencyRate> GetAll() const override;
+  size_t Count() const override;
+  void Clear() override;
+  void SortByDate() override;
+  void SortByCurrency() override;
+  std::vector<CurrencyRate> FilterByCurrency(
+      const std::string& currency) const override;
+  std::vector<CurrencyRate> FilterByDate(
+      const std::string& date) const override;
+  uint64_t generation() const override;
+
+  // The filters without the copy: a hit shares the cached result.
+  SharedRates SharedFilterByCurrency(const std::string& currency) const;
+  SharedRates SharedFilterByDate(const std::string& date) const;
+
+  void InvalidateAll();
+  QueryCacheStats stats() const;
+
+private:
+  struct Entry {
+    std::string key;
+    SharedRates result;
+  };
+
+  static std::string CurrencyKey(const std::string& currency);
+  static std::string DateKey(const std::string& date);
+
+  // Lookup() and Store() take |mutex_|; the helpers below them expect it
+  // held.
+  SharedRates Lookup(const std::string& key, uint64_t* generation) const;
+  void Store(const std::string& key, const SharedRates& result,
+             uint64_t generation) const;
+  void Evict(const std::string& key);
+  void EvictOverflow() const;
+  // Drops every entry if the wrapped repository changed behind our back.
+  void Synchronize() const;
+  void DropEntries() const;
+
+  std::shared_ptr<ICurrencyRateRepository> repository_;
+  size_t max_entries_;
+  size_t max_cached_records_;
+
+  mutable std::mutex mutex_;
+  // Generation of the wrapped repository the entries were computed at.
+  mutable uint64_t generation_;
+  // Most recently used entries are at the front.
+  mutable std::list<Entry> entries_;
+  mutable std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  mutable QueryCacheStats stats_;
+};
+
+#endif  // CURRENCY_RATE_CACHE_H_
@@ -0,0 +1,35 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_CLIENT_H_
+#define CURRENCY_RATE_CLIENT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal blocking client for the CurrencyRateServer protocol.
+class CurrencyRateClient {
+public:
+  // Connects to a Unix socket path, or to 127.0.0.1:|port| when
+  // |socket_path| is empty. Throws std::runtime_error on failure.
+  CurrencyRateClient(const std::string& socket_path, uint16_t port);
+  ~CurrencyRateClient();
+
+  CurrencyRateClient(const CurrencyRateClient&) = delete;
+  CurrencyRateClient& operator=(const CurrencyRateClient&) = delete;
+
+  // Sends one request built from |fields| and returns the response lines,
+  // the status line first. Throws std::invalid_argument if a field
+  // contains a tab or a newline.
+  std::vector<std::string> Request(const std::vector<std::string>& fields);
+
+private:
+  bool ReadLine(std::string* line);
+
+  int fd_ = -1;
+  std::string buffer_;
+};
+
+#endif  // CURRENCY_RATE_CLIENT_H_
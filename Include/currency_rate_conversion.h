@@ -0,0 +1,79 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_CONVERSION_H_
+#define CURRENCY_RATE_CONVERSION_H_
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "currency_rate_repository.h"
+
+enum class ConversionRoute {
+  kNone,
+  // Same currency on both sides.
+  kIdentity,
+  kDirect,
+  kInverse,
+  // Through one of the pivot currencies.
+  kTriangulated
+};
+
+struct ConversionOptions {
+  // Middle currencies tried in order when a pair has no quote of its own
+  // on the date.
+  std::vector<std::string> pivots = {"USD", "EUR"};
+  // Rows multiplied per work item; 0 keeps the batch on one thread.
+  size_t rows_per_task = 1 << 16;
+  // 0 selects the hardware concurrency.
+  size_t max_threads = 0;
+};
+
+struct ConversionStats {
+  size_t rows = 0;
+  // Distinct (from, to, date) requests, each resolved once.
+  size_t groups = 0;
+  // Rows by the route of their rate.
+  size_t identity = 0;
+  size_t direct = 0;
+  size_t inverse = 0;
+  size_t triangulated = 0;
+  size_t missing = 0;
+};
+
+// Converts columns of amounts in bulk. Rows are grouped by (from, to,
+// date) so every rate is looked up once, then the amounts are multiplied
+// by their group's rate in blocks the compiler vectorizes, spread over
+// worker threads for large batches.
+class CurrencyConverter {
+public:
+  // The repository must outlive the converter and stay unmodified while
+  // it converts.
+  explicit CurrencyConverter(const MemoryCurrencyRateRepository& repository,
+                             ConversionOptions options = ConversionOptions());
+
+  // Writes amounts[i] converted from from[i] to to[i] on dates[i] to
+  // out[i], which must have room for amounts.size() values; rows without
+  // a rate get NaN. Throws std::invalid_argument if the columns differ in
+  // length.
+  ConversionStats Convert(const std::vector<double>& amounts,
+                          const std::vector<std::string>& from,
+                          const std::vector<std::string>& to,
+                          const std::vector<std::string>& dates,
+                          double* out) const;
+
+  // Rate of |from| in |to| on |date| by the first route that has one.
+  std::optional<double> ResolveRate(const std::string& from,
+                                    const std::string& to,
+                                    const std::string& date,
+                                    ConversionRoute* route = nullptr) const;
+
+private:
+  const MemoryCurrencyRateRepository& repository_;
+  ConversionOptions options_;
+};
+
+#endif  // CURRENCY_RATE_CONVERSION_H_
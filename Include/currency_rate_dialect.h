@@ -0,0 +1,79 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_DIALECT_H_
+#define CURRENCY_RATE_DIALECT_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "currency_rate.h"
+#include "currency_rate_parser.h"
+
+enum class DateLayout {
+  kDotted,  // YYYY.MM.DD
+  kIso,     // YYYY-MM-DD
+};
+
+// Compile-time description of a rate file layout: fields are currency1,
+// currency2, rate and date. A ' ' delimiter splits on runs of whitespace;
+// any other delimiter separates exactly one field, and blanks around a
+// field are ignored. A field may be enclosed in double quotes, and
+// delimiters inside the quotes are part of it.
+template <char Delimiter, char DecimalSeparator, DateLayout Layout>
+struct RateDialect {
+  static constexpr char kDelimiter = Delimiter;
+  static constexpr char kDecimalSeparator = DecimalSeparator;
+  static constexpr DateLayout kDateLayout = Layout;
+};
+
+using SpaceDialect = RateDialect<' ', '.', DateLayout::kDotted>;
+using SpaceIsoDialect = RateDialect<' ', '.', DateLayout::kIso>;
+using CsvDialect = RateDialect<',', '.', DateLayout::kDotted>;
+using CsvIsoDialect = RateDialect<',', '.', DateLayout::kIso>;
+using SemicolonDialect = RateDialect<';', '.', DateLayout::kDotted>;
+using SemicolonIsoDialect = RateDialect<';', '.', DateLayout::kIso>;
+using SemicolonCommaDialect = RateDialect<';', ',', DateLayout::kDotted>;
+using SemicolonCommaIsoDialect = RateDialect<';', ',', DateLayout::kIso>;
+
+// Parser specialized for one dialect. Dates are normalized to YYYY.MM.DD,
+// so records look the same whatever file they came from. Instantiated in
+// currency_rate_dialect.cpp for the dialects above.
+template <typename Dialect>
+class DelimitedCurrencyRateParser : public ICurrencyRateParser {
+public:
+  // |fixed_scale| as in RegexCurrencyRateParser.
+  explicit DelimitedCurrencyRateParser(
+      int fixed_scale = RegexCurrencyRateParser::kFloatingPoint);
+
+  CurrencyRate Parse(const std::string& line) const override;
+  bool CanParse(const std::string& line) const override;
+  void ParseBatch(const std::vector<std::string_view>& lines,
+                  RateColumnBatch* batch) const override;
+
+private:
+  struct Fields {
+    std::string_view currency1;
+    std::string_view currency2;
+    std::string_view rate;
+    std::string_view date;
+  };
+
+  static bool SplitFields(std::string_view line, Fields* fields);
+  bool ParseRate(std::string_view text, double* rate, int64_t* units) const;
+
+  int fixed_scale_;
+};
+
+extern template class DelimitedCurrencyRateParser<SpaceDialect>;
+extern template class DelimitedCurrencyRateParser<SpaceIsoDialect>;
+extern template class DelimitedCurrencyRateParser<CsvDialect>;
+extern template class DelimitedCurrencyRateParser<CsvIsoDialect>;
+extern template class DelimitedCurrencyRateParser<SemicolonDialect>;
+extern template class DelimitedCurrencyRateParser<SemicolonIsoDialect>;
+extern template class DelimitedCurrencyRateParser<SemicolonCommaDialect>;
+extern template class DelimitedCurrencyRateParser<SemicolonCommaIsoDialect>;
+
+#endif  // CURRENCY_RATE_DIALECT_H_
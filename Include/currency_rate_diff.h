@@ -0,0 +1,102 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_DIFF_H_
+#define CURRENCY_RATE_DIFF_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "currency_pair.h"
+#include "currency_rate.h"
+#include "currency_rate_parser.h"
+#include "currency_rate_repository.h"
+
+enum class RateDiffKind { kAdded, kRemoved, kChanged };
+
+struct RateDifference {
+  RateDiffKind kind = RateDiffKind::kChanged;
+  CurrencyPair pair;
+  std::string date;
+  // NaN on the side the record is missing from.
+  double before_rate = 0.0;
+  double after_rate = 0.0;
+};
+
+struct RateDiffOptions {
+  // Rates of a matched record count as equal when they differ by at most
+  // the larger of these two bounds.
+  double absolute_tolerance = 0.0;
+  // Relative to the larger magnitude of the two rates.
+  double relative_tolerance = 0.0;
+  // CompareFiles(): longest line kept while it spans blocks. A longer one
+  // is dropped as it is read and counted as rejected.
+  size_t max_line_length = 64 * 1024;
+};
+
+struct RateDiffStats {
+  size_t before_records = 0;
+  size_t after_records = 0;
+  size_t unchanged = 0;
+  size_t added = 0;
+  size_t removed = 0;
+  size_t changed = 0;
+  // Lines of the compared files that did not parse.
+  size_t rejected = 0;
+
+  bool identical() const { return added + removed + changed == 0; }
+};
+
+// May be empty when only the counts are wanted.
+using RateDiffSink = std::function<void(const RateDifference&)>;
+
+// Reconciles two rate histories by a merge join on (pair, date): one pass
+// over both sides in key order, reporting each difference to the sink as
+// it is found. Records sharing a key are matched in order; surplus ones
+// are added or removed.
+class CurrencyRateDiff {
+public:
+  // Merge order: currency1, currency2, then date.
+  static bool KeyLess(const CurrencyRate& a, const CurrencyRate& b);
+
+  // Sorts a side only if it is not in merge order already, so sorted
+  // inputs are compared in linear time.
+  static RateDiffStats Compare(std::vector<CurrencyRate> before,
+                               std::vector<CurrencyRate> after,
+                               const RateDiffSink& sink,
+                               const RateDiffOptions& options =
+                                   RateDiffOptions());
+  // Compare() on GetAll() of each repository. Both histories are copied,
+  // so memory grows with their size; use CompareFiles() for bounded
+  // memory.
+  static RateDiffStats Compare(const ICurrencyRateRepository& before,
+                               const ICurrencyRateRepository& after,
+                               const RateDiffSink& sink,
+                               const RateDiffOptions& options =
+                                   RateDiffOptions());
+  // Streams both files block by block, so memory stays bounded whatever
+  // their size or line lengths. Both must be in merge order. Rows are compared as parsed,
+  // without validation; lines that do not parse are counted as rejected.
+  // Throws std::runtime_error if a file cannot be read or is out of
+  // order.
+  static RateDiffStats CompareFiles(const std::string& before,
+                                    const std::string& after,
+                                    const ICurrencyRateParser& parser,
+                                    const RateDiffSink& sink,
+                                    const RateDiffOptions& options =
+                                        RateDiffOptions());
+  // As above, with each file read by its own parser, for inputs in
+  // different formats.
+  static RateDiffStats CompareFiles(const std::string& before,
+                                    const std::string& after,
+                                    const ICurrencyRateParser& before_parser,
+                                    const ICurrencyRateParser& after_parser,
+                                    const RateDiffSink& sink,
+                                    const RateDiffOptions& options =
+                                        RateDiffOptions());
+};
+
+#endif  // CURRENCY_RATE_DIFF_H_
@@ -0,0 +1,104 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_FILTER_H_
+#define CURRENCY_RATE_FILTER_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "currency_pair.h"
+#include "currency_rate.h"
+
+enum class FilterField {
+  kPair,       // pair = USD/EUR, pair in (USD/EUR, "US Dollar"/JPY)
+  kCurrency,   // either side of the pair
+  kCurrency1,  // also spelled "base"
+  kCurrency2,  // also spelled "quote"
+  kDate,
+  kRate
+};
+
+enum class FilterOperator {
+  kEqual,
+  kNotEqual,
+  kLess,
+  kLessEqual,
+  kGreater,
+  kGreaterEqual,
+  kIn
+};
+
+struct FilterCondition {
+  FilterField field = FilterField::kCurrency;
+  FilterOperator op = FilterOperator::kEqual;
+  // Operands: names or dates for text fields, pairs for kPair and a
+  // number for kRate. kIn carries several operands, other operators one.
+  std::vector<std::string> values;
+  std::vector<CurrencyPair> pairs;
+  double number = 0.0;
+};
+
+// Conjunction of conditions parsed from a small filter language:
+//
+//   pair in (USD/EUR, USD/JPY) and date >= 2023.01.01 and rate > 1.1
+//
+// Fields: pair, currency, base (currency1), quote (currency2), date, rate.
+// Operators: =, !=, <, <=, >, >=, in. Names containing spaces are quoted.
+// Keywords and field names are case-insensitive.
+class FilterExpression {
+public:
+  // Throws InvalidFilterException on syntax errors.
+  static FilterExpression Parse(const std::string& text);
+
+  const std::vector<FilterCondition>& conditions() const {
+    return conditions_;
+  }
+
+private:
+  std::vector<FilterCondition> conditions_;
+};
+
+// Index access a conjunct allows. The repository picks the most selective
+// one and feeds the remaining conditions with candidate positions.
+struct FilterIndexHint {
+  enum class Kind { kNone, kPairs, kCurrency, kDateRange };
+
+  Kind kind = Kind::kNone;
+  std::vector<CurrencyPair> pairs;
+  std::string currency;
+  std::string date_from;
+  std::string date_to;
+};
+
+// A FilterExpression compiled into a pipeline of batch predicates. Each
+// stage narrows a selection of positions in place, so later stages only
+// look at survivors of earlier ones.
+class CompiledFilter {
+public:
+  static constexpr size_t kBatchSize = 1024;
+
+  explicit CompiledFilter(const FilterExpression& expression);
+
+  const FilterIndexHint& index_hint() const { return index_hint_; }
+
+  // Removes from |selection| the positions in |rates| that fail a condition.
+  void Apply(const std::vector<CurrencyRate>& rates,
+             std::vector<size_t>* selection) const;
+
+  bool Matches(const CurrencyRate& rate) const;
+
+private:
+  using Stage = std::function<bool(const CurrencyRate&)>;
+
+  static Stage CompileCondition(const FilterCondition& condition);
+  void ChooseIndex(const FilterExpression& expression);
+
+  std::vector<Stage> stages_;
+  FilterIndexHint index_hint_;
+};
+
+#endif  // CURRENCY_RATE_FILTER_H_
@@ -0,0 +1,53 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_FOLLOWER_H_
+#define CURRENCY_RATE_FOLLOWER_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "currency_rate_repository.h"
+
+struct FollowOptions {
+  // Polling period, and the longest time Run() takes to notice |stop|.
+  std::chrono::milliseconds poll_interval{200};
+  // Use inotify where available; otherwise the files are polled.
+  bool use_inotify = true;
+};
+
+// Watches growing rate files and triggers a refresh when they change.
+// On Linux changes are reported by inotify on the files' directories, so
+// rotation (a new file moved into place) is seen as well. Elsewhere, or
+// when inotify is unavailable, the refresh runs every poll interval.
+class CurrencyRateFollower {
+public:
+  using RefreshFunction = std::function<RefreshResult()>;
+  using RefreshCallback = std::function<void(const RefreshResult&)>;
+
+  CurrencyRateFollower(std::vector<std::string> files,
+                       RefreshFunction refresh,
+                       FollowOptions options = FollowOptions());
+
+  // Blocks until |stop| becomes true. |on_refresh| is called after every
+  // refresh that read new data.
+  void Run(const std::atomic<bool>& stop,
+           const RefreshCallback& on_refresh = nullptr);
+
+private:
+  bool RunInotify(const std::atomic<bool>& stop,
+                  const RefreshCallback& on_refresh);
+  void RunPolling(const std::atomic<bool>& stop,
+                  const RefreshCallback& on_refresh);
+  void RefreshAndNotify(const RefreshCallback& on_refresh);
+
+  std::vector<std::string> files_;
+  RefreshFunction refresh_;
+  FollowOptions options_;
+};
+
+#endif  // CURRENCY_RATE_FOLLOWER_H_
@@ -0,0 +1,66 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_INDEX_H_
+#define CURRENCY_RATE_INDEX_H_
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "currency_pair.h"
+#include "currency_rate.h"
+#include "currency_rate_memory.h"
+
+// Secondary indexes over a rate vector: positions by currency (either
+// side), by exact pair, by date and by pair ordered by date. Position lists are
+// kept in ascending order, so results follow storage order.
+class CurrencyRateIndex {
+public:
+  void Add(const CurrencyRate& rate, size_t position);
+  void Rebuild(const std::vector<CurrencyRate>& rates);
+  void Clear();
+  // Releases the spare capacity of the position lists.
+  void ShrinkToFit();
+  // Adds the index to |usage->indexes| and its spare capacity to
+  // |usage->slack|. Walks every entry.
+  void AccountMemory(MemoryUsageReport* usage) const;
+
+  // Return nullptr when nothing is indexed under the key.
+  const std::vector<size_t>* FindCurrency(const std::string& currency) const;
+  const std::vector<size_t>* FindPair(const CurrencyPair& pair) const;
+  const std::vector<size_t>* FindDate(const std::string& date) const;
+  // First position stored for the pair on |date|.
+  const size_t* FindPairDate(const CurrencyPair& pair,
+                             const std::string& date) const;
+  // Position of the latest quote for the pair on or before |date|.
+  const size_t* FindPairAsOf(const CurrencyPair& pair,
+                             const std::string& date) const;
+  // Positions of the pair's quotes within [from, to], in date order.
+  std::vector<size_t> FindPairDateRange(const CurrencyPair& pair,
+                                        const std::string& from,
+                                        const std::string& to) const;
+
+  // Positions with a date inside [from, to]; empty bounds are open.
+  // The result is sorted by position.
+  std::vector<size_t> FindDateRange(const std::string& from,
+                                    const std::string& to) const;
+  // Positions by date, for walks in date order that stop early.
+  const std::map<std::string, std::vector<size_t>>& dates() const {
+    return by_date_;
+  }
+
+private:
+  std::unordered_map<std::string, std::vector<size_t>> by_currency_;
+  std::unordered_map<CurrencyPair, std::vector<size_t>, CurrencyPairHash>
+      by_pair_;
+  std::map<std::string, std::vector<size_t>> by_date_;
+  // Per-pair series ordered by date, for exact and as-of lookups.
+  std::unordered_map<CurrencyPair, std::map<std::string, size_t>,
+                     CurrencyPairHash> pair_series_;
+};
+
+#endif  // CURRENCY_RATE_INDEX_H_
@@ -0,0 +1,72 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_MEMORY_H_
+#define CURRENCY_RATE_MEMORY_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Bytes held by a repository, by what holds them. Every figure is an
+// estimate: allocator headers and rounding are not counted, and node
+// sizes follow the layout of the common standard libraries.
+struct MemoryUsageReport {
+  size_t records = 0;
+  // The record array itself, strings stored inline (short-string
+  // buffers) included.
+  size_t record_storage = 0;
+  // Heap blocks of record strings too long for the inline buffer.
+  size_t string_heap = 0;
+  // Lookup indexes by currency, pair and date.
+  size_t indexes = 0;
+  // Derived state kept next to the records: rolling statistics, quantile
+  // sketches and the per-file checkpoints and parsers.
+  size_t caches = 0;
+  // Allocated but unused capacity of the above, counted separately.
+  size_t slack = 0;
+
+  size_t Total() const {
+    return record_storage + string_heap + indexes + caches + slack;
+  }
+  // One "name bytes" line per category.
+  std::string ToString() const;
+};
+
+// Heap estimates for the standard containers the repository uses.
+class MemoryAccounting {
+public:
+  // Heap block of |text|; 0 while it fits in the inline buffer.
+  static size_t StringHeap(const std::string& text);
+  // Unused bytes of that heap block.
+  static size_t StringSlack(const std::string& text);
+
+  template <typename T>
+  static size_t VectorBytes(const std::vector<T>& values) {
+    return values.size() * sizeof(T);
+  }
+  template <typename T>
+  static size_t VectorSlack(const std::vector<T>& values) {
+    return (values.capacity() - values.size()) * sizeof(T);
+  }
+
+  // Nodes and bucket array of an unordered container; keys and values
+  // owning heap memory are accounted by the caller.
+  template <typename HashMap>
+  static size_t HashNodes(const HashMap& map) {
+    // A node links to the next one and caches the key's hash.
+    return map.size() * (sizeof(typename HashMap::value_type) +
+                         2 * sizeof(void*)) +
+           map.bucket_count() * sizeof(void*);
+  }
+  // Nodes of a red-black tree container.
+  template <typename TreeMap>
+  static size_t TreeNodes(const TreeMap& map) {
+    // Parent, two children and the colour, padded to a word.
+    return map.size() * (sizeof(typename TreeMap::value_type) +
+                         4 * sizeof(void*));
+  }
+};
+
+#endif  // CURRENCY_RATE_MEMORY_H_
@@ -0,0 +1,196 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_METRICS_H_
+#define CURRENCY_RATE_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Monotonic counter, safe to bump from any thread.
+class MetricCounter {
+public:
+  void Add(uint64_t delta = 1) {
+    value_.fetch_add(delta, std::memory_order_relaxed);
+  }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+  void Reset() { value_.store(0, std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> value_{0};
+};
+
+// Log-linear histogram of nanosecond latencies in the HDR style: every
+// power of two is split into kSubBuckets linear buckets, so a recorded
+// value is known to within 12.5% over the whole uint64_t range. Recording
+// is one relaxed atomic increment and one add.
+class LatencyHistogram {
+public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+  static constexpr size_t kBucketCount = (64 - kSubBucketBits + 1) *
+                                         kSubBuckets;
+
+  void Record(uint64_t nanoseconds) {
+    buckets_[BucketIndex(nanoseconds)].fetch_add(1,
+                                                 std::memory_order_relaxed);
+    sum_.fetch_add(nanoseconds, std::memory_order_relaxed);
+  }
+
+  uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+  uint64_t bucket(size_t index) const {
+    return buckets_[index].load(std::memory_order_relaxed);
+  }
+  void Reset();
+
+  static size_t BucketIndex(uint64_t value);
+  // Smallest value above bucket |index|.
+  static uint64_t BucketLimit(size_t index);
+
+private:
+  std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+  std::atomic<uint64_t> sum_{0};
+};
+
+// Records the time from construction to destruction.
+class ScopedLatency {
+public:
+  explicit ScopedLatency(LatencyHistogram* histogram)
+      : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+  ~ScopedLatency() {
+    histogram_->Record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count()));
+  }
+
+  ScopedLatency(const ScopedLatency&) = delete;
+  ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+private:
+  LatencyHistogram* histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+struct CounterSnapshot {
+  std::string name;
+  uint64_t value = 0;
+};
+
+struct HistogramSnapshot {
+  std::string name;
+  uint64_t count = 0;
+  uint64_t sum_ns = 0;
+  // (bucket limit in ns, recordings) for the non-empty buckets, ascending.
+  std::vector<std::pair<uint64_t, uint64_t>> buckets;
+
+  double MeanNanoseconds() const;
+  // Upper estimate of the |q| quantile (0..1) in ns; 0 when empty.
+  uint64_t QuantileNanoseconds(double q) const;
+};
+
+struct MetricsSnapshot {
+  std::vector<CounterSnapshot> counters;
+  std::vector<HistogramSnapshot> histograms;
+  // Help text by metric family (the name without labels).
+  std::map<std::string, std::string> help;
+
+  // nullptr if the metric was never registered.
+  const CounterSnapshot* FindCounter(const std::string& name) const;
+  const HistogramSnapshot* FindHistogram(const std::string& name) const;
+
+  // Prometheus text exposition format. Histograms are exported in
+  // seconds with power-of-two bucket bounds from 64 ns to about 69 s.
+  std::string ToPrometheus() const;
+};
+
+// Process-wide set of named metrics. Names follow Prometheus conventions
+// and may carry labels, e.g. rejected_lines_total{reason="..."}; metrics
+// sharing a family name share its help text. Registration takes a lock,
+// so hot paths look their metric up once (see the macros below) and then
+// only touch atomics. Registered metrics live until the process exits.
+class MetricsRegistry {
+public:
+  static MetricsRegistry& Global();
+
+  MetricCounter& Counter(const std::string& name,
+                         const std::string& help = "");
+  LatencyHistogram& Histogram(const std::string& name,
+                              const std::string& help = "");
+
+  MetricsSnapshot Snapshot() const;
+  // Zeroes every metric; registrations are kept.
+  void Reset();
+  // Throws std::runtime_error if the file cannot be written.
+  void WritePrometheus(const std::string& filename) const;
+
+private:
+  void SetHelp(const std::string& name, const std::string& help);
+
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<MetricCounter>> counters_;
+  std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms_;
+  std::map<std::string, std::string> help_;
+};
+
+// Metrics of the rate loaders.
+class RateLoadMetrics {
+public:
+  // Name of the exception type that rejected a line, looking through the
+  // InvalidFormatException the parsers wrap validation errors in. nullptr
+  // stands for a line that matched no format.
+  static const char* RejectReason(const std::exception* error);
+  // Bumps currency_rate_rejected_lines_total{reason="..."}.
+  static void CountRejectedLine(const std::exception* error);
+};
+
+// Instrumentation used by the library. Configuring with
+// -DCURRENCY_RATE_METRICS=OFF compiles these to nothing; the registry
+// stays available and simply has nothing registered.
+#ifdef CURRENCY_RATE_ENABLE_METRICS
+
+#define CURRENCY_RATE_COUNT_REJECTED(error) \
+  RateLoadMetrics::CountRejectedLine(error)
+
+#define CURRENCY_RATE_METRIC_CONCAT_(a, b) a##b
+#define CURRENCY_RATE_METRIC_CONCAT(a, b) CURRENCY_RATE_METRIC_CONCAT_(a, b)
+
+#define CURRENCY_RATE_COUNT(name, help, delta)                            \
+  do {                                                                    \
+    static MetricCounter& metric_counter =                                \
+        MetricsRegistry::Global().Counter(name, help);                    \
+    metric_counter.Add(delta);                                            \
+  } while (false)
+
+// Times the rest of the enclosing scope.
+#define CURRENCY_RATE_TIME_SCOPE(name, help)                              \
+  static LatencyHistogram& CURRENCY_RATE_METRIC_CONCAT(                   \
+      metric_histogram_, __LINE__) =                                      \
+      MetricsRegistry::Global().Histogram(name, help);                    \
+  ScopedLatency CURRENCY_RATE_METRIC_CONCAT(metric_latency_, __LINE__)(   \
+      &CURRENCY_RATE_METRIC_CONCAT(metric_histogram_, __LINE__))
+
+#else
+
+#define CURRENCY_RATE_COUNT_REJECTED(error) \
+  do {                                      \
+  } while (false)
+#define CURRENCY_RATE_COUNT(name, help, delta) \
+  do {                                         \
+  } while (false)
+#define CURRENCY_RATE_TIME_SCOPE(name, help) \
+  do {                                       \
+  } while (false)
+
+#endif  // CURRENCY_RATE_ENABLE_METRICS
+
+#endif  // CURRENCY_RATE_METRICS_H_
@@ -5,30 +5,117 @@
 #ifndef CURRENCY_RATE_PARSER_H_
 #define CURRENCY_RATE_PARSER_H_
 
+#include <cstdint>
 #include <memory>
 #include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "currency_rate.h"
 
+// Columns of parsed lines, one row per input line. Rows are only checked
+// against the line format; ToRate() applies the range and calendar checks
+// of the CurrencyRate constructor.
+struct RateColumnBatch {
+  std::vector<std::string> currency1;
+  std::vector<std::string> currency2;
+  std::vector<double> rate;
+  std::vector<std::string> date;
+  // Exact rates in 10^-|scale| units when the parser works in fixed
+  // point (|scale| >= 0); empty otherwise.
+  std::vector<int64_t> units;
+  int scale = -1;
+  // Bit i is set when row i did not match the format (blank lines
+  // included). The values of such a row are empty.
+  std::vector<uint64_t> errors;
+
+  size_t size() const { return rate.size(); }
+  bool HasError(size_t row) const {
+    return (errors[row / 64] >> (row % 64)) & 1;
+  }
+  void Clear();
+  // |units| is stored only when |scale| >= 0.
+  void AppendRow(std::string_view currency1_value,
+                 std::string_view currency2_value, double rate_value,
+                 std::string_view date_value, int64_t units_value = 0);
+  void AppendError();
+  // Throws CurrencyRateException if the row is invalid.
+  CurrencyRate ToRate(size_t row) const;
+};
+
 class ICurrencyRateParser {
 public:
   virtual ~ICurrencyRateParser() = default;
   virtual CurrencyRate Parse(const std::string& line) const = 0;
   virtual bool CanParse(const std::string& line) const = 0;
+
+  // Appends one row per line to |batch|. The default calls Parse() for
+  // every line and keeps only the double rate.
+  virtual void ParseBatch(const std::vector<std::string_view>& lines,
+                          RateColumnBatch* batch) const;
+
+  // Appends the complete lines of |buffer| to |lines|, without their line
+  // breaks. Returns the number of bytes they span; the rest of the buffer
+  // is an unterminated line.
+  static size_t SplitLines(std::string_view buffer,
+                           std::vector<std::string_view>* lines);
 };
 
 class RegexCurrencyRateParser : public ICurrencyRateParser {
 public:
+  static constexpr int kFloatingPoint = -1;
+
+  // With |fixed_scale| >= 0 rates are read exactly as FixedRate values of
+  // that scale. Throws std::invalid_argument above FixedRate::kMaxScale.
+  explicit RegexCurrencyRateParser(int fixed_scale = kFloatingPoint);
+
   CurrencyRate Parse(const std::string& line) const override;
   bool CanParse(const std::string& line) const override;
+  // Splits plain space-separated lines by hand and only falls back to the
+  // regular expression for quoted names or other whitespace.
+  void ParseBatch(const std::vector<std::string_view>& lines,
+                  RateColumnBatch* batch) const override;
 
 private:
+  struct Fields {
+    std::string_view currency1;
+    std::string_view currency2;
+    std::string_view rate;
+    std::string_view date;
+  };
+
+  static bool SplitFields(std::string_view line, Fields* fields);
+  static bool MatchFields(const std::string& line, std::smatch* matches,
+                          Fields* fields);
+  CurrencyRate MakeRate(const Fields& fields) const;
+
+  int fixed_scale_;
+
   static const std::regex kPattern;
 };
 
 class CurrencyRateParserFactory {
 public:
+  // Bytes at the start of a file examined by DetectFileParser().
+  static constexpr size_t kSniffSize = 4096;
+
   static std::unique_ptr<ICurrencyRateParser> CreateDefaultParser();
+  static std::unique_ptr<ICurrencyRateParser> CreateFixedPointParser(
+      int scale);
+
+  // Returns the parser of the dialect (space, comma or semicolon separated,
+  // dotted or ISO dates, decimal point or comma) that accepts the most
+  // lines of |sample|. Falls back to the default format when no line
+  // matches any dialect.
+  static std::unique_ptr<ICurrencyRateParser> DetectParser(
+      std::string_view sample,
+      int fixed_scale = RegexCurrencyRateParser::kFloatingPoint);
+  // DetectParser() on the first kSniffSize bytes of |filename|. Throws
+  // std::runtime_error if the file cannot be opened.
+  static std::unique_ptr<ICurrencyRateParser> DetectFileParser(
+      const std::string& filename,
+      int fixed_scale = RegexCurrencyRateParser::kFloatingPoint);
 };
 
-#endif  // CURRENCY_RATE_PARSER_H_
\ No newline at end of file
+#endif  // CURRENCY_RATE_PARSER_H_
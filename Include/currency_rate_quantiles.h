@@ -0,0 +1,111 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_QUANTILES_H_
+#define CURRENCY_RATE_QUANTILES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "currency_pair.h"
+#include "currency_rate.h"
+#include "currency_rate_aggregation.h"
+#include "currency_rate_memory.h"
+
+// KLL quantile sketch. Values are kept in levels of compactors; an item
+// on level h stands for 2^h inputs. A full level is sorted and every
+// other item, starting at a random offset, moves up a level. With the
+// default k of 200 the rank error is around 1% and a sketch holds a few
+// hundred values however many it has seen. Sketches merge losslessly
+// with respect to that error bound, so per-bucket sketches can be
+// combined at query time.
+class KllSketch {
+public:
+  static constexpr size_t kDefaultK = 200;
+
+  // Throws std::invalid_argument if |k| is below 8.
+  explicit KllSketch(size_t k = kDefaultK);
+
+  void Update(double value);
+  // Throws std::invalid_argument if the sketches differ in k.
+  void Merge(const KllSketch& other);
+
+  // Approximate value at |fraction| (0 = minimum, 1 = maximum) of the
+  // sorted inputs. Fractions outside [0, 1] are clamped. Returns NaN for
+  // an empty sketch.
+  double Quantile(double fraction) const;
+  std::vector<double> Quantiles(const std::vector<double>& fractions) const;
+
+  size_t k() const { return k_; }
+  // Number of values fed into the sketch, including merged ones.
+  uint64_t count() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  double min() const { return min_; }
+  double max() const { return max_; }
+  // Values currently retained.
+  size_t retained() const { return retained_; }
+  size_t HeapBytes() const;
+
+private:
+  // Appends an empty top level and recomputes the level capacities.
+  void AddLevel();
+  void Compress();
+  void CompactLevel(size_t level);
+  bool NextBit();
+
+  size_t k_;
+  uint64_t count_ = 0;
+  double min_ = 0.0;
+  double max_ = 0.0;
+  std::vector<std::vector<double>> levels_;
+  // Capacity of every level and their sum.
+  std::vector<size_t> capacities_;
+  size_t capacity_ = 0;
+  size_t retained_ = 0;
+  // Xorshift state for the compaction offsets; fixed so runs repeat.
+  uint64_t random_ = 0x9e3779b97f4a7c15ULL;
+};
+
+// Per-pair KLL sketches of the rates, one per date bucket, maintained as
+// rates arrive. Unlike the rolling statistics the arrival order does not
+// matter.
+class QuantileSketchTracker {
+public:
+  // Throws std::invalid_argument if |k| is below 8.
+  explicit QuantileSketchTracker(
+      AggregationBucket bucket = AggregationBucket::kMonth,
+      size_t k = KllSketch::kDefaultK);
+
+  void Add(const CurrencyRate& rate);
+  void Clear();
+
+  // The pair's buckets that overlap |range| merged into one sketch, or
+  // nullopt if none of them has a rate. Ranges are widened to whole
+  // buckets; an open range is answered from a whole-history sketch kept
+  // alongside, without merging. Throws InvalidDateException if a bound is
+  // not a valid date.
+  std::optional<KllSketch> Get(const CurrencyPair& pair,
+                               const DateRange& range = DateRange()) const;
+  AggregationBucket bucket() const { return bucket_; }
+  size_t k() const { return k_; }
+  // Adds the per-pair sketches to |usage->caches|.
+  void AccountMemory(MemoryUsageReport* usage) const;
+
+private:
+  struct Series {
+    KllSketch all;
+    // Sketches by the day number of their bucket's first day.
+    std::map<int, KllSketch> buckets;
+  };
+
+  AggregationBucket bucket_;
+  size_t k_;
+  std::unordered_map<CurrencyPair, Series, CurrencyPairHash> series_;
+};
+
+#endif  // CURRENCY_RATE_QUANTILES_H_
@@ -0,0 +1,115 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_QUERY_H_
+#define CURRENCY_RATE_QUERY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "currency_rate.h"
+#include "currency_rate_filter.h"
+
+enum class QueryOrder {
+  kStorage,
+  // Oldest date first; records of one date in storage order.
+  kDateAscending,
+  // Newest date first; records of one date latest stored first.
+  kDateDescending
+};
+
+struct QueryOptions {
+  static constexpr size_t kUnlimited = SIZE_MAX;
+
+  size_t offset = 0;
+  size_t limit = kUnlimited;
+  QueryOrder order = QueryOrder::kStorage;
+};
+
+// Records selected by a lazy query. Nothing is copied or collected up
+// front: each step of an iterator finds the next match, and iteration
+// stops at the limit, so a page costs its size plus the records the
+// filter rejects on the way. A date range in storage order also costs
+// one heap entry per date when a pass starts, and a logarithmic step per
+// record. Every begin() starts a fresh pass.
+//
+// The range borrows the repository's records and indexes, like an
+// iterator: it is invalidated by anything that modifies the repository.
+class RateQueryRange {
+  struct Cursor;
+
+public:
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = CurrencyRate;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const CurrencyRate*;
+    using reference = const CurrencyRate&;
+
+    iterator() = default;
+
+    reference operator*() const;
+    pointer operator->() const { return &**this; }
+    iterator& operator++();
+    // Iterators share their pass, so the copy returned is advanced too.
+    iterator operator++(int);
+
+    bool operator==(const iterator& other) const {
+      return Current() == other.Current();
+    }
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+
+  private:
+    friend class RateQueryRange;
+    explicit iterator(std::shared_ptr<Cursor> cursor)
+        : cursor_(std::move(cursor)) {}
+
+    const CurrencyRate* Current() const;
+
+    std::shared_ptr<Cursor> cursor_;
+  };
+
+  iterator begin() const;
+  iterator end() const { return iterator(); }
+
+  // The |limit| records after the first |offset| of this range.
+  RateQueryRange Page(size_t offset,
+                      size_t limit = QueryOptions::kUnlimited) const;
+  std::vector<CurrencyRate> ToVector() const;
+
+private:
+  friend class MemoryCurrencyRateRepository;
+  using DateBuckets = std::map<std::string, std::vector<size_t>>;
+
+  bool NextPosition(Cursor* cursor) const;
+  void Advance(Cursor* cursor) const;
+
+  const std::vector<CurrencyRate>* rates_ = nullptr;
+  // Candidates, by the first source that is set: date buckets in
+  // [date_first_, date_last_), a position list, or every record.
+  const DateBuckets* dates_ = nullptr;
+  DateBuckets::const_iterator date_first_;
+  DateBuckets::const_iterator date_last_;
+  bool descending_ = false;
+  // Whether the date buckets are merged into storage order, through a
+  // heap holding the next position of each bucket, instead of walked.
+  bool merge_dates_ = false;
+  const std::vector<size_t>* positions_ = nullptr;
+  // Keep alive what the pointers above refer to when the range owns it.
+  std::shared_ptr<const std::vector<size_t>> owned_positions_;
+  std::shared_ptr<const std::vector<CurrencyRate>> owned_rates_;
+  // Null when every candidate matches.
+  std::shared_ptr<const CompiledFilter> filter_;
+
+  size_t offset_ = 0;
+  size_t limit_ = QueryOptions::kUnlimited;
+};
+
+#endif  // CURRENCY_RATE_QUERY_H_
@@ -5,12 +5,28 @@
 #ifndef CURRENCY_RATE_REPOSITORY_H_
 #define CURRENCY_RATE_REPOSITORY_H_
 
+#include <cstdint>
 #include <functional>
+#include <istream>
+#include <map>
 #include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
 #include <vector>
 
 #include "currency_rate.h"
+#include "currency_rate_aggregation.h"
+#include "currency_rate_arbitrage.h"
+#include "currency_rate_filter.h"
+#include "currency_rate_index.h"
+#include "currency_rate_memory.h"
 #include "currency_rate_parser.h"
+#include "currency_rate_quantiles.h"
+#include "currency_rate_query.h"
+#include "currency_rate_resample.h"
+#include "currency_rate_rolling_stats.h"
+#include "currency_rate_stream.h"
 
 class ICurrencyRateRepository {
 public:
@@ -21,6 +37,42 @@ public:
   virtual void Clear() = 0;
   virtual void SortByDate() = 0;
   virtual void SortByCurrency() = 0;
+  // Rates where |currency| is either side of the pair.
+  virtual std::vector<CurrencyRate> FilterByCurrency(
+      const std::string& currency) const = 0;
+  virtual std::vector<CurrencyRate> FilterByDate(
+      const std::string& date) const = 0;
+  // Changes whenever the stored records do, by any path, so that results
+  // kept by a caller can be told stale.
+  virtual uint64_t generation() const = 0;
+};
+
+// Read position in a source file. The leading bytes are fingerprinted so
+// that a file replaced by rotation is not mistaken for a grown one.
+struct SourceCheckpoint {
+  uint64_t offset = 0;
+  uint64_t line_number = 0;
+  uint64_t head_size = 0;
+  uint64_t head_hash = 0;
+};
+
+struct RefreshResult {
+  size_t files = 0;
+  size_t records_added = 0;
+  uint64_t bytes_read = 0;
+  size_t rotations = 0;
+  size_t truncations = 0;
+};
+
+// Outcome of loading one file with AddFromFiles().
+struct FileLoadStats {
+  std::string filename;
+  size_t lines = 0;
+  size_t records = 0;
+  size_t rejected = 0;
+  uint64_t bytes = 0;
+  // Empty when the file was read, otherwise the reason it was not.
+  std::string error;
 };
 
 class MemoryCurrencyRateRepository : public ICurrencyRateRepository {
@@ -34,15 +86,211 @@ public:
   void Clear() override;
   void SortByDate() override;
   void SortByCurrency() override;
+  std::vector<CurrencyRate> FilterByCurrency(
+      const std::string& currency) const override;
+  std::vector<CurrencyRate> FilterByDate(
+      const std::string& date) const override;
+  uint64_t generation() const override { return generation_; }
+
+  // Evaluates a filter expression, using the currency, pair or date index
+  // when a conjunct allows it. Results follow storage order.
+  // In canonical-pair mode pair conditions match both orientations and
+  // records of the opposite orientation are returned inverted.
+  std::vector<CurrencyRate> Query(const FilterExpression& expression) const;
+  // Lazy Query(): the records are found while the range is iterated, from
+  // the index Query() would use or, for date orders, by walking the dates
+  // (within the expression's date bounds) from the requested end. A date
+  // range in storage order merges the position lists of its dates as it
+  // goes. The first page of any query therefore costs about its size, plus
+  // one step per date in that last case. Canonical-pair queries on pairs
+  // are the exception and are evaluated in full.
+  RateQueryRange QueryRange(const FilterExpression& expression,
+                            const QueryOptions& options = QueryOptions()) const;
+  // The |count| newest records matching |expression|, newest first.
+  RateQueryRange Latest(const FilterExpression& expression,
+                        size_t count) const;
+
+  // Canonical-pair mode stores every market once, with the currencies in
+  // name order, inverting the rate of quotes that arrive the other way
+  // round. Fixed-point quotes whose inverse would not read back as the
+  // same rate are kept as they came. A second quote for the same market
+  // and date is dropped.
+  // Enabling the mode normalizes the rates already stored.
+  void SetCanonicalPairs(bool enabled);
+  bool canonical_pairs() const { return canonical_pairs_; }
+  size_t canonical_duplicates() const { return canonical_duplicates_; }
+
+  // With format detection on, every loaded file is read with the parser
+  // of the dialect sniffed from its first bytes (see
+  // CurrencyRateParserFactory::DetectParser) instead of the repository's
+  // parser. |fixed_scale| is passed to the detected parsers.
+  void SetFormatDetection(
+      bool enabled,
+      int fixed_scale = RegexCurrencyRateParser::kFloatingPoint);
+  bool format_detection() const { return format_detection_; }
+
+  // Rate of |from| in |to| on |date|, taken from the direct series or
+  // inverted from the opposite one; |inverted| tells which.
+  std::optional<double> GetRate(const std::string& from,
+                                const std::string& to,
+                                const std::string& date,
+                                bool* inverted = nullptr) const;
+  // Latest quote of |from| in |to| on or before |date|, oriented as asked.
+  std::optional<CurrencyRate> GetRateAsOf(const std::string& from,
+                                          const std::string& to,
+                                          const std::string& date) const;
+  // Quotes of |from| in |to| within |range| in date order, including the
+  // inverted quotes of the opposite series.
+  std::vector<CurrencyRate> GetRange(const std::string& from,
+                                     const std::string& to,
+                                     const DateRange& range) const;
 
+  // Loads every line of |filename| and remembers the byte offset reached,
+  // so that Refresh() can later pick up lines appended to the file.
   void AddFromFile(const std::string& filename);
+  // Parses up to |max_in_flight| files at a time on worker threads (0
+  // selects the hardware concurrency) and merges them in the given order,
+  // so the result is the same as calling AddFromFile() for each in turn.
+  // A file that cannot be opened is reported in its stats, not thrown.
+  std::vector<FileLoadStats> AddFromFiles(
+      const std::vector<std::string>& filenames, size_t max_in_flight = 0);
+  // Loads the regular files of |directory| whose names match |pattern|
+  // ('*' and '?' wildcards) in name order. Throws std::runtime_error if
+  // the directory cannot be read.
+  std::vector<FileLoadStats> AddFromDirectory(const std::string& directory,
+                                              const std::string& pattern = "*",
+                                              size_t max_in_flight = 0);
+  // Reads the complete lines appended to every loaded file since its
+  // checkpoint. A file that shrank (truncation) or whose leading bytes
+  // changed (rotation) is read again from the start. An unterminated last
+  // line is left for the next refresh. Missing files are skipped.
+  RefreshResult Refresh();
+  // Parses |filename| with this repository's parser and passes the rates
+  // to |sink| in batches without storing them.
+  StreamStats StreamFile(const std::string& filename,
+                         const RateBatchSink& sink,
+                         const StreamOptions& options = StreamOptions()) const;
+  std::vector<std::string> SourceFiles() const;
+  std::optional<SourceCheckpoint> GetCheckpoint(
+      const std::string& filename) const;
   void SaveToFile(const std::string& filename) const;
   void AppendToFile(const std::string& filename,
                     const CurrencyRate& rate) const;
 
+  // Per-pair OHLC/min/max/mean/count over day, week, month or year buckets.
+  std::vector<RateAggregate> Aggregate(
+      const PairFilter& pair_filter, const DateRange& date_range,
+      AggregationBucket bucket = AggregationBucket::kDay) const;
+  // Dense pair x day matrix over a calendar with gaps filled; see
+  // CurrencyRateResampler::Resample().
+  RateMatrix Resample(const ResampleOptions& options) const;
+  // Cycles of quotes on the same date that multiply to more than
+  // 1 + threshold; see ArbitrageDetector::Detect().
+  std::vector<ArbitrageCycle> DetectArbitrage(
+      const ArbitrageOptions& options = ArbitrageOptions()) const;
+
+  // Starts maintaining SMA, EMA and log-return volatility per pair for the
+  // given window lengths (in observations). Existing rates are replayed in
+  // storage order; later Add/AddFromFile calls update them in O(1).
+  void EnableRollingStatistics(const std::vector<size_t>& windows);
+  void DisableRollingStatistics();
+  std::optional<RollingIndicators> GetRollingStatistics(
+      const std::string& currency1, const std::string& currency2,
+      size_t window) const;
+
+  // Starts maintaining a KLL sketch of the rates per pair and |bucket|.
+  // Existing rates are replayed; later Add/AddFromFile calls update the
+  // sketches in amortized O(1), in any date order.
+  void EnableQuantileSketches(
+      AggregationBucket bucket = AggregationBucket::kMonth,
+      size_t k = KllSketch::kDefaultK);
+  void DisableQuantileSketches();
+  // The pair's rates within |range| (widened to whole buckets) merged into
+  // one sketch; nullopt if sketches are off or the pair has no rate there.
+  // Only the stored orientation of the pair is covered.
+  std::optional<KllSketch> GetQuantileSketch(
+      const std::string& currency1, const std::string& currency2,
+      const DateRange& range = DateRange()) const;
+
+  // Estimated memory held by the repository. Walks every record and index
+  // entry, so it costs about as much as a full scan.
+  MemoryUsageReport MemoryUsage() const;
+  // Soft limit on MemoryUsage().Total() in bytes; 0 (the default) means
+  // none. The budget is applied when set, and after a file load or
+  // refresh (but not on Add()) that takes a running estimate of the usage
+  // over it. The estimate adds the expected cost of each stored record to the
+  // last full measurement; after a failed EnforceMemoryBudget() the
+  // budget is next applied once the estimate has grown by an eighth, so
+  // appending to a repository that cannot meet it stays cheap.
+  void SetMemoryBudget(size_t bytes);
+  size_t memory_budget() const { return memory_budget_; }
+  // While over budget, releases spare capacity, then copies the records
+  // into exactly sized storage (compacting their strings), then rebuilds
+  // the lookup index into exactly sized storage. Returns false if the
+  // repository is still over budget afterwards; until the records change,
+  // further calls then return false at once.
+  bool EnforceMemoryBudget();
+
 private:
   std::vector<CurrencyRate> rates_;
   std::unique_ptr<ICurrencyRateParser> parser_;
+  std::unique_ptr<RollingStatisticsTracker> rolling_stats_;
+  std::unique_ptr<QuantileSketchTracker> quantile_sketches_;
+
+  // Rebuilt whenever positions in |rates_| change, by sorting or
+  // compaction; const methods only read it, so they are safe to call
+  // concurrently.
+  CurrencyRateIndex index_;
+
+  std::map<std::string, SourceCheckpoint> checkpoints_;
+
+  bool format_detection_ = false;
+  int detection_scale_ = RegexCurrencyRateParser::kFloatingPoint;
+  // Parsers detected for loaded files, reused by Refresh().
+  std::map<std::string, std::shared_ptr<ICurrencyRateParser>> source_parsers_;
+
+  bool canonical_pairs_ = false;
+  size_t canonical_duplicates_ = 0;
+
+  size_t memory_budget_ = 0;
+  // MemoryUsage().Total() as last measured plus RecordFootprint() and the
+  // storage growth of every record stored since. Only meaningful while a
+  // budget is set.
+  size_t estimated_usage_ = 0;
+  bool budget_failed_ = false;
+  uint64_t budget_failed_generation_ = 0;
+  // Estimate at which the budget is applied again after failing.
+  size_t budget_retry_usage_ = 0;
+  uint64_t generation_ = 0;
+
+  void Insert(const CurrencyRate& rate);
+  // Parses lines from |input| starting at |checkpoint|, advancing it past
+  // every consumed line, and hands each rate to |sink|. An unterminated
+  // last line is parsed only if |consume_unterminated|; otherwise it may
+  // still be being written and is left for the next call. Diagnostics go
+  // to |log|. Returns the number of rates parsed.
+  size_t LoadLines(const ICurrencyRateParser& parser, std::istream& input,
+                   bool consume_unterminated,
+                   SourceCheckpoint* checkpoint, std::ostream& log,
+                   const std::function<void(const CurrencyRate&)>& sink,
+                   size_t* rejected = nullptr) const;
+  void Store(const CurrencyRate& rate);
+  // Grows |rates_| and counts the new capacity in the usage estimate.
+  void ReserveRecords(size_t capacity);
+  // EnforceMemoryBudget() without the bookkeeping.
+  bool CompactToBudget();
+  // EnforceMemoryBudget() if the usage estimate calls for it.
+  void ApplyMemoryBudget();
+  // Replaces the usage estimate with a full measurement.
+  void RemeasureMemory();
+  // Null unless format detection is on.
+  std::shared_ptr<ICurrencyRateParser> DetectParser(
+      const std::string& filename) const;
+  const ICurrencyRateParser& SourceParser(const std::string& filename) const;
+  std::vector<CurrencyRate> QueryCanonicalPairs(
+      const CompiledFilter& filter) const;
+  const CurrencyRateIndex& index() const { return index_; }
+  std::vector<CurrencyRate> Collect(const std::vector<size_t>& positions) const;
 
   void Sort(const std::function<bool(const CurrencyRate&,
                                      const CurrencyRate&)>& comparator);
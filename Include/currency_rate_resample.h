@@ -0,0 +1,72 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_RESAMPLE_H_
+#define CURRENCY_RATE_RESAMPLE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "currency_pair.h"
+#include "currency_rate.h"
+#include "currency_rate_aggregation.h"
+
+enum class ResampleCalendar { kAllDays, kWeekdays };
+
+enum class GapFill {
+  // The latest earlier quote, also from before the range.
+  kForward,
+  // Straight line between the quotes around the gap, also from outside
+  // the range; no extrapolation past the first or last quote.
+  kLinear,
+  // Only days with a quote get a value.
+  kNaN
+};
+
+struct ResampleOptions {
+  // First and last day of the matrix, both "YYYY.MM.DD" and required.
+  std::string from;
+  std::string to;
+  ResampleCalendar calendar = ResampleCalendar::kWeekdays;
+  GapFill fill = GapFill::kForward;
+  PairFilter pair_filter;
+  // 0 selects the hardware concurrency.
+  size_t max_threads = 0;
+};
+
+// Dense pair x day matrix in one row-major buffer: row i holds pair i,
+// column j day j. Days without a value hold NaN.
+struct RateMatrix {
+  // In pair order.
+  std::vector<CurrencyPair> pairs;
+  std::vector<std::string> days;
+  std::vector<double> values;
+
+  size_t rows() const { return pairs.size(); }
+  size_t columns() const { return days.size(); }
+  double at(size_t row, size_t column) const {
+    return values[row * days.size() + column];
+  }
+  const double* row(size_t index) const {
+    return values.data() + index * days.size();
+  }
+};
+
+class CurrencyRateResampler {
+public:
+  // One row per pair quoted anywhere in |rates| that matches the pair
+  // filter; a day quoted several times takes the quote stored last. Rows
+  // are filled in parallel, each straight into its slice of the buffer.
+  // Throws InvalidDateException if a bound is not a valid date; a range
+  // ending before it starts has no columns.
+  static RateMatrix Resample(const std::vector<CurrencyRate>& rates,
+                             const ResampleOptions& options);
+
+  // Day numbers of the calendar days in [from, to].
+  static std::vector<int> CalendarDays(int from, int to,
+                                       ResampleCalendar calendar);
+};
+
+#endif  // CURRENCY_RATE_RESAMPLE_H_
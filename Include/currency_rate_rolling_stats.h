@@ -0,0 +1,90 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_ROLLING_STATS_H_
+#define CURRENCY_RATE_ROLLING_STATS_H_
+
+#include <cstddef>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "currency_pair.h"
+#include "currency_rate.h"
+#include "currency_rate_memory.h"
+
+struct RollingIndicators {
+  size_t window = 0;
+  // Number of rates currently inside the window (at most |window|).
+  size_t count = 0;
+  double sma = 0.0;
+  double ema = 0.0;
+  // Sample standard deviation of the log returns inside the window.
+  double volatility = 0.0;
+};
+
+// Rolling statistics of one rate series over several window lengths.
+// A window of N covers the last N observations. Every update is O(1).
+class RollingWindowStatistics {
+public:
+  explicit RollingWindowStatistics(const std::vector<size_t>& windows);
+
+  void Add(double rate);
+  // Throws std::out_of_range if |window| was not configured.
+  RollingIndicators Get(size_t window) const;
+  // Bytes of the ring buffers.
+  size_t HeapBytes() const;
+
+private:
+  struct Window {
+    size_t length = 0;
+    double ema_alpha = 0.0;
+    double ema = 0.0;
+
+    // Ring buffers of the last |length| rates and log returns.
+    std::vector<double> rates;
+    std::vector<double> returns;
+    size_t rates_count = 0;
+    size_t rates_head = 0;
+    size_t returns_count = 0;
+    size_t returns_head = 0;
+
+    double rate_sum = 0.0;
+    double return_sum = 0.0;
+    double return_square_sum = 0.0;
+  };
+
+  static void Push(Window* window, double rate, bool has_return,
+                   double log_return);
+  static void Resum(Window* window);
+
+  std::vector<Window> windows_;
+  double last_rate_ = 0.0;
+  bool has_last_rate_ = false;
+};
+
+// Per-pair rolling statistics maintained incrementally as rates arrive.
+// Rates are applied in arrival order, so each pair is expected to be fed
+// chronologically.
+class RollingStatisticsTracker {
+public:
+  // Throws std::invalid_argument if |windows| is empty or contains zero.
+  explicit RollingStatisticsTracker(std::vector<size_t> windows);
+
+  void Add(const CurrencyRate& rate);
+  void Clear();
+
+  std::optional<RollingIndicators> Get(const CurrencyPair& pair,
+                                       size_t window) const;
+  const std::vector<size_t>& windows() const { return windows_; }
+  // Adds the per-pair series to |usage->caches|.
+  void AccountMemory(MemoryUsageReport* usage) const;
+
+private:
+  std::vector<size_t> windows_;
+  std::unordered_map<CurrencyPair, RollingWindowStatistics, CurrencyPairHash>
+      series_;
+};
+
+#endif  // CURRENCY_RATE_ROLLING_STATS_H_
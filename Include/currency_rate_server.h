@@ -0,0 +1,136 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_SERVER_H_
+#define CURRENCY_RATE_SERVER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "currency_rate_parser.h"
+#include "currency_rate_repository.h"
+
+struct ServerOptions {
+  // Unix domain socket path. Used unless |tcp_port| is set.
+  std::string socket_path;
+  // Listen on 127.0.0.1:|tcp_port| instead of a Unix socket.
+  uint16_t tcp_port = 0;
+  size_t worker_threads = 4;
+  // File that receives rates added over the wire. Empty disables logging.
+  std::string append_log;
+  std::chrono::milliseconds flush_interval{20};
+  size_t max_log_batch = 4096;
+  // Watch the repository's source files and load appended lines.
+  bool follow_sources = false;
+};
+
+// Keeps a repository resident and answers queries over a local socket.
+//
+// Protocol: one request per line, fields separated by TAB characters.
+//   PING
+//   COUNT
+//   ASOF     <from> <to> <date>
+//   RANGE    <from> <to> <date from> <date to>   (empty bound is open)
+//   FILTER   <filter expression>
+//   CONVERT  <amount> <from> <to> <date>
+//   ADD      <rate line in file format>
+// A response starts with "OK <n>" followed by n result lines, or is a
+// single "ERR <message>" line. Rates are printed in file format.
+//
+// A poll loop owns the connections and hands one to a worker only when
+// it has data or, with replies pending, room to send them; the worker
+// answers the complete requests received without blocking and gives the
+// connection back. Idle clients, and clients that do not read their
+// replies, therefore hold no worker, and any number of them can stay
+// connected. A request line longer than 64 KiB is answered with ERR and
+// the connection closed.
+//
+// Reads run concurrently under a shared lock. An ADD is applied to the
+// repository at once and queued for the append log, which a writer thread
+// flushes in batches. With |follow_sources| a follower thread refreshes
+// the repository under the exclusive lock as the source files grow.
+class CurrencyRateServer {
+public:
+  CurrencyRateServer(MemoryCurrencyRateRepository* repository,
+                     ServerOptions options);
+  ~CurrencyRateServer();
+
+  CurrencyRateServer(const CurrencyRateServer&) = delete;
+  CurrencyRateServer& operator=(const CurrencyRateServer&) = delete;
+
+  // Binds the socket and starts the poll and worker threads. Throws
+  // std::runtime_error if the socket cannot be created.
+  void Start();
+  // Stops accepting, closes connections and flushes the append log.
+  void Stop();
+
+  // Executes one request line and returns the full response.
+  std::string HandleRequest(const std::string& line);
+
+  // TCP port bound by Start(); 0 when serving a Unix socket.
+  uint16_t port() const { return bound_port_; }
+
+private:
+  struct Connection {
+    int fd;
+    // Received bytes after the last complete request line.
+    std::string buffer;
+    // Replies the socket has not taken yet.
+    std::string output;
+  };
+
+  std::string HandleAdd(const std::string& line);
+  void PollLoop();
+  void WorkerLoop();
+  // Sends pending replies, then reads what |connection| has received and
+  // answers it. Returns false once the peer is gone or the connection
+  // must be dropped.
+  bool ServeConnection(Connection* connection);
+  // Hands a connection back to the poll loop and wakes it.
+  void ReturnConnection(std::unique_ptr<Connection> connection);
+  void WriterLoop();
+  void FlushLog(std::vector<std::string>* lines);
+
+  MemoryCurrencyRateRepository* repository_;
+  ServerOptions options_;
+  std::unique_ptr<ICurrencyRateParser> parser_;
+
+  // The repository's const queries only read it, so they run in parallel
+  // under the shared lock.
+  std::shared_mutex repository_mutex_;
+
+  int listen_fd_ = -1;
+  uint16_t bound_port_ = 0;
+  std::atomic<bool> running_{false};
+  std::thread poller_;
+  std::vector<std::thread> workers_;
+  // Written to wake the poll loop; read end first.
+  int wake_fds_[2] = {-1, -1};
+
+  std::mutex connections_mutex_;
+  std::condition_variable connections_ready_;
+  // Connections with data, waiting for a worker.
+  std::deque<std::unique_ptr<Connection>> ready_connections_;
+  // Connections served by a worker, waiting to be polled again.
+  std::vector<std::unique_ptr<Connection>> returned_connections_;
+
+  std::mutex log_mutex_;
+  std::condition_variable log_ready_;
+  std::vector<std::string> pending_log_;
+  std::thread writer_;
+
+  std::atomic<bool> stop_following_{false};
+  std::thread follower_;
+};
+
+#endif  // CURRENCY_RATE_SERVER_H_
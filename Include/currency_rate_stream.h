@@ -0,0 +1,56 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_STREAM_H_
+#define CURRENCY_RATE_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "currency_rate.h"
+#include "currency_rate_parser.h"
+
+struct StreamOptions {
+  // Size of each of the two read-ahead buffers.
+  size_t buffer_size = 1 << 20;
+  // Rates handed to the sink per call.
+  size_t batch_size = 4096;
+  // Longest line kept when it spans buffers. A longer one is dropped as
+  // it is read and counted as rejected, so memory stays bounded.
+  size_t max_line_length = 64 * 1024;
+};
+
+struct StreamStats {
+  size_t lines = 0;
+  size_t records = 0;
+  size_t rejected = 0;
+  uint64_t bytes = 0;
+  // True when the sink asked to stop before the end of the file.
+  bool stopped = false;
+};
+
+// Receives parsed rates in batches. The batch is reused after the call
+// returns. Returning false stops the stream.
+using RateBatchSink = std::function<bool(const std::vector<CurrencyRate>&)>;
+
+// One-pass reading of rate files without retaining the records.
+//
+// A reader thread fills two fixed-size buffers while the calling thread
+// parses the other one and feeds the sink, so I/O and parsing overlap.
+// The reader waits while both buffers are full, which makes a slow sink
+// throttle the read. Memory use does not depend on the file size.
+class CurrencyRateStreamReader {
+public:
+  // Throws std::runtime_error if the file cannot be opened or read.
+  // Invalid lines are reported on stderr and counted as rejected.
+  static StreamStats StreamFile(const std::string& filename,
+                                const ICurrencyRateParser& parser,
+                                const RateBatchSink& sink,
+                                const StreamOptions& options = StreamOptions());
+};
+
+#endif  // CURRENCY_RATE_STREAM_H_
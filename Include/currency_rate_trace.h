@@ -0,0 +1,97 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef CURRENCY_RATE_TRACE_H_
+#define CURRENCY_RATE_TRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Span tracing exported as Chrome trace-event JSON (chrome://tracing,
+// ui.perfetto.dev).
+//
+// Each thread records into its own ring buffer, so recording never
+// contends with other threads; a full buffer overwrites its oldest spans.
+// Buffers outlive their threads until Clear(). While tracing is off a span
+// costs one relaxed atomic load.
+class TraceRecorder {
+public:
+  static constexpr size_t kDefaultBufferCapacity = 1 << 16;
+
+  static void Enable() { enabled_.store(true, std::memory_order_relaxed); }
+  static void Disable() { enabled_.store(false, std::memory_order_relaxed); }
+  static bool IsEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // Spans kept per thread; applies to buffers created afterwards.
+  static void SetBufferCapacity(size_t capacity);
+  // Names the calling thread in the trace. Ignored while tracing is off.
+  static void SetThreadName(const std::string& name);
+  // Drops recorded spans and the buffers of finished threads.
+  static void Clear();
+
+  // Spans recorded so far, including overwritten ones.
+  static uint64_t RecordedCount();
+  static std::string ToChromeTrace();
+  // Throws std::runtime_error if the file cannot be written.
+  static void WriteChromeTrace(const std::string& filename);
+
+  // |name| must outlive the trace (a string literal).
+  static void Record(const char* name, std::string detail,
+                     uint64_t start_ns, uint64_t end_ns);
+  // Nanoseconds since the trace epoch.
+  static uint64_t Now();
+
+private:
+  static std::atomic<bool> enabled_;
+};
+
+// Records the time from construction to destruction as one span. Whether
+// tracing is on is decided at construction.
+class TraceSpan {
+public:
+  explicit TraceSpan(const char* name) : name_(name) {
+    if (TraceRecorder::IsEnabled()) {
+      start_ = TraceRecorder::Now();
+      active_ = true;
+    }
+  }
+  // |detail| (e.g. a file name) is shown as the span's argument.
+  TraceSpan(const char* name, const std::string& detail) : name_(name) {
+    if (TraceRecorder::IsEnabled()) {
+      detail_ = detail;
+      start_ = TraceRecorder::Now();
+      active_ = true;
+    }
+  }
+  ~TraceSpan() {
+    if (active_) {
+      TraceRecorder::Record(name_, std::move(detail_), start_,
+                            TraceRecorder::Now());
+    }
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+  const char* name_;
+  std::string detail_;
+  uint64_t start_ = 0;
+  bool active_ = false;
+};
+
+#define CURRENCY_RATE_TRACE_CONCAT_(a, b) a##b
+#define CURRENCY_RATE_TRACE_CONCAT(a, b) CURRENCY_RATE_TRACE_CONCAT_(a, b)
+
+// Traces the rest of the enclosing scope: CURRENCY_RATE_TRACE_SPAN("Sort")
+// or CURRENCY_RATE_TRACE_SPAN("AddFromFile", filename).
+#define CURRENCY_RATE_TRACE_SPAN(...) \
+  TraceSpan CURRENCY_RATE_TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+
+#endif  // CURRENCY_RATE_TRACE_H_
@@ -7,14 +7,18 @@
 
 #include <string>
 
+#include "fixed_rate.h"
+
 class CurrencyRateValidator {
 public:
   static bool IsValidCurrencyName(const std::string& name);
   static bool IsValidRate(double rate);
+  static bool IsValidRate(const FixedRate& rate);
   static bool IsValidDate(const std::string& date);
 
   static void ValidateCurrencyName(const std::string& name);
   static void ValidateRate(double rate);
+  static void ValidateRate(const FixedRate& rate);
   static void ValidateDate(const std::string& date);
 
 private:
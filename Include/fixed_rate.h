@@ -0,0 +1,53 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef FIXED_RATE_H_
+#define FIXED_RATE_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Decimal rate held as an integer number of 10^-scale units, so that a
+// rate read from text compares, sorts and sums exactly.
+//
+// The scale is limited to 9 digits: every valid rate (below 1000000) then
+// stays under 2^53 units and converts to double without loss.
+class FixedRate {
+public:
+  static constexpr int kMaxScale = 9;
+
+  FixedRate() = default;
+  // Throws std::invalid_argument if |scale| is outside [0, kMaxScale].
+  FixedRate(int64_t units, int scale);
+
+  // Parses unsigned decimal text such as "1.0870". Digits beyond |scale|
+  // are rounded half to even. Returns false on other characters or when
+  // the value does not fit.
+  static bool Parse(std::string_view text, int scale, FixedRate* rate);
+  // Nearest multiple of 10^-scale.
+  static FixedRate FromDouble(double value, int scale);
+  static int64_t Pow10(int exponent);
+
+  int64_t units() const { return units_; }
+  int scale() const { return scale_; }
+  double ToDouble() const;
+  // All significant decimals, but at least four (or |scale| if fewer).
+  std::string ToString() const;
+  // 1/rate at kMaxScale, whatever the scale of this rate, so that large
+  // rates keep their significant digits. Inverting twice returns the rate
+  // only to within rounding. Throws InvalidRateException for zero.
+  FixedRate Inverse() const;
+
+  // Exact comparisons, also between different scales.
+  bool operator==(const FixedRate& other) const;
+  bool operator!=(const FixedRate& other) const { return !(*this == other); }
+  bool operator<(const FixedRate& other) const;
+
+private:
+  int64_t units_ = 0;
+  int scale_ = 0;
+};
+
+#endif  // FIXED_RATE_H_
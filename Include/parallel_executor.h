@@ -0,0 +1,23 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef PARALLEL_EXECUTOR_H_
+#define PARALLEL_EXECUTOR_H_
+
+#include <cstddef>
+#include <functional>
+
+class ParallelExecutor {
+public:
+  // Calls |body| for every index in [0, count) on up to |max_threads|
+  // threads (0 selects the hardware concurrency). Indices are handed out
+  // dynamically, so uneven work items balance across workers. The first
+  // exception thrown by |body| is rethrown on the calling thread.
+  static void For(size_t count, size_t max_threads,
+                  const std::function<void(size_t)>& body);
+
+  static size_t DefaultThreadCount();
+};
+
+#endif  // PARALLEL_EXECUTOR_H_
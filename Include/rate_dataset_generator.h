@@ -0,0 +1,78 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef RATE_DATASET_GENERATOR_H_
+#define RATE_DATASET_GENERATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class DatasetOrder {
+  kDate,      // by date, all pairs of a date together
+  kCurrency,  // by pair, each pair in date order
+  kShuffled,  // date order shuffled within windows of shuffle_window lines
+};
+
+struct DatasetOptions {
+  uint64_t seed = 1;
+  size_t pair_count = 20;
+  // Both dates must pass CurrencyRateValidator::IsValidDate.
+  std::string first_date = "2000.01.01";
+  std::string last_date = "2023.12.31";
+  // Lines to write; 0 writes one quote per pair and day. Quotes of a pair
+  // are spread evenly over the span, several per day when there are more
+  // quotes than days.
+  uint64_t records = 0;
+  // Largest relative change of a rate between consecutive quotes.
+  double volatility = 0.01;
+  // Share of lines naming currencies by quoted multi-word names
+  // ("US Dollar") instead of codes.
+  double quoted_fraction = 0.0;
+  // Share of lines that no parser accepts.
+  double malformed_fraction = 0.0;
+  DatasetOrder order = DatasetOrder::kDate;
+  size_t shuffle_window = 1 << 20;
+};
+
+struct DatasetStats {
+  uint64_t lines = 0;
+  uint64_t malformed = 0;
+  uint64_t bytes = 0;
+};
+
+// Writes synthetic rate files for scale testing. Every pair follows its
+// own random walk from its own generator, so the same options and seed
+// always give the same lines, and the orders differ only in arrangement
+// (the shuffled order aside, which also depends on the window size).
+// Lines are formatted into a reusable buffer and written in large blocks.
+class RateDatasetGenerator {
+public:
+  // Receives the lines of one block, each terminated by '\n'.
+  using BlockSink = std::function<void(std::string_view)>;
+
+  // Throws std::invalid_argument on invalid options.
+  explicit RateDatasetGenerator(DatasetOptions options);
+
+  DatasetStats Write(std::ostream& out) const;
+  // Throws std::runtime_error if the file cannot be written.
+  DatasetStats WriteFile(const std::string& filename) const;
+  DatasetStats Generate(const BlockSink& sink) const;
+  // Convenience for small datasets: the lines without terminators.
+  std::vector<std::string> GenerateLines() const;
+
+  uint64_t LineCount() const;
+  const DatasetOptions& options() const { return options_; }
+
+private:
+  DatasetOptions options_;
+  int first_day_;
+  int day_count_;
+};
+
+#endif  // RATE_DATASET_GENERATOR_H_
@@ -0,0 +1,33 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#ifndef RATE_FORMAT_H_
+#define RATE_FORMAT_H_
+
+#include <string>
+#include <string_view>
+
+// Locale-independent decimal conversions for rates and amounts, built on
+// std::from_chars and std::to_chars.
+class RateFormat {
+public:
+  // Decimals written to rate files and shown to the user.
+  static constexpr int kDisplayDecimals = 4;
+
+  // Parses all of |text| as a number with '.' as the decimal separator
+  // and an optional exponent, correctly rounded. Returns false on any
+  // other character or on overflow.
+  static bool Parse(std::string_view text, double* value);
+
+  // |value| with exactly |decimals| digits after the point.
+  static std::string ToFixed(double value, int decimals = kDisplayDecimals);
+  static void AppendFixed(double value, int decimals, std::string* out);
+
+  // |value| with four decimals when that reads back as the same double,
+  // otherwise the shortest fixed notation that does.
+  static std::string ToExact(double value);
+  static void AppendExact(double value, std::string* out);
+};
+
+#endif  // RATE_FORMAT_H_
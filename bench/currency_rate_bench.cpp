@@ -0,0 +1,385 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+// Micro- and macrobenchmarks of parsing, validation, formatting, sorting,
+// file loading/saving, filtering and diffing.
+//
+// Datasets come from RateDatasetGenerator with a fixed seed, so the
+// numbers of two runs are comparable. Throughput is reported as items (lines or records) and bytes
+// per second. Configure with -DCMAKE_BUILD_TYPE=Release for meaningful
+// timings. For a JSON report run e.g.
+//   currency_rate_bench --benchmark_out=run.json --benchmark_out_format=json
+// and compare two reports with Google Benchmark's tools/compare.py.
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "currency_rate.h"
+#include "currency_rate_conversion.h"
+#include "currency_rate_diff.h"
+#include "currency_rate_filter.h"
+#include "currency_rate_parser.h"
+#include "currency_rate_repository.h"
+#include "currency_rate_validator.h"
+#include "rate_dataset_generator.h"
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+constexpr uint64_t kSeed = 20240101;
+constexpr size_t kMicroSetSize = 4096;
+
+// Shuffled, so that sorting has work to do.
+DatasetOptions BenchDataset(size_t records) {
+  DatasetOptions options;
+  options.seed = kSeed;
+  options.pair_count = 50;
+  options.records = records;
+  options.order = DatasetOrder::kShuffled;
+  return options;
+}
+
+vector<string> GenerateLines(size_t count) {
+  return RateDatasetGenerator(BenchDataset(count)).GenerateLines();
+}
+
+vector<CurrencyRate> GenerateRates(size_t count) {
+  auto parser = CurrencyRateParserFactory::CreateDefaultParser();
+  vector<CurrencyRate> rates;
+  rates.reserve(count);
+  for (const auto& line : GenerateLines(count)) {
+    rates.push_back(parser->Parse(line));
+  }
+  return rates;
+}
+
+uint64_t TotalBytes(const vector<string>& lines) {
+  uint64_t bytes = 0;
+  for (const auto& line : lines) {
+    bytes += line.size() + 1;
+  }
+  return bytes;
+}
+
+// Rate files of the macrobenchmarks, written once per size and removed
+// when the program exits.
+class DatasetFiles {
+public:
+  ~DatasetFiles() {
+    std::error_code error;
+    for (const auto& entry : files_) {
+      std::filesystem::remove(entry.second, error);
+    }
+  }
+
+  const string& Get(size_t records) {
+    auto found = files_.find(records);
+    if (found != files_.end()) {
+      return found->second;
+    }
+
+    string filename =
+        (std::filesystem::temp_directory_path() /
+         ("currency_rate_bench_" + std::to_string(records) + ".txt"))
+            .string();
+    RateDatasetGenerator(BenchDataset(records)).WriteFile(filename);
+    return files_.emplace(records, filename).first->second;
+  }
+
+private:
+  map<size_t, string> files_;
+};
+
+DatasetFiles& Datasets() {
+  static DatasetFiles datasets;
+  return datasets;
+}
+
+uint64_t FileSize(const string& filename) {
+  return static_cast<uint64_t>(std::filesystem::file_size(filename));
+}
+
+std::unique_ptr<MemoryCurrencyRateRepository> LoadRepository(size_t records) {
+  auto repository = std::make_unique<MemoryCurrencyRateRepository>(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  repository->AddFromFile(Datasets().Get(records));
+  return repository;
+}
+
+void ReportThroughput(benchmark::State& state, uint64_t items,
+                      uint64_t bytes) {
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * items));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+
+// Microbenchmarks
+
+void BM_Parse(benchmark::State& state) {
+  RegexCurrencyRateParser parser;
+  vector<string> lines = GenerateLines(kMicroSetSize);
+
+  for (auto _ : state) {
+    for (const auto& line : lines) {
+      benchmark::DoNotOptimize(parser.Parse(line));
+    }
+  }
+  ReportThroughput(state, lines.size(), TotalBytes(lines));
+}
+BENCHMARK(BM_Parse);
+
+void BM_IsValidDate(benchmark::State& state) {
+  vector<string> dates;
+  for (const auto& rate : GenerateRates(kMicroSetSize)) {
+    dates.push_back(rate.date());
+  }
+
+  for (auto _ : state) {
+    for (const auto& date : dates) {
+      benchmark::DoNotOptimize(CurrencyRateValidator::IsValidDate(date));
+    }
+  }
+  ReportThroughput(state, dates.size(), TotalBytes(dates));
+}
+BENCHMARK(BM_IsValidDate);
+
+void BM_ToFileString(benchmark::State& state) {
+  vector<CurrencyRate> rates = GenerateRates(kMicroSetSize);
+  uint64_t bytes = 0;
+  for (const auto& rate : rates) {
+    bytes += rate.ToFileString().size() + 1;
+  }
+
+  for (auto _ : state) {
+    for (const auto& rate : rates) {
+      benchmark::DoNotOptimize(rate.ToFileString());
+    }
+  }
+  ReportThroughput(state, rates.size(), bytes);
+}
+BENCHMARK(BM_ToFileString);
+
+// Sorts a freshly filled repository each iteration; refilling is not timed.
+template <void (MemoryCurrencyRateRepository::*Sort)()>
+void BM_Sort(benchmark::State& state) {
+  size_t count = static_cast<size_t>(state.range(0));
+  vector<CurrencyRate> rates = GenerateRates(count);
+  MemoryCurrencyRateRepository repository(
+      CurrencyRateParserFactory::CreateDefaultParser());
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    repository.Clear();
+    for (const auto& rate : rates) {
+      repository.Add(rate);
+    }
+    state.ResumeTiming();
+
+    (repository.*Sort)();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+}
+BENCHMARK_TEMPLATE(BM_Sort, &MemoryCurrencyRateRepository::SortByDate)
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Sort, &MemoryCurrencyRateRepository::SortByCurrency)
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+// Macrobenchmarks over 10K, 1M and 10M record files.
+
+void DatasetSizes(benchmark::internal::Benchmark* benchmark) {
+  benchmark->Arg(10000)->Arg(1000000)->Arg(10000000);
+  benchmark->Unit(benchmark::kMillisecond);
+}
+
+void BM_AddFromFile(benchmark::State& state) {
+  size_t count = static_cast<size_t>(state.range(0));
+  const string& filename = Datasets().Get(count);
+
+  for (auto _ : state) {
+    MemoryCurrencyRateRepository repository(
+        CurrencyRateParserFactory::CreateDefaultParser());
+    repository.AddFromFile(filename);
+    benchmark::DoNotOptimize(repository.Count());
+  }
+  ReportThroughput(state, count, FileSize(filename));
+}
+BENCHMARK(BM_AddFromFile)->Apply(DatasetSizes);
+
+void BM_SaveToFile(benchmark::State& state) {
+  size_t count = static_cast<size_t>(state.range(0));
+  auto repository = LoadRepository(count);
+  string filename =
+      (std::filesystem::temp_directory_path() / "currency_rate_bench_out.txt")
+          .string();
+
+  for (auto _ : state) {
+    repository->SaveToFile(filename);
+  }
+  ReportThroughput(state, count, FileSize(filename));
+  std::filesystem::remove(filename);
+}
+BENCHMARK(BM_SaveToFile)->Apply(DatasetSizes);
+
+// Filters with and without an index to narrow the scan.
+const char* const kFilters[] = {
+    "rate > 100",
+    "currency = USD",
+    "pair = EUR/USD AND date >= 2010.01.01",
+};
+
+void BM_Query(benchmark::State& state) {
+  size_t count = static_cast<size_t>(state.range(0));
+  const char* text = kFilters[state.range(1)];
+  auto repository = LoadRepository(count);
+  FilterExpression expression = FilterExpression::Parse(text);
+  uint64_t bytes = FileSize(Datasets().Get(count));
+
+  size_t matches = 0;
+  for (auto _ : state) {
+    matches = repository->Query(expression).size();
+    benchmark::DoNotOptimize(matches);
+  }
+  state.SetLabel(text);
+  state.counters["matches"] = static_cast<double>(matches);
+  ReportThroughput(state, count, bytes);
+}
+BENCHMARK(BM_Query)
+    ->ArgsProduct({{10000, 1000000, 10000000}, {0, 1, 2}})
+    ->Unit(benchmark::kMillisecond);
+
+// Two sorted files where every 100th rate of the second differs.
+void BM_DiffFiles(benchmark::State& state) {
+  size_t count = static_cast<size_t>(state.range(0));
+  vector<CurrencyRate> rates = LoadRepository(count)->GetAll();
+  std::sort(rates.begin(), rates.end(), CurrencyRateDiff::KeyLess);
+
+  auto temp = std::filesystem::temp_directory_path();
+  string before = (temp / "currency_rate_bench_before.txt").string();
+  string after = (temp / "currency_rate_bench_after.txt").string();
+  {
+    std::ofstream before_file(before);
+    std::ofstream after_file(after);
+    for (size_t i = 0; i < rates.size(); ++i) {
+      before_file << rates[i].ToFileString() << '\n';
+      after_file << (i % 100 == 0
+                         ? CurrencyRate(rates[i].currency1(),
+                                        rates[i].currency2(),
+                                        rates[i].rate() * 1.01,
+                                        rates[i].date())
+                         : rates[i]).ToFileString()
+                 << '\n';
+    }
+  }
+  auto parser = CurrencyRateParserFactory::CreateDefaultParser();
+
+  size_t changed = 0;
+  for (auto _ : state) {
+    changed = CurrencyRateDiff::CompareFiles(before, after, *parser, nullptr)
+                  .changed;
+    benchmark::DoNotOptimize(changed);
+  }
+  state.counters["changed"] = static_cast<double>(changed);
+  ReportThroughput(state, 2 * count, FileSize(before) + FileSize(after));
+  std::filesystem::remove(before);
+  std::filesystem::remove(after);
+}
+BENCHMARK(BM_DiffFiles)->Apply(DatasetSizes);
+
+// Amounts over the stored pairs and dates, a third of them requested the
+// other way round, against a 10K record repository.
+void BM_ConvertBatch(benchmark::State& state) {
+  size_t count = static_cast<size_t>(state.range(0));
+  auto repository = LoadRepository(10000);
+  vector<CurrencyRate> rates = repository->GetAll();
+
+  vector<double> amounts(count);
+  vector<string> from(count);
+  vector<string> to(count);
+  vector<string> dates(count);
+  for (size_t i = 0; i < count; ++i) {
+    const CurrencyRate& rate = rates[(i * 7919) % rates.size()];
+    bool inverse = i % 3 == 0;
+    amounts[i] = static_cast<double>(i % 1000) + 0.25;
+    from[i] = inverse ? rate.currency2() : rate.currency1();
+    to[i] = inverse ? rate.currency1() : rate.currency2();
+    dates[i] = rate.date();
+  }
+  CurrencyConverter converter(*repository);
+  vector<double> out(count);
+
+  for (auto _ : state) {
+    converter.Convert(amounts, from, to, dates, out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  ReportThroughput(state, count, count * sizeof(double));
+}
+BENCHMARK(BM_ConvertBatch)
+    ->Arg(10000)
+    ->Arg(1000000)
+    ->Unit(benchmark::kMillisecond);
+
+// p1/p50/p99 of one pair over its whole history from the monthly
+// sketches.
+void BM_QuantileSketch(benchmark::State& state) {
+  size_t count = static_cast<size_t>(state.range(0));
+  auto repository = LoadRepository(count);
+  repository->EnableQuantileSketches();
+  CurrencyRate first = repository->GetAll().front();
+
+  vector<double> quantiles;
+  for (auto _ : state) {
+    quantiles = repository
+                    ->GetQuantileSketch(first.currency1(), first.currency2())
+                    ->Quantiles({0.01, 0.5, 0.99});
+    benchmark::DoNotOptimize(quantiles.data());
+  }
+  state.counters["cache_bytes"] =
+      static_cast<double>(repository->MemoryUsage().caches);
+}
+BENCHMARK(BM_QuantileSketch)
+    ->Arg(10000)
+    ->Arg(1000000)
+    ->Unit(benchmark::kMicrosecond);
+
+// Every date of the generated history; the pairs walk independently, so
+// most dates hold cycles.
+void BM_DetectArbitrage(benchmark::State& state) {
+  size_t count = static_cast<size_t>(state.range(0));
+  auto repository = LoadRepository(count);
+
+  size_t cycles = 0;
+  for (auto _ : state) {
+    cycles = repository->DetectArbitrage().size();
+    benchmark::DoNotOptimize(cycles);
+  }
+  state.counters["cycles"] = static_cast<double>(cycles);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+}
+BENCHMARK(BM_DetectArbitrage)->Apply(DatasetSizes);
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::AddCustomContext("dataset_seed", std::to_string(kSeed));
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
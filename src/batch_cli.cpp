@@ -0,0 +1,654 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "batch_cli.h"
+
+#include <charconv>
+#include <cmath>
+#include <csignal>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+#include "currency_rate_diff.h"
+#include "currency_rate_filter.h"
+#include "currency_rate_metrics.h"
+#include "currency_rate_parser.h"
+#include "currency_rate_query.h"
+#include "currency_rate_repository.h"
+#include "currency_rate_trace.h"
+#include "rate_format.h"
+
+#ifdef CURRENCY_RATE_HAVE_SERVER
+#include <pthread.h>
+
+#include "currency_rate_server.h"
+#endif
+
+using std::endl;
+using std::invalid_argument;
+using std::make_unique;
+using std::ofstream;
+using std::ostream;
+using std::runtime_error;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Accumulates output and hands it to the stream in large blocks.
+class BufferedWriter {
+public:
+  static constexpr size_t kCapacity = 1 << 20;
+
+  explicit BufferedWriter(ostream& out) : out_(out) {
+    buffer_.reserve(kCapacity + 256);
+  }
+  ~BufferedWriter() { Flush(); }
+
+  BufferedWriter& operator<<(const string& text) {
+    buffer_.append(text);
+    FlushIfFull();
+    return *this;
+  }
+  BufferedWriter& operator<<(const char* text) {
+    buffer_.append(text);
+    FlushIfFull();
+    return *this;
+  }
+  BufferedWriter& operator<<(char c) {
+    buffer_.push_back(c);
+    FlushIfFull();
+    return *this;
+  }
+  BufferedWriter& operator<<(size_t value) {
+    buffer_.append(std::to_string(value));
+    FlushIfFull();
+    return *this;
+  }
+
+  void WriteRate(double rate) {
+    RateFormat::AppendFixed(rate, RateFormat::kDisplayDecimals, &buffer_);
+  }
+
+  void Flush() {
+    if (!buffer_.empty()) {
+      out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+      buffer_.clear();
+    }
+    out_.flush();
+  }
+
+private:
+  void FlushIfFull() {
+    if (buffer_.size() >= kCapacity) {
+      out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+      buffer_.clear();
+    }
+  }
+
+  ostream& out_;
+  string buffer_;
+};
+
+const string& NextValue(const vector<string>& args, size_t* i) {
+  if (*i + 1 >= args.size()) {
+    throw invalid_argument("Missing value for " + args[*i]);
+  }
+  return args[++*i];
+}
+
+ResampleCalendar ParseCalendar(const string& name) {
+  if (name == "all") return ResampleCalendar::kAllDays;
+  if (name == "weekdays") return ResampleCalendar::kWeekdays;
+  throw invalid_argument("Unknown calendar: " + name);
+}
+
+GapFill ParseGapFill(const string& name) {
+  if (name == "forward") return GapFill::kForward;
+  if (name == "linear") return GapFill::kLinear;
+  if (name == "none") return GapFill::kNaN;
+  throw invalid_argument("Unknown gap fill: " + name);
+}
+
+AggregationBucket ParseBucket(const string& name) {
+  if (name == "day") return AggregationBucket::kDay;
+  if (name == "week") return AggregationBucket::kWeek;
+  if (name == "month") return AggregationBucket::kMonth;
+  if (name == "year") return AggregationBucket::kYear;
+  throw invalid_argument("Unknown aggregation bucket: " + name);
+}
+
+double ParseAmount(const string& text) {
+  double value = 0.0;
+  if (!RateFormat::Parse(text, &value)) {
+    throw invalid_argument("Invalid amount: " + text);
+  }
+  return value;
+}
+
+void WriteRateRow(BufferedWriter* writer, const CurrencyRate& rate) {
+  *writer << rate.currency1() << '/' << rate.currency2() << " | ";
+  writer->WriteRate(rate.rate());
+  *writer << " | " << rate.date() << '\n';
+}
+
+void WriteAggregateRow(BufferedWriter* writer,
+                       const RateAggregate& aggregate) {
+  *writer << aggregate.pair.ToString() << " | " << aggregate.bucket_start
+          << " | open ";
+  writer->WriteRate(aggregate.open);
+  *writer << " high ";
+  writer->WriteRate(aggregate.high);
+  *writer << " low ";
+  writer->WriteRate(aggregate.low);
+  *writer << " close ";
+  writer->WriteRate(aggregate.close);
+  *writer << " mean ";
+  writer->WriteRate(aggregate.mean);
+  *writer << " count " << aggregate.count << '\n';
+}
+
+void ExportRates(const string& filename, const RateQueryRange& rates) {
+  ofstream file(filename);
+  if (!file.is_open()) {
+    throw runtime_error("Failed to open file for writing: " + filename);
+  }
+
+  BufferedWriter writer(file);
+  for (const auto& rate : rates) {
+    writer << rate.ToFileString() << '\n';
+  }
+  writer.Flush();
+
+  if (!file) {
+    throw runtime_error("Failed to write file: " + filename);
+  }
+}
+
+// One CSV line per day with a column per pair; gaps are left empty.
+void WriteMatrix(BufferedWriter* writer, const RateMatrix& matrix) {
+  *writer << "date";
+  for (const auto& pair : matrix.pairs) {
+    *writer << ',' << pair.ToString();
+  }
+  *writer << '\n';
+
+  for (size_t column = 0; column < matrix.columns(); ++column) {
+    *writer << matrix.days[column];
+    for (size_t row = 0; row < matrix.rows(); ++row) {
+      *writer << ',';
+      double value = matrix.at(row, column);
+      if (!std::isnan(value)) {
+        *writer << RateFormat::ToExact(value);
+      }
+    }
+    *writer << '\n';
+  }
+}
+
+void WriteDifference(BufferedWriter* writer,
+                     const RateDifference& difference) {
+  switch (difference.kind) {
+    case RateDiffKind::kAdded:
+      *writer << "+ " << difference.pair.ToString() << " | "
+              << RateFormat::ToExact(difference.after_rate);
+      break;
+    case RateDiffKind::kRemoved:
+      *writer << "- " << difference.pair.ToString() << " | "
+              << RateFormat::ToExact(difference.before_rate);
+      break;
+    case RateDiffKind::kChanged:
+      *writer << "~ " << difference.pair.ToString() << " | "
+              << RateFormat::ToExact(difference.before_rate) << " -> "
+              << RateFormat::ToExact(difference.after_rate);
+      break;
+  }
+  *writer << " | " << difference.date << '\n';
+}
+
+// The parser for |filename|, detected from its contents if requested.
+std::unique_ptr<ICurrencyRateParser> FileParser(const BatchOptions& options,
+                                                const string& filename) {
+  if (options.detect_format) {
+    return CurrencyRateParserFactory::DetectFileParser(filename,
+                                                       options.fixed_scale);
+  }
+  return options.fixed_scale >= 0
+             ? CurrencyRateParserFactory::CreateFixedPointParser(
+                   options.fixed_scale)
+             : CurrencyRateParserFactory::CreateDefaultParser();
+}
+
+// Streams the two files of --diff through a merge join.
+void RunDiff(const BatchOptions& options, BufferedWriter* writer,
+             ostream& err) {
+  // The two sides may come from different systems, so each gets its own.
+  std::unique_ptr<ICurrencyRateParser> before_parser =
+      FileParser(options, options.diff_before);
+  std::unique_ptr<ICurrencyRateParser> after_parser =
+      FileParser(options, options.diff_after);
+
+  RateDiffOptions diff_options;
+  diff_options.absolute_tolerance = options.diff_tolerance;
+  RateDiffStats stats = CurrencyRateDiff::CompareFiles(
+      options.diff_before, options.diff_after, *before_parser, *after_parser,
+      [writer](const RateDifference& difference) {
+        WriteDifference(writer, difference);
+      },
+      diff_options);
+
+  writer->Flush();
+  err << stats.added << " added, " << stats.removed << " removed, "
+      << stats.changed << " changed, " << stats.unchanged << " unchanged";
+  if (stats.rejected > 0) {
+    err << ", " << stats.rejected << " lines rejected";
+  }
+  err << endl;
+}
+
+// Digits only: no sign, which std::stoul would accept and wrap.
+size_t ParseCount(const string& text, const string& what) {
+  size_t value = 0;
+  const char* end = text.data() + text.size();
+  auto result = std::from_chars(text.data(), end, value);
+  if (text.empty() || result.ec != std::errc() || result.ptr != end) {
+    throw invalid_argument("Invalid " + what + ": " + text);
+  }
+  return value;
+}
+
+#ifdef CURRENCY_RATE_HAVE_SERVER
+// Serves until SIGINT or SIGTERM. The signals are blocked before the
+// server threads start so that only sigwait() receives them.
+int Serve(MemoryCurrencyRateRepository* repository,
+          const BatchOptions& options, ostream& out) {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  ServerOptions server_options;
+  server_options.socket_path = options.socket_path;
+  server_options.tcp_port = options.tcp_port;
+  server_options.worker_threads = options.server_threads;
+  server_options.append_log = options.append_log;
+  server_options.follow_sources = options.follow;
+
+  CurrencyRateServer server(repository, server_options);
+  server.Start();
+
+  if (options.tcp_port != 0) {
+    out << "Serving " << repository->Count() << " rates on 127.0.0.1:"
+        << options.tcp_port << endl;
+  } else {
+    out << "Serving " << repository->Count() << " rates on "
+        << options.socket_path << endl;
+  }
+
+  int signal = 0;
+  sigwait(&signals, &signal);
+  server.Stop();
+  return BatchCommandLine::kExitOk;
+}
+#endif
+
+}  // namespace
+
+BatchOptions BatchCommandLine::Parse(const vector<string>& args) {
+  BatchOptions options;
+  // The last flag given of each group, for the conflict checks below.
+  string load_flag;
+  string query_flag;
+  // --aggregate, --convert, --resample or --arbitrage.
+  string mode_flag;
+  string server_flag;
+
+  for (size_t i = 0; i < args.size(); ++i) {
+    const string& arg = args[i];
+
+    if (arg == "--load") {
+      load_flag = arg;
+      options.load_files.push_back(NextValue(args, &i));
+    } else if (arg == "--load-dir") {
+      load_flag = arg;
+      options.load_directories.push_back(NextValue(args, &i));
+    } else if (arg == "--pattern") {
+      load_flag = arg;
+      options.load_pattern = NextValue(args, &i);
+    } else if (arg == "--filter") {
+      query_flag = arg;
+      options.filter = NextValue(args, &i);
+    } else if (arg == "--sort") {
+      query_flag = arg;
+      options.sort = NextValue(args, &i);
+      if (options.sort != "date" && options.sort != "currency") {
+        throw invalid_argument("Unknown sort order: " + options.sort);
+      }
+    } else if (arg == "--aggregate") {
+      mode_flag = arg;
+      options.aggregate = true;
+      options.bucket = ParseBucket(NextValue(args, &i));
+    } else if (arg == "--convert") {
+      mode_flag = arg;
+      options.convert = true;
+      options.amount = ParseAmount(NextValue(args, &i));
+      options.convert_from = NextValue(args, &i);
+      options.convert_to = NextValue(args, &i);
+      options.convert_date = NextValue(args, &i);
+    } else if (arg == "--offset") {
+      query_flag = arg;
+      options.offset = ParseCount(NextValue(args, &i), "offset");
+    } else if (arg == "--limit") {
+      query_flag = arg;
+      options.limit = ParseCount(NextValue(args, &i), "limit");
+    } else if (arg == "--latest") {
+      query_flag = arg;
+      options.limit = ParseCount(NextValue(args, &i), "count");
+      options.newest_first = true;
+    } else if (arg == "--resample") {
+      mode_flag = arg;
+      options.resample = true;
+      options.resample_from = NextValue(args, &i);
+      options.resample_to = NextValue(args, &i);
+    } else if (arg == "--calendar") {
+      options.calendar = ParseCalendar(NextValue(args, &i));
+    } else if (arg == "--fill") {
+      options.fill = ParseGapFill(NextValue(args, &i));
+    } else if (arg == "--arbitrage") {
+      mode_flag = arg;
+      options.arbitrage = true;
+      options.arbitrage_threshold = ParseAmount(NextValue(args, &i));
+      if (!(options.arbitrage_threshold > 0.0)) {
+        throw invalid_argument("Arbitrage threshold must be positive");
+      }
+    } else if (arg == "--diff") {
+      options.diff_before = NextValue(args, &i);
+      options.diff_after = NextValue(args, &i);
+    } else if (arg == "--tolerance") {
+      options.diff_tolerance = ParseAmount(NextValue(args, &i));
+    } else if (arg == "--export") {
+      query_flag = arg;
+      options.export_file = NextValue(args, &i);
+    } else if (arg == "--canonical") {
+      options.canonical_pairs = true;
+    } else if (arg == "--fixed-point") {
+      const string& digits = NextValue(args, &i);
+      if (digits.size() != 1 || digits[0] < '0' ||
+          digits[0] - '0' > FixedRate::kMaxScale) {
+        throw invalid_argument("Invalid fixed-point scale: " + digits);
+      }
+      options.fixed_scale = digits[0] - '0';
+    } else if (arg == "--detect-format") {
+      options.detect_format = true;
+    } else if (arg == "--metrics") {
+      options.metrics_file = NextValue(args, &i);
+    } else if (arg == "--trace") {
+      options.trace_file = NextValue(args, &i);
+    } else if (arg == "--memory-budget") {
+      options.memory_budget = ParseCount(NextValue(args, &i), "memory budget");
+    } else if (arg == "--memory-report") {
+      options.memory_report = true;
+#ifdef CURRENCY_RATE_HAVE_SERVER
+    } else if (arg == "--serve") {
+      options.serve = true;
+      options.socket_path = NextValue(args, &i);
+    } else if (arg == "--port") {
+      options.serve = true;
+      size_t port = ParseCount(NextValue(args, &i), "port");
+      if (port == 0 || port > 65535) {
+        throw invalid_argument("Invalid port: " + args[i]);
+      }
+      options.tcp_port = static_cast<uint16_t>(port);
+    } else if (arg == "--threads") {
+      server_flag = arg;
+      options.server_threads = ParseCount(NextValue(args, &i), "thread count");
+    } else if (arg == "--append-log") {
+      server_flag = arg;
+      options.append_log = NextValue(args, &i);
+    } else if (arg == "--follow") {
+      server_flag = arg;
+      options.follow = true;
+#endif
+    } else if (arg == "--help" || arg == "-h") {
+      options.help = true;
+    } else {
+      throw invalid_argument("Unknown option: " + arg);
+    }
+  }
+
+  // Combinations in which one of the options would be ignored.
+  if (!options.export_file.empty() && !mode_flag.empty()) {
+    throw invalid_argument("--export cannot be combined with " + mode_flag);
+  }
+  if (!options.diff_before.empty()) {
+    for (const string* flag : {&load_flag, &query_flag, &mode_flag}) {
+      if (!flag->empty()) {
+        throw invalid_argument("--diff cannot be combined with " + *flag);
+      }
+    }
+  }
+  if (!server_flag.empty() && !options.serve) {
+    throw invalid_argument(server_flag + " requires --serve or --port");
+  }
+  return options;
+}
+
+void BatchCommandLine::PrintUsage(ostream& out) {
+  out << "Usage: currency_rate_manager [options]\n"
+      << "Without options the program runs interactively.\n\n"
+      << "  --load FILE               load rates (repeatable)\n"
+      << "  --load-dir DIR            load every file in DIR (repeatable)\n"
+      << "  --pattern GLOB            only load-dir files matching GLOB\n"
+      << "  --canonical               store each pair in one orientation\n"
+      << "  --fixed-point K           keep rates as exact decimals with K "
+      << "digits (0-9)\n"
+      << "  --detect-format           accept CSV, semicolon and ISO-date "
+      << "files\n"
+      << "  --sort date|currency      sort before printing\n"
+      << "  --filter EXPR             e.g. \"pair = USD/EUR and "
+      << "date >= 2023.01.01\"\n"
+      << "  --offset N                skip the first N selected rates\n"
+      << "  --limit N                 select at most N rates\n"
+      << "  --latest N                select the N newest rates, newest "
+      << "first\n"
+      << "  --aggregate day|week|month|year\n"
+      << "                            print OHLC per pair and bucket\n"
+      << "  --convert AMOUNT FROM TO DATE\n"
+      << "                            convert an amount on a date\n"
+      << "  --resample FROM TO        print a CSV of every pair on every "
+      << "day\n"
+      << "  --calendar all|weekdays   days of --resample (default "
+      << "weekdays)\n"
+      << "  --fill forward|linear|none\n"
+      << "                            how --resample fills days without a "
+      << "quote\n"
+      << "  --arbitrage THRESHOLD     list same-day quote cycles that "
+      << "multiply to more\n"
+      << "                            than 1 + THRESHOLD\n"
+      << "  --export FILE             write selected rates to FILE\n"
+      << "  --diff OLD NEW            list rates added (+), removed (-) or "
+      << "changed (~)\n"
+      << "                            between two files sorted by pair "
+      << "and date\n"
+      << "  --tolerance X             ignore rate changes up to X\n"
+      << "  --metrics FILE            write timings and counters to FILE "
+      << "(Prometheus)\n"
+      << "  --trace FILE              write a Chrome trace of the run to "
+      << "FILE\n"
+      << "  --memory-budget BYTES     keep the loaded rates within BYTES\n"
+      << "  --memory-report           print the memory held after loading "
+      << "to stderr\n"
+#ifdef CURRENCY_RATE_HAVE_SERVER
+      << "  --serve SOCKET            answer queries on a Unix socket\n"
+      << "  --port N                  answer queries on 127.0.0.1:N\n"
+      << "  --threads N               server worker threads (default 4)\n"
+      << "  --append-log FILE         persist rates added over the wire\n"
+      << "  --follow                  load lines appended to loaded files\n"
+#endif
+      << "  --help                    show this message\n\n"
+      << "Exit status: 0 success, 1 usage error, 2 failure, "
+      << "3 rate not found.\n";
+}
+
+int BatchCommandLine::Run(const BatchOptions& options, ostream& out,
+                          ostream& err) {
+  if (options.help) {
+    PrintUsage(out);
+    return kExitOk;
+  }
+
+  MemoryCurrencyRateRepository repository(
+      options.fixed_scale >= 0
+          ? CurrencyRateParserFactory::CreateFixedPointParser(
+                options.fixed_scale)
+          : CurrencyRateParserFactory::CreateDefaultParser());
+  repository.SetCanonicalPairs(options.canonical_pairs);
+  repository.SetFormatDetection(options.detect_format, options.fixed_scale);
+  repository.SetMemoryBudget(options.memory_budget);
+
+  BufferedWriter writer(out);
+
+  try {
+    if (!options.diff_before.empty()) {
+      RunDiff(options, &writer, err);
+      return kExitOk;
+    }
+
+    vector<FileLoadStats> loaded = repository.AddFromFiles(options.load_files);
+    for (const auto& directory : options.load_directories) {
+      vector<FileLoadStats> stats = repository.AddFromDirectory(
+          directory, options.load_pattern);
+      loaded.insert(loaded.end(), stats.begin(), stats.end());
+    }
+    for (const auto& stats : loaded) {
+      if (!stats.error.empty()) {
+        throw runtime_error(stats.error);
+      }
+    }
+    if (options.memory_report) {
+      writer.Flush();
+      err << repository.MemoryUsage().ToString();
+    }
+
+#ifdef CURRENCY_RATE_HAVE_SERVER
+    if (options.serve) {
+      writer.Flush();
+      return Serve(&repository, options, out);
+    }
+#endif
+
+    if (options.sort == "date") {
+      repository.SortByDate();
+    } else if (options.sort == "currency") {
+      repository.SortByCurrency();
+    }
+
+    if (options.convert) {
+      auto rate = repository.GetRate(options.convert_from, options.convert_to,
+                                     options.convert_date);
+      if (!rate) {
+        writer.Flush();
+        err << "No rate for " << options.convert_from << "/"
+            << options.convert_to << " on " << options.convert_date << endl;
+        return kExitNotFound;
+      }
+      writer.WriteRate(options.amount * *rate);
+      writer << ' ' << options.convert_to << '\n';
+      return kExitOk;
+    }
+
+    if (options.resample) {
+      ResampleOptions resample;
+      resample.from = options.resample_from;
+      resample.to = options.resample_to;
+      resample.calendar = options.calendar;
+      resample.fill = options.fill;
+      WriteMatrix(&writer, repository.Resample(resample));
+      writer.Flush();
+      return out ? kExitOk : kExitFailure;
+    }
+
+    if (options.arbitrage) {
+      ArbitrageOptions arbitrage;
+      arbitrage.threshold = options.arbitrage_threshold;
+      vector<ArbitrageCycle> cycles = repository.DetectArbitrage(arbitrage);
+      for (const auto& cycle : cycles) {
+        writer << cycle.ToString() << '\n';
+      }
+      writer.Flush();
+      err << cycles.size() << " inconsistent cycles" << endl;
+      return out ? kExitOk : kExitFailure;
+    }
+
+    QueryOptions query;
+    query.offset = options.offset;
+    query.limit = options.limit;
+    if (options.newest_first) {
+      query.order = QueryOrder::kDateDescending;
+    }
+    RateQueryRange selected = repository.QueryRange(
+        options.filter.empty() ? FilterExpression()
+                               : FilterExpression::Parse(options.filter),
+        query);
+
+    if (!options.export_file.empty()) {
+      ExportRates(options.export_file, selected);
+    } else if (options.aggregate) {
+      for (const auto& aggregate : CurrencyRateAggregator::Aggregate(
+               selected.ToVector(), PairFilter(), DateRange(),
+               options.bucket)) {
+        WriteAggregateRow(&writer, aggregate);
+      }
+    } else {
+      for (const auto& rate : selected) {
+        WriteRateRow(&writer, rate);
+      }
+    }
+  } catch (const InvalidFilterException& e) {
+    writer.Flush();
+    err << "Error: " << e.what() << endl;
+    return kExitUsage;
+  } catch (const std::exception& e) {
+    writer.Flush();
+    err << "Error: " << e.what() << endl;
+    return kExitFailure;
+  }
+
+  writer.Flush();
+  return out ? kExitOk : kExitFailure;
+}
+
+int BatchCommandLine::Main(int argc, char** argv) {
+  BatchOptions options;
+  try {
+    options = Parse(vector<string>(argv + 1, argv + argc));
+  } catch (const invalid_argument& e) {
+    std::cerr << "Error: " << e.what() << "\n\n";
+    PrintUsage(std::cerr);
+    return kExitUsage;
+  }
+
+  std::ios::sync_with_stdio(false);
+  if (!options.trace_file.empty()) {
+    TraceRecorder::Enable();
+    TraceRecorder::SetThreadName("main");
+  }
+  int status = Run(options, std::cout, std::cerr);
+
+  try {
+    if (!options.metrics_file.empty()) {
+      MetricsRegistry::Global().WritePrometheus(options.metrics_file);
+    }
+    if (!options.trace_file.empty()) {
+      TraceRecorder::Disable();
+      TraceRecorder::WriteChromeTrace(options.trace_file);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << endl;
+    return kExitFailure;
+  }
+  return status;
+}
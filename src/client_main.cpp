@@ -0,0 +1,66 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "currency_rate_client.h"
+
+using std::cerr;
+using std::cout;
+using std::string;
+using std::vector;
+
+namespace {
+
+void PrintUsage() {
+  cerr << "Usage: currency_rate_client (--socket PATH | --port N) "
+       << "COMMAND [ARGUMENT...]\n"
+       << "Example: currency_rate_client --socket /tmp/rates.sock "
+       << "ASOF USD EUR 2024.01.15\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    PrintUsage();
+    return 1;
+  }
+
+  string socket_path;
+  uint16_t port = 0;
+  string option = argv[1];
+
+  try {
+    if (option == "--socket") {
+      socket_path = argv[2];
+    } else if (option == "--port") {
+      port = static_cast<uint16_t>(std::stoul(argv[2]));
+    } else {
+      PrintUsage();
+      return 1;
+    }
+
+    CurrencyRateClient client(socket_path, port);
+    vector<string> response =
+        client.Request(vector<string>(argv + 3, argv + argc));
+
+    if (response[0].compare(0, 3, "OK ") != 0) {
+      cerr << response[0] << '\n';
+      return 3;
+    }
+    for (size_t i = 1; i < response.size(); ++i) {
+      cout << response[i] << '\n';
+    }
+  } catch (const std::exception& e) {
+    cerr << "Error: " << e.what() << '\n';
+    return 2;
+  }
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_date.h"
+#include "currency_rate.h"
+
+using std::string;
+
+namespace {
+
+bool ReadDigits(const string& str, size_t pos, size_t count, int* value) {
+  int result = 0;
+  for (size_t i = pos; i < pos + count; ++i) {
+    char c = str[i];
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    result = result * 10 + (c - '0');
+  }
+  *value = result;
+  return true;
+}
+
+void WriteDigits(int value, size_t count, char* out) {
+  for (size_t i = count; i > 0; --i) {
+    out[i - 1] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  }
+}
+
+}  // namespace
+
+int CurrencyDate::ToDayNumber(const string& date) {
+  int year = 0;
+  int month = 0;
+  int day = 0;
+
+  if (date.length() != 10 || date[4] != '.' || date[7] != '.' ||
+      !ReadDigits(date, 0, 4, &year) || !ReadDigits(date, 5, 2, &month) ||
+      !ReadDigits(date, 8, 2, &day)) {
+    throw InvalidDateException("Date '" + date +
+        "' is not in YYYY.MM.DD format");
+  }
+
+  return FromCivil(year, month, day);
+}
+
+string CurrencyDate::FromDayNumber(int day_number) {
+  int year = 0;
+  int month = 0;
+  int day = 0;
+  ToCivil(day_number, &year, &month, &day);
+
+  string result = "0000.00.00";
+  WriteDigits(year, 4, &result[0]);
+  WriteDigits(month, 2, &result[5]);
+  WriteDigits(day, 2, &result[8]);
+  return result;
+}
+
+// Days-from-civil algorithm for the proleptic Gregorian calendar.
+int CurrencyDate::FromCivil(int year, int month, int day) {
+  year -= month <= 2 ? 1 : 0;
+  const int era = (year >= 0 ? year : year - 399) / 400;
+  const int year_of_era = year - era * 400;
+  const int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 +
+                          day - 1;
+  const int day_of_era = year_of_era * 365 + year_of_era / 4 -
+                         year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+void CurrencyDate::ToCivil(int day_number, int* year, int* month, int* day) {
+  day_number += 719468;
+  const int era = (day_number >= 0 ? day_number : day_number - 146096) /
+                  146097;
+  const int day_of_era = day_number - era * 146097;
+  const int year_of_era = (day_of_era - day_of_era / 1460 +
+                           day_of_era / 36524 - day_of_era / 146096) / 365;
+  const int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 -
+                                        year_of_era / 100);
+  const int mp = (5 * day_of_year + 2) / 153;
+
+  *day = day_of_year - (153 * mp + 2) / 5 + 1;
+  *month = mp < 10 ? mp + 3 : mp - 9;
+  *year = year_of_era + era * 400 + (*month <= 2 ? 1 : 0);
+}
+
+int CurrencyDate::DayOfWeek(int day_number) {
+  // 1970.01.01 was a Thursday.
+  int weekday = (day_number + 3) % 7;
+  return weekday < 0 ? weekday + 7 : weekday;
+}
@@ -4,6 +4,7 @@
 
 #include "currency_rate.h"
 #include "currency_rate_validator.h"
+#include "rate_format.h"
 
 #include <ctime>
 #include <iomanip>
@@ -16,7 +17,6 @@ using std::invalid_argument;
 using std::isdigit;
 using std::localtime;
 using std::ostringstream;
-using std::setprecision;
 using std::setw;
 using std::string;
 using std::time;
@@ -61,10 +61,24 @@ CurrencyRate::CurrencyRate(const string& currency1, const string& currency2,
   Validate();
 }
 
+CurrencyRate::CurrencyRate(const string& currency1, const string& currency2,
+                           const FixedRate& rate, const string& date)
+    : currency1_(currency1),
+      currency2_(currency2),
+      rate_(rate.ToDouble()),
+      date_(date),
+      fixed_rate_(rate) {
+  Validate();
+}
+
 void CurrencyRate::Validate() const {
   CurrencyRateValidator::ValidateCurrencyName(currency1_);
   CurrencyRateValidator::ValidateCurrencyName(currency2_);
-  CurrencyRateValidator::ValidateRate(rate_);
+  if (fixed_rate_) {
+    CurrencyRateValidator::ValidateRate(*fixed_rate_);
+  } else {
+    CurrencyRateValidator::ValidateRate(rate_);
+  }
   CurrencyRateValidator::ValidateDate(date_);
 
   if (currency1_ == currency2_) {
@@ -74,31 +88,40 @@ void CurrencyRate::Validate() const {
 
 string CurrencyRate::ToString() const {
   ostringstream oss;
-  oss << std::fixed << setprecision(4)
-      << "Currency 1: " << currency1_ << endl
+  oss << "Currency 1: " << currency1_ << endl
       << "Currency 2: " << currency2_ << endl
-      << "Rate: " << rate_ << endl
+      << "Rate: " << RateFormat::ToFixed(rate_) << endl
       << "Date: " << date_;
   return oss.str();
 }
 
 string CurrencyRate::ToFileString() const {
-  ostringstream oss;
-
-  if (currency1_.find(' ') != string::npos) {
-    oss << "\"" << currency1_ << "\" ";
-  } else {
-    oss << currency1_ << " ";
+  string line;
+  line.reserve(currency1_.size() + currency2_.size() + date_.size() + 24);
+
+  for (const string* currency : {&currency1_, &currency2_}) {
+    if (currency->find(' ') != string::npos) {
+      line.append("\"").append(*currency).append("\" ");
+    } else {
+      line.append(*currency).push_back(' ');
+    }
   }
 
-  if (currency2_.find(' ') != string::npos) {
-    oss << "\"" << currency2_ << "\" ";
+  if (fixed_rate_) {
+    line.append(fixed_rate_->ToString());
   } else {
-    oss << currency2_ << " ";
+    RateFormat::AppendExact(rate_, &line);
   }
+  line.push_back(' ');
+  line.append(date_);
+  return line;
+}
 
-  oss << std::fixed << setprecision(4) << rate_ << " " << date_;
-  return oss.str();
+CurrencyRate CurrencyRate::Inverse() const {
+  if (fixed_rate_) {
+    return CurrencyRate(currency2_, currency1_, fixed_rate_->Inverse(), date_);
+  }
+  return CurrencyRate(currency2_, currency1_, 1.0 / rate_, date_);
 }
 
 bool CurrencyRate::operator<(const CurrencyRate& other) const {
@@ -114,7 +137,8 @@ bool CurrencyRate::operator<(const CurrencyRate& other) const {
 bool CurrencyRate::operator==(const CurrencyRate& other) const {
   return currency1_ == other.currency1_ &&
          currency2_ == other.currency2_ &&
-         rate_ == other.rate_ &&
+         (fixed_rate_ && other.fixed_rate_ ? *fixed_rate_ == *other.fixed_rate_
+                                           : rate_ == other.rate_) &&
          date_ == other.date_;
 }
 
@@ -0,0 +1,234 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_aggregation.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "currency_date.h"
+#include "parallel_executor.h"
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace {
+
+struct SeriesPoint {
+  int day;
+  size_t position;
+  double rate;
+  // Fixed-point rate, or scale -1 when the record has none.
+  int64_t units;
+  int scale;
+};
+
+// Values summed per block in ReduceUnits(). Rates stay below 2^53 units,
+// so 1024 of them cannot overflow an int64 lane.
+constexpr size_t kUnitsBlock = 1024;
+
+// Min/max/sum over a contiguous block. Four independent accumulators keep
+// the dependency chains short so the loop maps onto SIMD lanes.
+void ReduceRates(const double* values, size_t count, double* min_value,
+                 double* max_value, double* sum) {
+  double mins[4] = {values[0], values[0], values[0], values[0]};
+  double maxs[4] = {values[0], values[0], values[0], values[0]};
+  double sums[4] = {0.0, 0.0, 0.0, 0.0};
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+      double v = values[i + lane];
+      mins[lane] = v < mins[lane] ? v : mins[lane];
+      maxs[lane] = v > maxs[lane] ? v : maxs[lane];
+      sums[lane] += v;
+    }
+  }
+  for (; i < count; ++i) {
+    double v = values[i];
+    mins[0] = v < mins[0] ? v : mins[0];
+    maxs[0] = v > maxs[0] ? v : maxs[0];
+    sums[0] += v;
+  }
+
+  *min_value = std::min(std::min(mins[0], mins[1]), std::min(mins[2], mins[3]));
+  *max_value = std::max(std::max(maxs[0], maxs[1]), std::max(maxs[2], maxs[3]));
+  *sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+// Integer counterpart of ReduceRates() for fixed-point series. The result
+// is exact for min and max; the sum is exact within each block.
+void ReduceUnits(const int64_t* units, size_t count, int64_t* min_value,
+                 int64_t* max_value, double* sum) {
+  int64_t mins[4] = {units[0], units[0], units[0], units[0]};
+  int64_t maxs[4] = {units[0], units[0], units[0], units[0]};
+  *sum = 0.0;
+
+  for (size_t block = 0; block < count; block += kUnitsBlock) {
+    size_t block_end = std::min(count, block + kUnitsBlock);
+    int64_t sums[4] = {0, 0, 0, 0};
+
+    size_t i = block;
+    for (; i + 4 <= block_end; i += 4) {
+      for (size_t lane = 0; lane < 4; ++lane) {
+        int64_t v = units[i + lane];
+        mins[lane] = v < mins[lane] ? v : mins[lane];
+        maxs[lane] = v > maxs[lane] ? v : maxs[lane];
+        sums[lane] += v;
+      }
+    }
+    for (; i < block_end; ++i) {
+      int64_t v = units[i];
+      mins[0] = v < mins[0] ? v : mins[0];
+      maxs[0] = v > maxs[0] ? v : maxs[0];
+      sums[0] += v;
+    }
+    *sum += static_cast<double>((sums[0] + sums[1]) + (sums[2] + sums[3]));
+  }
+
+  *min_value = std::min(std::min(mins[0], mins[1]), std::min(mins[2], mins[3]));
+  *max_value = std::max(std::max(maxs[0], maxs[1]), std::max(maxs[2], maxs[3]));
+}
+
+vector<RateAggregate> AggregateSeries(const CurrencyPair& pair,
+                                      vector<SeriesPoint>* points,
+                                      AggregationBucket bucket) {
+  std::sort(points->begin(), points->end(),
+            [](const SeriesPoint& a, const SeriesPoint& b) {
+              if (a.day != b.day) {
+                return a.day < b.day;
+              }
+              return a.position < b.position;
+            });
+
+  // Series read entirely in fixed point at one scale are reduced on the
+  // integer units.
+  int scale = points->front().scale;
+  for (const auto& point : *points) {
+    if (point.scale != scale) {
+      scale = -1;
+      break;
+    }
+  }
+  double unit = scale >= 0 ? static_cast<double>(FixedRate::Pow10(scale))
+                           : 1.0;
+
+  vector<double> values(points->size());
+  vector<int64_t> units(scale >= 0 ? points->size() : 0);
+  vector<int> bucket_starts(points->size());
+  for (size_t i = 0; i < points->size(); ++i) {
+    values[i] = (*points)[i].rate;
+    if (scale >= 0) {
+      units[i] = (*points)[i].units;
+    }
+    bucket_starts[i] = CurrencyRateAggregator::BucketStart((*points)[i].day,
+                                                           bucket);
+  }
+
+  vector<RateAggregate> result;
+  size_t begin = 0;
+  while (begin < values.size()) {
+    size_t end = begin + 1;
+    while (end < values.size() && bucket_starts[end] == bucket_starts[begin]) {
+      ++end;
+    }
+
+    RateAggregate aggregate;
+    aggregate.pair = pair;
+    aggregate.bucket_start = CurrencyDate::FromDayNumber(bucket_starts[begin]);
+    aggregate.count = end - begin;
+    aggregate.open = values[begin];
+    aggregate.close = values[end - 1];
+
+    double sum = 0.0;
+    if (scale >= 0) {
+      int64_t low = 0;
+      int64_t high = 0;
+      ReduceUnits(&units[begin], aggregate.count, &low, &high, &sum);
+      aggregate.low = static_cast<double>(low) / unit;
+      aggregate.high = static_cast<double>(high) / unit;
+      aggregate.mean = sum / unit / static_cast<double>(aggregate.count);
+    } else {
+      ReduceRates(&values[begin], aggregate.count, &aggregate.low,
+                  &aggregate.high, &sum);
+      aggregate.mean = sum / static_cast<double>(aggregate.count);
+    }
+
+    result.push_back(aggregate);
+    begin = end;
+  }
+
+  return result;
+}
+
+}  // namespace
+
+int CurrencyRateAggregator::BucketStart(int day_number,
+                                        AggregationBucket bucket) {
+  int year = 0;
+  int month = 0;
+  int day = 0;
+
+  switch (bucket) {
+    case AggregationBucket::kDay:
+      return day_number;
+    case AggregationBucket::kWeek:
+      return day_number - CurrencyDate::DayOfWeek(day_number);
+    case AggregationBucket::kMonth:
+      CurrencyDate::ToCivil(day_number, &year, &month, &day);
+      return CurrencyDate::FromCivil(year, month, 1);
+    case AggregationBucket::kYear:
+      CurrencyDate::ToCivil(day_number, &year, &month, &day);
+      return CurrencyDate::FromCivil(year, 1, 1);
+  }
+  return day_number;
+}
+
+vector<RateAggregate> CurrencyRateAggregator::Aggregate(
+    const vector<CurrencyRate>& rates, const PairFilter& pair_filter,
+    const DateRange& date_range, AggregationBucket bucket,
+    size_t max_threads) {
+  unordered_map<CurrencyPair, size_t, CurrencyPairHash> pair_slots;
+  vector<CurrencyPair> pairs;
+  vector<vector<SeriesPoint>> series;
+
+  for (size_t i = 0; i < rates.size(); ++i) {
+    const CurrencyRate& rate = rates[i];
+    if (!pair_filter.Matches(rate) || !date_range.Contains(rate.date())) {
+      continue;
+    }
+
+    CurrencyPair pair(rate.currency1(), rate.currency2());
+    auto inserted = pair_slots.emplace(pair, pairs.size());
+    if (inserted.second) {
+      pairs.push_back(pair);
+      series.emplace_back();
+    }
+    const auto& fixed = rate.fixed_rate();
+    series[inserted.first->second].push_back(
+        {CurrencyDate::ToDayNumber(rate.date()), i, rate.rate(),
+         fixed ? fixed->units() : 0, fixed ? fixed->scale() : -1});
+  }
+
+  vector<size_t> order(pairs.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&pairs](size_t a, size_t b) {
+    return pairs[a] < pairs[b];
+  });
+
+  vector<vector<RateAggregate>> per_pair(order.size());
+  ParallelExecutor::For(order.size(), max_threads, [&](size_t i) {
+    size_t slot = order[i];
+    per_pair[i] = AggregateSeries(pairs[slot], &series[slot], bucket);
+  });
+
+  vector<RateAggregate> result;
+  for (auto& aggregates : per_pair) {
+    result.insert(result.end(), aggregates.begin(), aggregates.end());
+  }
+  return result;
+}
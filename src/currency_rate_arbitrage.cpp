@@ -0,0 +1,293 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_arbitrage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "currency_date.h"
+#include "currency_rate_metrics.h"
+#include "currency_rate_trace.h"
+#include "parallel_executor.h"
+#include "rate_format.h"
+
+using std::invalid_argument;
+using std::move;
+using std::set;
+using std::string;
+using std::string_view;
+using std::unordered_map;
+using std::vector;
+
+namespace {
+
+// Decimals of the product in ArbitrageCycle::ToString().
+constexpr int kProductDecimals = 6;
+constexpr int32_t kNoEdge = -1;
+
+// A usable quote with its currencies interned.
+struct Quote {
+  uint32_t from;
+  uint32_t to;
+  double rate;
+};
+
+struct Edge {
+  uint32_t from;
+  uint32_t to;
+  // -log(rate).
+  double weight;
+  double rate;
+};
+
+// The currency graph of one date: vertices are the interned ids of its
+// currencies in ascending order, edges the quotes and their inverses.
+struct DateGraph {
+  vector<uint32_t> currencies;
+  vector<Edge> edges;
+};
+
+// |begin|..|end| are the quotes of one date in storage order.
+DateGraph BuildGraph(const Quote* begin, const Quote* end) {
+  // The last quote of each pair; a stable sort keeps a pair's quotes in
+  // storage order.
+  vector<Quote> quotes(begin, end);
+  std::stable_sort(quotes.begin(), quotes.end(),
+                   [](const Quote& a, const Quote& b) {
+                     return a.from != b.from ? a.from < b.from : a.to < b.to;
+                   });
+  size_t kept = 0;
+  for (size_t i = 0; i < quotes.size(); ++i) {
+    if (i + 1 < quotes.size() && quotes[i + 1].from == quotes[i].from &&
+        quotes[i + 1].to == quotes[i].to) {
+      continue;
+    }
+    quotes[kept++] = quotes[i];
+  }
+  quotes.resize(kept);
+
+  DateGraph graph;
+  for (const auto& quote : quotes) {
+    graph.currencies.push_back(quote.from);
+    graph.currencies.push_back(quote.to);
+  }
+  std::sort(graph.currencies.begin(), graph.currencies.end());
+  graph.currencies.erase(
+      std::unique(graph.currencies.begin(), graph.currencies.end()),
+      graph.currencies.end());
+  auto vertex = [&graph](uint32_t currency) {
+    return static_cast<uint32_t>(
+        std::lower_bound(graph.currencies.begin(), graph.currencies.end(),
+                         currency) -
+        graph.currencies.begin());
+  };
+
+  graph.edges.reserve(2 * quotes.size());
+  for (const auto& quote : quotes) {
+    uint32_t from = vertex(quote.from);
+    uint32_t to = vertex(quote.to);
+    double weight = -std::log(quote.rate);
+    graph.edges.push_back({from, to, weight, quote.rate});
+    graph.edges.push_back({to, from, -weight, 1.0 / quote.rate});
+  }
+  return graph;
+}
+
+// Bellman-Ford from a virtual source joined to every vertex. Each edge
+// weight is raised by log(1 + threshold) / V, so a cycle stays negative
+// only if it gains at least (1 + threshold)^(length / V); cycles of
+// exactly one, such as a quote and its own inverse, never are. The
+// cycles found are checked against the threshold itself afterwards.
+vector<ArbitrageCycle> DetectDate(const string& date, const DateGraph& graph,
+                                  const vector<string_view>& names,
+                                  const ArbitrageOptions& options) {
+  vector<ArbitrageCycle> cycles;
+  size_t vertices = graph.currencies.size();
+  if (graph.edges.empty() || options.max_cycles_per_date == 0) {
+    return cycles;
+  }
+
+  double margin =
+      std::log1p(options.threshold) / static_cast<double>(vertices);
+  vector<double> distance(vertices, 0.0);
+  vector<int32_t> predecessor(vertices, kNoEdge);
+  vector<uint32_t> relaxing;
+  for (size_t round = 0; round <= vertices; ++round) {
+    bool changed = false;
+    for (size_t e = 0; e < graph.edges.size(); ++e) {
+      const Edge& edge = graph.edges[e];
+      double candidate = distance[edge.from] + edge.weight + margin;
+      if (candidate < distance[edge.to]) {
+        distance[edge.to] = candidate;
+        predecessor[edge.to] = static_cast<int32_t>(e);
+        changed = true;
+        if (round == vertices) {
+          relaxing.push_back(edge.to);
+        }
+      }
+    }
+    if (!changed) {
+      return cycles;
+    }
+  }
+
+  set<vector<uint32_t>> seen;
+  for (uint32_t vertex : relaxing) {
+    // Walking back V steps from a vertex still relaxing ends on a cycle
+    // of the predecessor links.
+    uint32_t start = vertex;
+    bool linked = true;
+    for (size_t step = 0; step < vertices && linked; ++step) {
+      linked = predecessor[start] != kNoEdge;
+      if (linked) {
+        start = graph.edges[predecessor[start]].from;
+      }
+    }
+    if (!linked || predecessor[start] == kNoEdge) {
+      continue;
+    }
+
+    vector<int32_t> path;
+    uint32_t current = start;
+    do {
+      path.push_back(predecessor[current]);
+      current = graph.edges[path.back()].from;
+    } while (current != start && predecessor[current] != kNoEdge &&
+             path.size() <= vertices);
+    if (current != start) {
+      continue;
+    }
+    std::reverse(path.begin(), path.end());
+
+    double product = 1.0;
+    vector<uint32_t> loop;
+    for (int32_t e : path) {
+      product *= graph.edges[e].rate;
+      loop.push_back(graph.edges[e].from);
+    }
+    if (!(product > 1.0 + options.threshold)) {
+      continue;
+    }
+    auto first = std::min_element(
+        loop.begin(), loop.end(), [&graph, &names](uint32_t a, uint32_t b) {
+          return names[graph.currencies[a]] < names[graph.currencies[b]];
+        });
+    std::rotate(loop.begin(), first, loop.end());
+    if (!seen.insert(loop).second) {
+      continue;
+    }
+
+    ArbitrageCycle cycle;
+    cycle.date = date;
+    for (uint32_t id : loop) {
+      cycle.currencies.emplace_back(names[graph.currencies[id]]);
+    }
+    cycle.product = product;
+    cycles.push_back(move(cycle));
+    if (cycles.size() == options.max_cycles_per_date) {
+      break;
+    }
+  }
+  return cycles;
+}
+
+}  // namespace
+
+string ArbitrageCycle::ToString() const {
+  string line = date + " |";
+  for (const auto& currency : currencies) {
+    line += ' ' + currency + " ->";
+  }
+  line += ' ' + (currencies.empty() ? string() : currencies.front()) + " | ";
+  RateFormat::AppendFixed(product, kProductDecimals, &line);
+  return line;
+}
+
+vector<ArbitrageCycle> ArbitrageDetector::Detect(
+    const vector<CurrencyRate>& rates, const ArbitrageOptions& options) {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_arbitrage_seconds",
+                           "Time to search every date for rate cycles.");
+  CURRENCY_RATE_TRACE_SPAN("DetectArbitrage");
+  if (!(options.threshold > 0.0)) {
+    throw invalid_argument("Arbitrage threshold must be positive");
+  }
+
+  // One sequential pass turns the records into compact quotes keyed by
+  // day number, so the per-date work below does not chase records across
+  // the whole array.
+  unordered_map<string_view, uint32_t> currency_ids;
+  vector<string_view> names;
+  vector<int> quote_days;
+  vector<Quote> quotes;
+  auto intern = [&currency_ids, &names](const string& currency) {
+    auto inserted = currency_ids.emplace(
+        currency, static_cast<uint32_t>(names.size()));
+    if (inserted.second) {
+      names.push_back(currency);
+    }
+    return inserted.first->second;
+  };
+  for (const auto& rate : rates) {
+    double value = rate.rate();
+    if (!options.date_range.Contains(rate.date()) || !(value > 0.0) ||
+        !std::isfinite(value) || rate.currency1() == rate.currency2()) {
+      continue;
+    }
+    quote_days.push_back(CurrencyDate::ToDayNumber(rate.date()));
+    quotes.push_back({intern(rate.currency1()), intern(rate.currency2()),
+                      value});
+  }
+  if (quotes.empty()) {
+    return {};
+  }
+
+  // Counting sort by day, keeping storage order within a day.
+  auto [min_day, max_day] =
+      std::minmax_element(quote_days.begin(), quote_days.end());
+  int first_day = *min_day;
+  vector<size_t> offsets(static_cast<size_t>(*max_day - first_day) + 2, 0);
+  for (int day : quote_days) {
+    ++offsets[day - first_day + 1];
+  }
+  vector<int> days;
+  for (size_t i = 1; i < offsets.size(); ++i) {
+    if (offsets[i] != 0) {
+      days.push_back(first_day + static_cast<int>(i) - 1);
+    }
+    offsets[i] += offsets[i - 1];
+  }
+  vector<Quote> by_day(quotes.size());
+  {
+    vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < quotes.size(); ++i) {
+      by_day[next[quote_days[i] - first_day]++] = quotes[i];
+    }
+  }
+
+  vector<vector<ArbitrageCycle>> found(days.size());
+  ParallelExecutor::For(days.size(), options.max_threads, [&](size_t i) {
+    size_t bucket = static_cast<size_t>(days[i] - first_day);
+    DateGraph graph = BuildGraph(by_day.data() + offsets[bucket],
+                                 by_day.data() + offsets[bucket + 1]);
+    found[i] = DetectDate(CurrencyDate::FromDayNumber(days[i]), graph, names,
+                          options);
+  });
+
+  vector<ArbitrageCycle> cycles;
+  for (auto& date_cycles : found) {
+    for (auto& cycle : date_cycles) {
+      cycles.push_back(move(cycle));
+    }
+  }
+  CURRENCY_RATE_COUNT("currency_rate_arbitrage_cycles_total",
+                      "Inconsistent rate cycles found.", cycles.size());
+  return cycles;
+}
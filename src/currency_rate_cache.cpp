@@ -0,0 +1,200 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_cache.h"
+
+using std::lock_guard;
+using std::make_shared;
+using std::move;
+using std::mutex;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+CachingCurrencyRateRepository::CachingCurrencyRateRepository(
+    shared_ptr<ICurrencyRateRepository> repository, size_t max_entries,
+    size_t max_cached_records)
+    : repository_(move(repository)),
+      max_entries_(max_entries),
+      max_cached_records_(max_cached_records),
+      generation_(repository_->generation()) {}
+
+void CachingCurrencyRateRepository::Add(const CurrencyRate& rate) {
+  lock_guard<mutex> lock(mutex_);
+  Synchronize();
+  repository_->Add(rate);
+  generation_ = repository_->generation();
+
+  Evict(CurrencyKey(rate.currency1()));
+  Evict(CurrencyKey(rate.currency2()));
+  Evict(DateKey(rate.date()));
+}
+
+vector<CurrencyRate> CachingCurrencyRateRepository::GetAll() const {
+  return repository_->GetAll();
+}
+
+size_t CachingCurrencyRateRepository::Count() const {
+  return repository_->Count();
+}
+
+void CachingCurrencyRateRepository::Clear() {
+  repository_->Clear();
+  InvalidateAll();
+}
+
+void CachingCurrencyRateRepository::SortByDate() {
+  repository_->SortByDate();
+  InvalidateAll();
+}
+
+void CachingCurrencyRateRepository::SortByCurrency() {
+  repository_->SortByCurrency();
+  InvalidateAll();
+}
+
+vector<CurrencyRate> CachingCurrencyRateRepository::FilterByCurrency(
+    const string& currency) const {
+  return *SharedFilterByCurrency(currency);
+}
+
+vector<CurrencyRate> CachingCurrencyRateRepository::FilterByDate(
+    const string& date) const {
+  return *SharedFilterByDate(date);
+}
+
+uint64_t CachingCurrencyRateRepository::generation() const {
+  return repository_->generation();
+}
+
+CachingCurrencyRateRepository::SharedRates
+CachingCurrencyRateRepository::SharedFilterByCurrency(
+    const string& currency) const {
+  string key = CurrencyKey(currency);
+  uint64_t generation = 0;
+  if (SharedRates cached = Lookup(key, &generation)) {
+    return cached;
+  }
+
+  // The query runs unlocked so that misses on other keys do not queue.
+  SharedRates result = make_shared<const vector<CurrencyRate>>(
+      repository_->FilterByCurrency(currency));
+  Store(key, result, generation);
+  return result;
+}
+
+CachingCurrencyRateRepository::SharedRates
+CachingCurrencyRateRepository::SharedFilterByDate(const string& date) const {
+  string key = DateKey(date);
+  uint64_t generation = 0;
+  if (SharedRates cached = Lookup(key, &generation)) {
+    return cached;
+  }
+
+  SharedRates result =
+      make_shared<const vector<CurrencyRate>>(repository_->FilterByDate(date));
+  Store(key, result, generation);
+  return result;
+}
+
+void CachingCurrencyRateRepository::InvalidateAll() {
+  lock_guard<mutex> lock(mutex_);
+  DropEntries();
+  generation_ = repository_->generation();
+}
+
+QueryCacheStats CachingCurrencyRateRepository::stats() const {
+  lock_guard<mutex> lock(mutex_);
+  return stats_;
+}
+
+string CachingCurrencyRateRepository::CurrencyKey(const string& currency) {
+  return "currency:" + currency;
+}
+
+string CachingCurrencyRateRepository::DateKey(const string& date) {
+  return "date:" + date;
+}
+
+CachingCurrencyRateRepository::SharedRates
+CachingCurrencyRateRepository::Lookup(const string& key,
+                                      uint64_t* generation) const {
+  lock_guard<mutex> lock(mutex_);
+  Synchronize();
+  *generation = generation_;
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++stats_.misses;
+    return nullptr;
+  }
+
+  ++stats_.hits;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->result;
+}
+
+void CachingCurrencyRateRepository::Store(const string& key,
+                                          const SharedRates& result,
+                                          uint64_t generation) const {
+  if (max_entries_ == 0 || result->size() > max_cached_records_) {
+    return;
+  }
+
+  lock_guard<mutex> lock(mutex_);
+  // A result computed before a change, or already stored by a concurrent
+  // miss on the same key, is not kept.
+  if (generation != generation_ ||
+      repository_->generation() != generation_ ||
+      index_.count(key) != 0) {
+    return;
+  }
+
+  stats_.cached_records += result->size();
+  entries_.push_front(Entry{key, result});
+  index_[key] = entries_.begin();
+  stats_.entries = entries_.size();
+
+  EvictOverflow();
+}
+
+void CachingCurrencyRateRepository::Evict(const string& key) {
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    return;
+  }
+
+  stats_.cached_records -= it->second->result->size();
+  entries_.erase(it->second);
+  index_.erase(it);
+  stats_.entries = entries_.size();
+  ++stats_.invalidations;
+}
+
+void CachingCurrencyRateRepository::EvictOverflow() const {
+  while (!entries_.empty() && (entries_.size() > max_entries_ ||
+                               stats_.cached_records > max_cached_records_)) {
+    const Entry& victim = entries_.back();
+    stats_.cached_records -= victim.result->size();
+    index_.erase(victim.key);
+    entries_.pop_back();
+    ++stats_.evictions;
+  }
+  stats_.entries = entries_.size();
+}
+
+void CachingCurrencyRateRepository::Synchronize() const {
+  uint64_t current = repository_->generation();
+  if (current != generation_) {
+    DropEntries();
+    generation_ = current;
+  }
+}
+
+void CachingCurrencyRateRepository::DropEntries() const {
+  stats_.invalidations += entries_.size();
+  entries_.clear();
+  index_.clear();
+  stats_.entries = 0;
+  stats_.cached_records = 0;
+}
@@ -0,0 +1,147 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_client.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+using std::invalid_argument;
+using std::move;
+using std::runtime_error;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+bool SendAll(int fd, const string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t written = ::send(fd, data.data() + sent, data.size() - sent,
+                             MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    sent += static_cast<size_t>(written);
+  }
+  return true;
+}
+
+string SystemError(const string& what) {
+  return what + ": " + std::strerror(errno);
+}
+
+}  // namespace
+
+CurrencyRateClient::CurrencyRateClient(const string& socket_path,
+                                       uint16_t port) {
+  if (!socket_path.empty()) {
+    sockaddr_un address{};
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+      throw runtime_error("Invalid socket path: " + socket_path);
+    }
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(),
+                 sizeof(address.sun_path) - 1);
+    if (fd_ < 0 || ::connect(fd_, reinterpret_cast<sockaddr*>(&address),
+                             sizeof(address)) < 0) {
+      string message = SystemError("Failed to connect to " + socket_path);
+      if (fd_ >= 0) {
+        ::close(fd_);
+      }
+      throw runtime_error(message);
+    }
+    return;
+  }
+
+  fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (fd_ < 0 || ::connect(fd_, reinterpret_cast<sockaddr*>(&address),
+                           sizeof(address)) < 0) {
+    string message = SystemError("Failed to connect to port " +
+                                 to_string(port));
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+    throw runtime_error(message);
+  }
+}
+
+CurrencyRateClient::~CurrencyRateClient() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+vector<string> CurrencyRateClient::Request(const vector<string>& fields) {
+  string request;
+  for (size_t i = 0; i < fields.size(); ++i) {
+    // Either would split the request differently on the server.
+    if (fields[i].find_first_of("\t\n") != string::npos) {
+      throw invalid_argument("Request field contains a tab or newline: " +
+                             fields[i]);
+    }
+    if (i > 0) {
+      request.push_back('\t');
+    }
+    request.append(fields[i]);
+  }
+  request.push_back('\n');
+
+  if (!SendAll(fd_, request)) {
+    throw runtime_error(SystemError("Failed to send request"));
+  }
+
+  vector<string> response(1);
+  if (!ReadLine(&response[0])) {
+    throw runtime_error("Connection closed by server");
+  }
+
+  if (response[0].compare(0, 3, "OK ") == 0) {
+    size_t count = std::stoul(response[0].substr(3));
+    for (size_t i = 0; i < count; ++i) {
+      string line;
+      if (!ReadLine(&line)) {
+        throw runtime_error("Connection closed by server");
+      }
+      response.push_back(move(line));
+    }
+  }
+  return response;
+}
+
+bool CurrencyRateClient::ReadLine(string* line) {
+  char chunk[64 * 1024];
+  size_t newline = 0;
+
+  while ((newline = buffer_.find('\n')) == string::npos) {
+    ssize_t received = ::recv(fd_, chunk, sizeof(chunk), 0);
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    if (received <= 0) {
+      return false;
+    }
+    buffer_.append(chunk, static_cast<size_t>(received));
+  }
+
+  line->assign(buffer_, 0, newline);
+  buffer_.erase(0, newline + 1);
+  return true;
+}
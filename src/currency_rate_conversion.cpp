@@ -0,0 +1,182 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_conversion.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include "currency_rate_metrics.h"
+#include "currency_rate_trace.h"
+#include "parallel_executor.h"
+
+using std::invalid_argument;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::string;
+using std::string_view;
+using std::unordered_map;
+using std::vector;
+
+namespace {
+
+// Rows whose factors are gathered before they are multiplied.
+constexpr size_t kGatherBlock = 1024;
+
+struct GroupKey {
+  string_view from;
+  string_view to;
+  string_view date;
+
+  bool operator==(const GroupKey& other) const {
+    return from == other.from && to == other.to && date == other.date;
+  }
+};
+
+struct GroupKeyHash {
+  size_t operator()(const GroupKey& key) const {
+    std::hash<string_view> hash;
+    size_t h = hash(key.from);
+    h ^= hash(key.to) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= hash(key.date) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+  }
+};
+
+// out[i] = amounts[i] * factors[i]. Four independent lanes, as in the
+// aggregation kernels, so the loop maps onto SIMD registers.
+void MultiplyRows(const double* amounts, const double* factors, size_t count,
+                  double* out) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+      out[i + lane] = amounts[i + lane] * factors[i + lane];
+    }
+  }
+  for (; i < count; ++i) {
+    out[i] = amounts[i] * factors[i];
+  }
+}
+
+void ConvertRows(const double* amounts, const uint32_t* row_groups,
+                 const double* group_rates, size_t count, double* out) {
+  double factors[kGatherBlock];
+  for (size_t begin = 0; begin < count; begin += kGatherBlock) {
+    size_t size = std::min(kGatherBlock, count - begin);
+    for (size_t i = 0; i < size; ++i) {
+      factors[i] = group_rates[row_groups[begin + i]];
+    }
+    MultiplyRows(amounts + begin, factors, size, out + begin);
+  }
+}
+
+}  // namespace
+
+CurrencyConverter::CurrencyConverter(
+    const MemoryCurrencyRateRepository& repository, ConversionOptions options)
+    : repository_(repository), options_(move(options)) {}
+
+optional<double> CurrencyConverter::ResolveRate(const string& from,
+                                                const string& to,
+                                                const string& date,
+                                                ConversionRoute* route) const {
+  ConversionRoute found = ConversionRoute::kNone;
+  bool inverted = false;
+  optional<double> rate;
+
+  if (from == to) {
+    found = ConversionRoute::kIdentity;
+    rate = 1.0;
+  } else if ((rate = repository_.GetRate(from, to, date, &inverted))) {
+    found = inverted ? ConversionRoute::kInverse : ConversionRoute::kDirect;
+  } else {
+    for (const auto& pivot : options_.pivots) {
+      if (pivot == from || pivot == to) {
+        continue;
+      }
+      optional<double> first = repository_.GetRate(from, pivot, date);
+      optional<double> second =
+          first ? repository_.GetRate(pivot, to, date) : nullopt;
+      if (second) {
+        found = ConversionRoute::kTriangulated;
+        rate = *first * *second;
+        break;
+      }
+    }
+  }
+
+  if (route != nullptr) {
+    *route = found;
+  }
+  return rate;
+}
+
+ConversionStats CurrencyConverter::Convert(const vector<double>& amounts,
+                                           const vector<string>& from,
+                                           const vector<string>& to,
+                                           const vector<string>& dates,
+                                           double* out) const {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_convert_batch_seconds",
+                           "Time to convert one batch of amounts.");
+  CURRENCY_RATE_TRACE_SPAN("ConvertBatch");
+  size_t rows = amounts.size();
+  if (from.size() != rows || to.size() != rows || dates.size() != rows) {
+    throw invalid_argument("Conversion columns differ in length");
+  }
+
+  ConversionStats stats;
+  stats.rows = rows;
+
+  // Group the rows; keys point into the caller's columns.
+  unordered_map<GroupKey, uint32_t, GroupKeyHash> group_ids;
+  vector<uint32_t> row_groups(rows);
+  vector<size_t> group_first_row;
+  vector<size_t> group_sizes;
+  for (size_t i = 0; i < rows; ++i) {
+    auto inserted = group_ids.emplace(GroupKey{from[i], to[i], dates[i]},
+                                      static_cast<uint32_t>(group_ids.size()));
+    if (inserted.second) {
+      group_first_row.push_back(i);
+      group_sizes.push_back(0);
+    }
+    row_groups[i] = inserted.first->second;
+    ++group_sizes[inserted.first->second];
+  }
+  stats.groups = group_first_row.size();
+
+  vector<double> group_rates(stats.groups);
+  for (size_t group = 0; group < stats.groups; ++group) {
+    size_t row = group_first_row[group];
+    ConversionRoute route = ConversionRoute::kNone;
+    optional<double> rate = ResolveRate(from[row], to[row], dates[row], &route);
+    group_rates[group] =
+        rate ? *rate : std::numeric_limits<double>::quiet_NaN();
+
+    size_t count = group_sizes[group];
+    switch (route) {
+      case ConversionRoute::kNone: stats.missing += count; break;
+      case ConversionRoute::kIdentity: stats.identity += count; break;
+      case ConversionRoute::kDirect: stats.direct += count; break;
+      case ConversionRoute::kInverse: stats.inverse += count; break;
+      case ConversionRoute::kTriangulated: stats.triangulated += count; break;
+    }
+  }
+
+  size_t task_rows = options_.rows_per_task == 0 ? rows
+                                                 : options_.rows_per_task;
+  size_t tasks = task_rows == 0 ? 0 : (rows + task_rows - 1) / task_rows;
+  ParallelExecutor::For(tasks, options_.max_threads, [&](size_t task) {
+    size_t begin = task * task_rows;
+    size_t count = std::min(task_rows, rows - begin);
+    ConvertRows(amounts.data() + begin, row_groups.data() + begin,
+                group_rates.data(), count, out + begin);
+  });
+  return stats;
+}
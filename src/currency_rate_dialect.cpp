@@ -0,0 +1,291 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_dialect.h"
+
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <stdexcept>
+
+#include "currency_rate_metrics.h"
+#include "currency_rate_trace.h"
+#include "fixed_rate.h"
+#include "rate_format.h"
+
+using std::invalid_argument;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+
+// Longest rate field accepted; rates have at most 7 integer digits.
+constexpr size_t kMaxRateLength = 64;
+// currency1, currency2, rate and date.
+constexpr size_t kFieldCount = 4;
+constexpr char kQuote = '"';
+
+bool IsBlank(char c) {
+  return std::isspace(static_cast<unsigned char>(c));
+}
+
+bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+string_view Trim(string_view text) {
+  while (!text.empty() && IsBlank(text.front())) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && IsBlank(text.back())) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+// Fields separated by runs of blanks. A field opening with a quote runs
+// to the next quote and must be followed by a blank or the end.
+bool SplitBlankSeparated(string_view line, string_view* values) {
+  size_t position = 0;
+  for (size_t i = 0; i < kFieldCount; ++i) {
+    while (position < line.size() && IsBlank(line[position])) {
+      ++position;
+    }
+    if (position == line.size()) {
+      return false;
+    }
+
+    size_t start = position;
+    if (line[position] == kQuote) {
+      size_t close = line.find(kQuote, position + 1);
+      if (close == string_view::npos) {
+        return false;
+      }
+      values[i] = line.substr(start + 1, close - start - 1);
+      position = close + 1;
+      if (position < line.size() && !IsBlank(line[position])) {
+        return false;
+      }
+    } else {
+      while (position < line.size() && !IsBlank(line[position])) {
+        if (line[position] == kQuote) {
+          return false;
+        }
+        ++position;
+      }
+      values[i] = line.substr(start, position - start);
+    }
+  }
+  return Trim(line.substr(position)).empty();
+}
+
+// Exactly kFieldCount fields separated by |Delimiter|, blanks around them
+// ignored. A field opening with a quote runs to the next quote, so it
+// may contain the delimiter; only blanks may follow it.
+template <char Delimiter>
+bool SplitDelimited(string_view line, string_view* values) {
+  size_t position = 0;
+  for (size_t i = 0; i < kFieldCount; ++i) {
+    while (position < line.size() && IsBlank(line[position])) {
+      ++position;
+    }
+
+    size_t end = 0;
+    if (position < line.size() && line[position] == kQuote) {
+      size_t close = line.find(kQuote, position + 1);
+      if (close == string_view::npos) {
+        return false;
+      }
+      values[i] = line.substr(position + 1, close - position - 1);
+      end = close + 1;
+      while (end < line.size() && IsBlank(line[end])) {
+        ++end;
+      }
+      if (end < line.size() && line[end] != Delimiter) {
+        return false;
+      }
+    } else {
+      end = std::min(line.find(Delimiter, position), line.size());
+      values[i] = Trim(line.substr(position, end - position));
+    }
+
+    bool last = i + 1 == kFieldCount;
+    if (values[i].empty() || last != (end == line.size())) {
+      return false;
+    }
+    position = end + 1;
+  }
+  return true;
+}
+
+template <char Separator>
+bool IsDate(string_view text) {
+  if (text.size() != 10 || text[4] != Separator || text[7] != Separator) {
+    return false;
+  }
+  for (size_t i : {0, 1, 2, 3, 5, 6, 8, 9}) {
+    if (!IsDigit(text[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <char DecimalSeparator>
+bool IsRate(string_view text) {
+  if (text.empty() || text.size() > kMaxRateLength) {
+    return false;
+  }
+  for (char c : text) {
+    if (!IsDigit(c) && c != DecimalSeparator) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <DateLayout Layout>
+constexpr char DateSeparator() {
+  return Layout == DateLayout::kIso ? '-' : '.';
+}
+
+// YYYY.MM.DD as stored in records.
+void NormalizeDate(string_view date, char* out) {
+  for (size_t i = 0; i < 10; ++i) {
+    out[i] = (i == 4 || i == 7) ? '.' : date[i];
+  }
+}
+
+}  // namespace
+
+template <typename Dialect>
+DelimitedCurrencyRateParser<Dialect>::DelimitedCurrencyRateParser(
+    int fixed_scale)
+    : fixed_scale_(fixed_scale < 0 ? RegexCurrencyRateParser::kFloatingPoint
+                                   : fixed_scale) {
+  if (fixed_scale > FixedRate::kMaxScale) {
+    throw invalid_argument("Fixed-point scale must be at most " +
+                           std::to_string(FixedRate::kMaxScale));
+  }
+}
+
+template <typename Dialect>
+bool DelimitedCurrencyRateParser<Dialect>::SplitFields(string_view line,
+                                                       Fields* fields) {
+  string_view values[kFieldCount];
+  bool split = false;
+  if constexpr (Dialect::kDelimiter == ' ') {
+    split = SplitBlankSeparated(line, values);
+  } else {
+    split = SplitDelimited<Dialect::kDelimiter>(line, values);
+  }
+
+  if (!split || !IsRate<Dialect::kDecimalSeparator>(values[2]) ||
+      !IsDate<DateSeparator<Dialect::kDateLayout>()>(values[3])) {
+    return false;
+  }
+
+  fields->currency1 = values[0];
+  fields->currency2 = values[1];
+  fields->rate = values[2];
+  fields->date = values[3];
+  return true;
+}
+
+template <typename Dialect>
+bool DelimitedCurrencyRateParser<Dialect>::ParseRate(string_view text,
+                                                     double* rate,
+                                                     int64_t* units) const {
+  char normalized[kMaxRateLength];
+  if constexpr (Dialect::kDecimalSeparator != '.') {
+    for (size_t i = 0; i < text.size(); ++i) {
+      normalized[i] = text[i] == Dialect::kDecimalSeparator ? '.' : text[i];
+    }
+    text = string_view(normalized, text.size());
+  }
+
+  if (fixed_scale_ >= 0) {
+    FixedRate fixed;
+    if (!FixedRate::Parse(text, fixed_scale_, &fixed)) {
+      return false;
+    }
+    *rate = fixed.ToDouble();
+    *units = fixed.units();
+    return true;
+  }
+  return RateFormat::Parse(text, rate);
+}
+
+template <typename Dialect>
+CurrencyRate DelimitedCurrencyRateParser<Dialect>::Parse(
+    const string& line) const {
+  Fields fields;
+  if (!SplitFields(line, &fields)) {
+    throw InvalidFormatException(
+        "Line does not match expected format: " + line);
+  }
+
+  try {
+    double rate = 0.0;
+    int64_t units = 0;
+    if (!ParseRate(fields.rate, &rate, &units)) {
+      throw invalid_argument("invalid rate " + string(fields.rate));
+    }
+
+    string date(10, '\0');
+    NormalizeDate(fields.date, &date[0]);
+    string currency1(fields.currency1);
+    string currency2(fields.currency2);
+
+    if (fixed_scale_ >= 0) {
+      return CurrencyRate(currency1, currency2,
+                          FixedRate(units, fixed_scale_), date);
+    }
+    return CurrencyRate(currency1, currency2, rate, date);
+
+  } catch (const std::exception& e) {
+    std::throw_with_nested(InvalidFormatException(
+        "Error parsing line: " + string(e.what())));
+  }
+}
+
+template <typename Dialect>
+bool DelimitedCurrencyRateParser<Dialect>::CanParse(const string& line) const {
+  Fields fields;
+  return SplitFields(line, &fields);
+}
+
+template <typename Dialect>
+void DelimitedCurrencyRateParser<Dialect>::ParseBatch(
+    const vector<string_view>& lines, RateColumnBatch* batch) const {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_parse_batch_seconds",
+                           "Time to parse one batch of lines into columns.");
+  CURRENCY_RATE_TRACE_SPAN("ParseBatch");
+  batch->scale = fixed_scale_;
+  char date[10];
+
+  for (string_view line : lines) {
+    Fields fields;
+    double rate = 0.0;
+    int64_t units = 0;
+    if (!SplitFields(line, &fields) || !ParseRate(fields.rate, &rate, &units)) {
+      batch->AppendError();
+      continue;
+    }
+
+    NormalizeDate(fields.date, date);
+    batch->AppendRow(fields.currency1, fields.currency2, rate,
+                     string_view(date, sizeof(date)), units);
+  }
+}
+
+template class DelimitedCurrencyRateParser<SpaceDialect>;
+template class DelimitedCurrencyRateParser<SpaceIsoDialect>;
+template class DelimitedCurrencyRateParser<CsvDialect>;
+template class DelimitedCurrencyRateParser<CsvIsoDialect>;
+template class DelimitedCurrencyRateParser<SemicolonDialect>;
+template class DelimitedCurrencyRateParser<SemicolonIsoDialect>;
+template class DelimitedCurrencyRateParser<SemicolonCommaDialect>;
+template class DelimitedCurrencyRateParser<SemicolonCommaIsoDialect>;
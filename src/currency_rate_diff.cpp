@@ -0,0 +1,343 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_diff.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+#include "currency_rate_metrics.h"
+#include "currency_rate_trace.h"
+
+using std::ifstream;
+using std::ios;
+using std::runtime_error;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+
+// Bytes read from a file per block in CompareFiles().
+constexpr size_t kBlockSize = 1 << 20;
+
+struct DiffRow {
+  string_view currency1;
+  string_view currency2;
+  string_view date;
+  double rate = 0.0;
+};
+
+int CompareKeys(const DiffRow& a, const DiffRow& b) {
+  if (int order = a.currency1.compare(b.currency1)) {
+    return order;
+  }
+  if (int order = a.currency2.compare(b.currency2)) {
+    return order;
+  }
+  return a.date.compare(b.date);
+}
+
+bool IsBlank(string_view line) {
+  return std::all_of(line.begin(), line.end(), [](unsigned char c) {
+    return std::isspace(c);
+  });
+}
+
+// Rows of a vector in merge order.
+class VectorRows {
+public:
+  explicit VectorRows(const vector<CurrencyRate>& rates) : rates_(rates) {
+    Next();
+  }
+
+  bool Valid() const { return valid_; }
+  const DiffRow& row() const { return row_; }
+
+  void Next() {
+    valid_ = next_ < rates_.size();
+    if (valid_) {
+      const CurrencyRate& rate = rates_[next_++];
+      row_.currency1 = rate.currency1();
+      row_.currency2 = rate.currency2();
+      row_.date = rate.date();
+      row_.rate = rate.rate();
+    }
+  }
+
+private:
+  const vector<CurrencyRate>& rates_;
+  size_t next_ = 0;
+  DiffRow row_;
+  bool valid_ = false;
+};
+
+// Rows of a file, parsed a block at a time. A row's views stay valid
+// until the next call to Next().
+class FileRows {
+public:
+  FileRows(const string& filename, const ICurrencyRateParser& parser,
+           size_t max_line_length)
+      : filename_(filename),
+        file_(filename, ios::binary),
+        parser_(parser),
+        max_line_length_(std::max<size_t>(max_line_length, 1)) {
+    if (!file_.is_open()) {
+      throw runtime_error("Failed to open file: " + filename);
+    }
+    Next();
+  }
+
+  bool Valid() const { return valid_; }
+  const DiffRow& row() const { return row_; }
+  size_t rejected() const { return rejected_; }
+
+  void Next() {
+    if (valid_) {
+      previous_currency1_.assign(row_.currency1);
+      previous_currency2_.assign(row_.currency2);
+      previous_date_.assign(row_.date);
+    }
+
+    valid_ = false;
+    while (!valid_) {
+      if (row_index_ >= batch_.size() && !Refill()) {
+        return;
+      }
+      for (; row_index_ < batch_.size(); ++row_index_) {
+        if (!batch_.HasError(row_index_)) {
+          break;
+        }
+      }
+      if (row_index_ < batch_.size()) {
+        row_.currency1 = batch_.currency1[row_index_];
+        row_.currency2 = batch_.currency2[row_index_];
+        row_.date = batch_.date[row_index_];
+        row_.rate = batch_.rate[row_index_];
+        ++row_index_;
+        valid_ = true;
+      }
+    }
+
+    DiffRow previous;
+    previous.currency1 = previous_currency1_;
+    previous.currency2 = previous_currency2_;
+    previous.date = previous_date_;
+    if (has_previous_ && CompareKeys(row_, previous) < 0) {
+      throw runtime_error(filename_ + " is not sorted by pair and date");
+    }
+    has_previous_ = true;
+  }
+
+private:
+  // Parses the complete lines of the next block. Returns false at the end
+  // of the file. A line that grows past |max_line_length_| without ending
+  // is discarded up to its newline.
+  bool Refill() {
+    CURRENCY_RATE_TRACE_SPAN("DiffReadBlock");
+    batch_.Clear();
+    row_index_ = 0;
+    lines_.clear();
+
+    while (lines_.empty()) {
+      if (eof_) {
+        if (buffer_.empty()) {
+          if (overlong_) {
+            overlong_ = false;
+            ++rejected_;
+          }
+          return false;
+        }
+        // An unterminated last line.
+        buffer_.push_back('\n');
+      } else {
+        size_t kept = buffer_.size();
+        buffer_.resize(kept + kBlockSize);
+        file_.read(&buffer_[kept], static_cast<std::streamsize>(kBlockSize));
+        buffer_.resize(kept + static_cast<size_t>(file_.gcount()));
+        if (file_.bad()) {
+          throw runtime_error("Failed to read file: " + filename_);
+        }
+        eof_ = !file_;
+      }
+
+      if (overlong_) {
+        size_t newline = buffer_.find('\n');
+        if (newline == string::npos) {
+          buffer_.clear();
+          continue;
+        }
+        buffer_.erase(0, newline + 1);
+        overlong_ = false;
+        ++rejected_;
+      }
+
+      size_t consumed = ICurrencyRateParser::SplitLines(buffer_, &lines_);
+      if (lines_.empty()) {
+        if (buffer_.size() > max_line_length_) {
+          buffer_.clear();
+          overlong_ = true;
+        }
+        continue;
+      }
+      parser_.ParseBatch(lines_, &batch_);
+      for (size_t row = 0; row < batch_.size(); ++row) {
+        if (batch_.HasError(row) && !IsBlank(lines_[row])) {
+          ++rejected_;
+        }
+      }
+      buffer_.erase(0, consumed);
+    }
+    return true;
+  }
+
+  string filename_;
+  ifstream file_;
+  const ICurrencyRateParser& parser_;
+  size_t max_line_length_;
+  string buffer_;
+  // The line being read is over the limit and is being skipped.
+  bool overlong_ = false;
+  vector<string_view> lines_;
+  RateColumnBatch batch_;
+  size_t row_index_ = 0;
+  bool eof_ = false;
+  size_t rejected_ = 0;
+
+  DiffRow row_;
+  bool valid_ = false;
+  string previous_currency1_;
+  string previous_currency2_;
+  string previous_date_;
+  bool has_previous_ = false;
+};
+
+bool WithinTolerance(double before, double after,
+                     const RateDiffOptions& options) {
+  double bound = std::max(options.absolute_tolerance,
+                          options.relative_tolerance *
+                              std::max(std::fabs(before), std::fabs(after)));
+  return std::fabs(before - after) <= bound;
+}
+
+void Report(const RateDiffSink& sink, RateDiffKind kind, const DiffRow& row,
+            double before_rate, double after_rate) {
+  if (!sink) {
+    return;
+  }
+  RateDifference difference;
+  difference.kind = kind;
+  difference.pair = CurrencyPair(string(row.currency1), string(row.currency2));
+  difference.date = string(row.date);
+  difference.before_rate = before_rate;
+  difference.after_rate = after_rate;
+  sink(difference);
+}
+
+template <typename BeforeRows, typename AfterRows>
+RateDiffStats MergeRows(BeforeRows* before, AfterRows* after,
+                        const RateDiffSink& sink,
+                        const RateDiffOptions& options) {
+  constexpr double kMissing = std::numeric_limits<double>::quiet_NaN();
+  RateDiffStats stats;
+
+  while (before->Valid() || after->Valid()) {
+    int order = !after->Valid()    ? -1
+                : !before->Valid() ? 1
+                                   : CompareKeys(before->row(), after->row());
+    if (order < 0) {
+      ++stats.before_records;
+      ++stats.removed;
+      Report(sink, RateDiffKind::kRemoved, before->row(), before->row().rate,
+             kMissing);
+      before->Next();
+    } else if (order > 0) {
+      ++stats.after_records;
+      ++stats.added;
+      Report(sink, RateDiffKind::kAdded, after->row(), kMissing,
+             after->row().rate);
+      after->Next();
+    } else {
+      ++stats.before_records;
+      ++stats.after_records;
+      double before_rate = before->row().rate;
+      double after_rate = after->row().rate;
+      if (WithinTolerance(before_rate, after_rate, options)) {
+        ++stats.unchanged;
+      } else {
+        ++stats.changed;
+        Report(sink, RateDiffKind::kChanged, after->row(), before_rate,
+               after_rate);
+      }
+      before->Next();
+      after->Next();
+    }
+  }
+  return stats;
+}
+
+}  // namespace
+
+bool CurrencyRateDiff::KeyLess(const CurrencyRate& a, const CurrencyRate& b) {
+  if (a.currency1() != b.currency1()) {
+    return a.currency1() < b.currency1();
+  }
+  if (a.currency2() != b.currency2()) {
+    return a.currency2() < b.currency2();
+  }
+  return a.date() < b.date();
+}
+
+RateDiffStats CurrencyRateDiff::Compare(vector<CurrencyRate> before,
+                                        vector<CurrencyRate> after,
+                                        const RateDiffSink& sink,
+                                        const RateDiffOptions& options) {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_diff_seconds",
+                           "Time to diff two rate histories.");
+  CURRENCY_RATE_TRACE_SPAN("Diff");
+  for (auto* rates : {&before, &after}) {
+    if (!std::is_sorted(rates->begin(), rates->end(), KeyLess)) {
+      std::stable_sort(rates->begin(), rates->end(), KeyLess);
+    }
+  }
+
+  VectorRows before_rows(before);
+  VectorRows after_rows(after);
+  return MergeRows(&before_rows, &after_rows, sink, options);
+}
+
+RateDiffStats CurrencyRateDiff::Compare(const ICurrencyRateRepository& before,
+                                        const ICurrencyRateRepository& after,
+                                        const RateDiffSink& sink,
+                                        const RateDiffOptions& options) {
+  return Compare(before.GetAll(), after.GetAll(), sink, options);
+}
+
+RateDiffStats CurrencyRateDiff::CompareFiles(const string& before,
+                                             const string& after,
+                                             const ICurrencyRateParser& parser,
+                                             const RateDiffSink& sink,
+                                             const RateDiffOptions& options) {
+  return CompareFiles(before, after, parser, parser, sink, options);
+}
+
+RateDiffStats CurrencyRateDiff::CompareFiles(
+    const string& before, const string& after,
+    const ICurrencyRateParser& before_parser,
+    const ICurrencyRateParser& after_parser, const RateDiffSink& sink,
+    const RateDiffOptions& options) {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_diff_seconds",
+                           "Time to diff two rate histories.");
+  CURRENCY_RATE_TRACE_SPAN("DiffFiles", before + " " + after);
+  FileRows before_rows(before, before_parser, options.max_line_length);
+  FileRows after_rows(after, after_parser, options.max_line_length);
+  RateDiffStats stats = MergeRows(&before_rows, &after_rows, sink, options);
+  stats.rejected = before_rows.rejected() + after_rows.rejected();
+  return stats;
+}
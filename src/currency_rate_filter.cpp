@@ -0,0 +1,436 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_filter.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "currency_date.h"
+#include "rate_format.h"
+
+using std::move;
+using std::string;
+using std::vector;
+
+namespace {
+
+enum class TokenType { kWord, kString, kOperator, kLeftParen, kRightParen,
+                       kComma, kSlash, kEnd };
+
+struct Token {
+  TokenType type;
+  string text;
+  size_t position;
+};
+
+bool IsWordChar(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '.' ||
+         c == '-' || c == '_';
+}
+
+string ToLower(string text) {
+  for (char& c : text) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return text;
+}
+
+vector<Token> Tokenize(const string& text) {
+  vector<Token> tokens;
+  size_t i = 0;
+
+  while (i < text.size()) {
+    char c = text[i];
+
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++i;
+    } else if (c == '(') {
+      tokens.push_back({TokenType::kLeftParen, "(", i++});
+    } else if (c == ')') {
+      tokens.push_back({TokenType::kRightParen, ")", i++});
+    } else if (c == ',') {
+      tokens.push_back({TokenType::kComma, ",", i++});
+    } else if (c == '/') {
+      tokens.push_back({TokenType::kSlash, "/", i++});
+    } else if (c == '"') {
+      size_t close = text.find('"', i + 1);
+      if (close == string::npos) {
+        throw InvalidFilterException("Unterminated string at position " +
+                                     std::to_string(i));
+      }
+      tokens.push_back({TokenType::kString,
+                        text.substr(i + 1, close - i - 1), i});
+      i = close + 1;
+    } else if (c == '=' || c == '!' || c == '<' || c == '>') {
+      size_t start = i++;
+      if (i < text.size() && text[i] == '=') {
+        ++i;
+      }
+      string op = text.substr(start, i - start);
+      if (op == "!") {
+        throw InvalidFilterException("Expected '!=' at position " +
+                                     std::to_string(start));
+      }
+      tokens.push_back({TokenType::kOperator, op, start});
+    } else if (IsWordChar(c)) {
+      size_t start = i;
+      while (i < text.size() && IsWordChar(text[i])) {
+        ++i;
+      }
+      tokens.push_back({TokenType::kWord, text.substr(start, i - start),
+                        start});
+    } else {
+      throw InvalidFilterException(string("Unexpected character '") + c +
+                                   "' at position " + std::to_string(i));
+    }
+  }
+
+  tokens.push_back({TokenType::kEnd, "", text.size()});
+  return tokens;
+}
+
+class FilterParser {
+public:
+  explicit FilterParser(const string& text) : tokens_(Tokenize(text)) {}
+
+  vector<FilterCondition> ParseConjunction() {
+    vector<FilterCondition> conditions;
+    conditions.push_back(ParseCondition());
+
+    while (Peek().type == TokenType::kWord &&
+           ToLower(Peek().text) == "and") {
+      Next();
+      conditions.push_back(ParseCondition());
+    }
+
+    if (Peek().type != TokenType::kEnd) {
+      Fail("Expected 'and' or end of filter");
+    }
+    return conditions;
+  }
+
+private:
+  const Token& Peek() const { return tokens_[current_]; }
+  const Token& Next() { return tokens_[current_++]; }
+
+  [[noreturn]] void Fail(const string& message) const {
+    throw InvalidFilterException(message + " at position " +
+                                 std::to_string(Peek().position));
+  }
+
+  const Token& Expect(TokenType type, const string& what) {
+    if (Peek().type != type) {
+      Fail("Expected " + what);
+    }
+    return Next();
+  }
+
+  FilterField ParseField() {
+    const Token& token = Expect(TokenType::kWord, "field name");
+    string name = ToLower(token.text);
+
+    if (name == "pair") return FilterField::kPair;
+    if (name == "currency") return FilterField::kCurrency;
+    if (name == "base" || name == "currency1") return FilterField::kCurrency1;
+    if (name == "quote" || name == "currency2") return FilterField::kCurrency2;
+    if (name == "date") return FilterField::kDate;
+    if (name == "rate") return FilterField::kRate;
+
+    --current_;
+    Fail("Unknown field '" + token.text + "'");
+  }
+
+  FilterOperator ParseOperator() {
+    if (Peek().type == TokenType::kWord && ToLower(Peek().text) == "in") {
+      Next();
+      return FilterOperator::kIn;
+    }
+
+    const string& op = Expect(TokenType::kOperator, "comparison operator").text;
+    if (op == "=" || op == "==") return FilterOperator::kEqual;
+    if (op == "!=") return FilterOperator::kNotEqual;
+    if (op == "<") return FilterOperator::kLess;
+    if (op == "<=") return FilterOperator::kLessEqual;
+    if (op == ">") return FilterOperator::kGreater;
+    return FilterOperator::kGreaterEqual;
+  }
+
+  string ParseName() {
+    if (Peek().type != TokenType::kWord && Peek().type != TokenType::kString) {
+      Fail("Expected value");
+    }
+    return Next().text;
+  }
+
+  void ParseOperand(FilterCondition* condition) {
+    if (condition->field == FilterField::kPair) {
+      string first = ParseName();
+      Expect(TokenType::kSlash, "'/' in currency pair");
+      string second = ParseName();
+      condition->pairs.emplace_back(move(first), move(second));
+      return;
+    }
+
+    size_t position = Peek().position;
+    string value = ParseName();
+
+    if (condition->field == FilterField::kDate) {
+      try {
+        CurrencyDate::ToDayNumber(value);
+      } catch (const InvalidDateException&) {
+        throw InvalidFilterException("Expected date YYYY.MM.DD at position " +
+                                     std::to_string(position));
+      }
+    } else if (condition->field == FilterField::kRate) {
+      if (!RateFormat::Parse(value, &condition->number)) {
+        throw InvalidFilterException("Expected number at position " +
+                                     std::to_string(position));
+      }
+    }
+
+    condition->values.push_back(move(value));
+  }
+
+  FilterCondition ParseCondition() {
+    FilterCondition condition;
+    condition.field = ParseField();
+    condition.op = ParseOperator();
+
+    bool ordered = condition.op != FilterOperator::kEqual &&
+                   condition.op != FilterOperator::kNotEqual &&
+                   condition.op != FilterOperator::kIn;
+    if (ordered && condition.field != FilterField::kDate &&
+        condition.field != FilterField::kRate) {
+      Fail("Ordering comparison is only allowed for date and rate");
+    }
+
+    if (condition.op == FilterOperator::kIn) {
+      Expect(TokenType::kLeftParen, "'('");
+      ParseOperand(&condition);
+      while (Peek().type == TokenType::kComma) {
+        Next();
+        ParseOperand(&condition);
+      }
+      Expect(TokenType::kRightParen, "')'");
+    } else {
+      ParseOperand(&condition);
+    }
+
+    return condition;
+  }
+
+  vector<Token> tokens_;
+  size_t current_ = 0;
+};
+
+template <typename T>
+bool Compare(FilterOperator op, const T& left, const T& right) {
+  switch (op) {
+    case FilterOperator::kEqual:
+    case FilterOperator::kIn:
+      return left == right;
+    case FilterOperator::kNotEqual:
+      return left != right;
+    case FilterOperator::kLess:
+      return left < right;
+    case FilterOperator::kLessEqual:
+      return left <= right;
+    case FilterOperator::kGreater:
+      return left > right;
+    case FilterOperator::kGreaterEqual:
+      return left >= right;
+  }
+  return false;
+}
+
+bool Contains(const vector<string>& values, const string& value) {
+  return std::find(values.begin(), values.end(), value) != values.end();
+}
+
+}  // namespace
+
+FilterExpression FilterExpression::Parse(const string& text) {
+  FilterParser parser(text);
+  FilterExpression expression;
+  expression.conditions_ = parser.ParseConjunction();
+  return expression;
+}
+
+CompiledFilter::CompiledFilter(const FilterExpression& expression) {
+  for (const auto& condition : expression.conditions()) {
+    stages_.push_back(CompileCondition(condition));
+  }
+  ChooseIndex(expression);
+}
+
+CompiledFilter::Stage CompiledFilter::CompileCondition(
+    const FilterCondition& condition) {
+  const FilterOperator op = condition.op;
+
+  switch (condition.field) {
+    case FilterField::kPair: {
+      vector<CurrencyPair> pairs = condition.pairs;
+      bool negate = op == FilterOperator::kNotEqual;
+      return [pairs, negate](const CurrencyRate& rate) {
+        for (const auto& pair : pairs) {
+          if (rate.currency1() == pair.currency1 &&
+              rate.currency2() == pair.currency2) {
+            return !negate;
+          }
+        }
+        return negate;
+      };
+    }
+    case FilterField::kCurrency: {
+      vector<string> values = condition.values;
+      bool negate = op == FilterOperator::kNotEqual;
+      return [values, negate](const CurrencyRate& rate) {
+        bool found = Contains(values, rate.currency1()) ||
+                     Contains(values, rate.currency2());
+        return found != negate;
+      };
+    }
+    case FilterField::kCurrency1:
+    case FilterField::kCurrency2: {
+      vector<string> values = condition.values;
+      bool negate = op == FilterOperator::kNotEqual;
+      bool first = condition.field == FilterField::kCurrency1;
+      return [values, negate, first](const CurrencyRate& rate) {
+        const string& name = first ? rate.currency1() : rate.currency2();
+        return Contains(values, name) != negate;
+      };
+    }
+    case FilterField::kDate: {
+      if (op == FilterOperator::kIn) {
+        vector<string> values = condition.values;
+        return [values](const CurrencyRate& rate) {
+          return Contains(values, rate.date());
+        };
+      }
+      string value = condition.values.front();
+      return [op, value](const CurrencyRate& rate) {
+        return Compare(op, rate.date(), value);
+      };
+    }
+    case FilterField::kRate: {
+      if (op == FilterOperator::kIn) {
+        vector<double> numbers;
+        for (const auto& value : condition.values) {
+          double number = 0.0;
+          RateFormat::Parse(value, &number);
+          numbers.push_back(number);
+        }
+        return [numbers](const CurrencyRate& rate) {
+          return std::find(numbers.begin(), numbers.end(), rate.rate()) !=
+                 numbers.end();
+        };
+      }
+      double number = condition.number;
+      return [op, number](const CurrencyRate& rate) {
+        return Compare(op, rate.rate(), number);
+      };
+    }
+  }
+  return [](const CurrencyRate&) { return true; };
+}
+
+void CompiledFilter::ChooseIndex(const FilterExpression& expression) {
+  bool has_date_bound = false;
+  FilterIndexHint date_hint;
+  date_hint.kind = FilterIndexHint::Kind::kDateRange;
+
+  for (const auto& condition : expression.conditions()) {
+    bool positive = condition.op == FilterOperator::kEqual ||
+                    condition.op == FilterOperator::kIn;
+
+    if (condition.field == FilterField::kPair && positive) {
+      index_hint_.kind = FilterIndexHint::Kind::kPairs;
+      index_hint_.pairs = condition.pairs;
+      return;
+    }
+
+    if (condition.field != FilterField::kDate &&
+        condition.field != FilterField::kRate &&
+        condition.field != FilterField::kPair &&
+        condition.op == FilterOperator::kEqual &&
+        index_hint_.kind == FilterIndexHint::Kind::kNone) {
+      index_hint_.kind = FilterIndexHint::Kind::kCurrency;
+      index_hint_.currency = condition.values.front();
+    }
+
+    if (condition.field == FilterField::kDate &&
+        condition.op != FilterOperator::kNotEqual) {
+      string low;
+      string high;
+      if (condition.op == FilterOperator::kIn) {
+        low = *std::min_element(condition.values.begin(),
+                                condition.values.end());
+        high = *std::max_element(condition.values.begin(),
+                                 condition.values.end());
+      } else {
+        const string& value = condition.values.front();
+        bool lower = condition.op != FilterOperator::kLess &&
+                     condition.op != FilterOperator::kLessEqual;
+        bool upper = condition.op != FilterOperator::kGreater &&
+                     condition.op != FilterOperator::kGreaterEqual;
+        if (lower) low = value;
+        if (upper) high = value;
+      }
+
+      if (!low.empty() && (date_hint.date_from.empty() ||
+                           low > date_hint.date_from)) {
+        date_hint.date_from = low;
+      }
+      if (!high.empty() && (date_hint.date_to.empty() ||
+                            high < date_hint.date_to)) {
+        date_hint.date_to = high;
+      }
+      has_date_bound = true;
+    }
+  }
+
+  if (index_hint_.kind == FilterIndexHint::Kind::kNone && has_date_bound) {
+    index_hint_ = date_hint;
+  }
+}
+
+void CompiledFilter::Apply(const vector<CurrencyRate>& rates,
+                           vector<size_t>* selection) const {
+  size_t write = 0;
+
+  for (size_t begin = 0; begin < selection->size(); begin += kBatchSize) {
+    size_t end = std::min(begin + kBatchSize, selection->size());
+    size_t* batch = selection->data() + begin;
+    size_t survivors = end - begin;
+
+    for (const auto& stage : stages_) {
+      size_t kept = 0;
+      for (size_t i = 0; i < survivors; ++i) {
+        size_t position = batch[i];
+        batch[kept] = position;
+        kept += stage(rates[position]) ? 1 : 0;
+      }
+      survivors = kept;
+      if (survivors == 0) {
+        break;
+      }
+    }
+
+    for (size_t i = 0; i < survivors; ++i) {
+      (*selection)[write++] = batch[i];
+    }
+  }
+
+  selection->resize(write);
+}
+
+bool CompiledFilter::Matches(const CurrencyRate& rate) const {
+  for (const auto& stage : stages_) {
+    if (!stage(rate)) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,107 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_follower.h"
+
+#include <filesystem>
+#include <set>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using std::atomic;
+using std::move;
+using std::set;
+using std::string;
+using std::vector;
+
+CurrencyRateFollower::CurrencyRateFollower(vector<string> files,
+                                           RefreshFunction refresh,
+                                           FollowOptions options)
+    : files_(move(files)), refresh_(move(refresh)), options_(options) {}
+
+void CurrencyRateFollower::Run(const atomic<bool>& stop,
+                               const RefreshCallback& on_refresh) {
+  // Pick up anything appended before watching started.
+  RefreshAndNotify(on_refresh);
+
+  if (options_.use_inotify && RunInotify(stop, on_refresh)) {
+    return;
+  }
+  RunPolling(stop, on_refresh);
+}
+
+void CurrencyRateFollower::RefreshAndNotify(
+    const RefreshCallback& on_refresh) {
+  RefreshResult result = refresh_();
+  if (on_refresh && (result.bytes_read > 0 || result.rotations > 0 ||
+                     result.truncations > 0)) {
+    on_refresh(result);
+  }
+}
+
+void CurrencyRateFollower::RunPolling(const atomic<bool>& stop,
+                                      const RefreshCallback& on_refresh) {
+  while (!stop) {
+    std::this_thread::sleep_for(options_.poll_interval);
+    RefreshAndNotify(on_refresh);
+  }
+}
+
+#ifdef __linux__
+bool CurrencyRateFollower::RunInotify(const atomic<bool>& stop,
+                                      const RefreshCallback& on_refresh) {
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  // Watching directories rather than files keeps working after a rotated
+  // file is replaced, which would orphan a watch on the old inode.
+  set<string> directories;
+  for (const auto& file : files_) {
+    std::filesystem::path parent = std::filesystem::path(file).parent_path();
+    directories.insert(parent.empty() ? "." : parent.string());
+  }
+
+  const uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE |
+                        IN_MOVED_TO | IN_DELETE;
+  bool watching = false;
+  for (const auto& directory : directories) {
+    watching |= inotify_add_watch(fd, directory.c_str(), mask) >= 0;
+  }
+  if (!watching) {
+    close(fd);
+    return false;
+  }
+
+  alignas(inotify_event) char events[16 * 1024];
+  const int timeout_ms = static_cast<int>(options_.poll_interval.count());
+
+  while (!stop) {
+    pollfd watcher{fd, POLLIN, 0};
+    int ready = poll(&watcher, 1, timeout_ms);
+    if (ready <= 0) {
+      continue;
+    }
+
+    // Drain every queued event; one refresh covers all of them.
+    while (read(fd, events, sizeof(events)) > 0) {
+    }
+    RefreshAndNotify(on_refresh);
+  }
+
+  close(fd);
+  return true;
+}
+#else
+bool CurrencyRateFollower::RunInotify(const atomic<bool>&,
+                                      const RefreshCallback&) {
+  return false;
+}
+#endif
@@ -0,0 +1,159 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_index.h"
+
+#include <algorithm>
+#include <iterator>
+
+using std::string;
+using std::vector;
+
+void CurrencyRateIndex::Add(const CurrencyRate& rate, size_t position) {
+  by_currency_[rate.currency1()].push_back(position);
+  by_currency_[rate.currency2()].push_back(position);
+  by_pair_[CurrencyPair(rate.currency1(), rate.currency2())].push_back(
+      position);
+  by_date_[rate.date()].push_back(position);
+  pair_series_[CurrencyPair(rate.currency1(), rate.currency2())].emplace(
+      rate.date(), position);
+}
+
+void CurrencyRateIndex::Rebuild(const vector<CurrencyRate>& rates) {
+  Clear();
+  for (size_t i = 0; i < rates.size(); ++i) {
+    Add(rates[i], i);
+  }
+}
+
+void CurrencyRateIndex::Clear() {
+  by_currency_.clear();
+  by_pair_.clear();
+  by_date_.clear();
+  pair_series_.clear();
+}
+
+void CurrencyRateIndex::ShrinkToFit() {
+  for (auto& entry : by_currency_) {
+    entry.second.shrink_to_fit();
+  }
+  for (auto& entry : by_pair_) {
+    entry.second.shrink_to_fit();
+  }
+  for (auto& entry : by_date_) {
+    entry.second.shrink_to_fit();
+  }
+}
+
+void CurrencyRateIndex::AccountMemory(MemoryUsageReport* usage) const {
+  size_t bytes = MemoryAccounting::HashNodes(by_currency_) +
+                 MemoryAccounting::HashNodes(by_pair_) +
+                 MemoryAccounting::TreeNodes(by_date_) +
+                 MemoryAccounting::HashNodes(pair_series_);
+  size_t slack = 0;
+
+  for (const auto& entry : by_currency_) {
+    bytes += MemoryAccounting::StringHeap(entry.first) +
+             MemoryAccounting::VectorBytes(entry.second);
+    slack += MemoryAccounting::VectorSlack(entry.second);
+  }
+  for (const auto& entry : by_pair_) {
+    bytes += MemoryAccounting::StringHeap(entry.first.currency1) +
+             MemoryAccounting::StringHeap(entry.first.currency2) +
+             MemoryAccounting::VectorBytes(entry.second);
+    slack += MemoryAccounting::VectorSlack(entry.second);
+  }
+  for (const auto& entry : by_date_) {
+    bytes += MemoryAccounting::StringHeap(entry.first) +
+             MemoryAccounting::VectorBytes(entry.second);
+    slack += MemoryAccounting::VectorSlack(entry.second);
+  }
+  for (const auto& entry : pair_series_) {
+    bytes += MemoryAccounting::StringHeap(entry.first.currency1) +
+             MemoryAccounting::StringHeap(entry.first.currency2) +
+             MemoryAccounting::TreeNodes(entry.second);
+    for (const auto& point : entry.second) {
+      bytes += MemoryAccounting::StringHeap(point.first);
+    }
+  }
+
+  usage->indexes += bytes;
+  usage->slack += slack;
+}
+
+const vector<size_t>* CurrencyRateIndex::FindCurrency(
+    const string& currency) const {
+  auto it = by_currency_.find(currency);
+  return it == by_currency_.end() ? nullptr : &it->second;
+}
+
+const vector<size_t>* CurrencyRateIndex::FindPair(
+    const CurrencyPair& pair) const {
+  auto it = by_pair_.find(pair);
+  return it == by_pair_.end() ? nullptr : &it->second;
+}
+
+const vector<size_t>* CurrencyRateIndex::FindDate(const string& date) const {
+  auto it = by_date_.find(date);
+  return it == by_date_.end() ? nullptr : &it->second;
+}
+
+const size_t* CurrencyRateIndex::FindPairDate(const CurrencyPair& pair,
+                                              const string& date) const {
+  auto series = pair_series_.find(pair);
+  if (series == pair_series_.end()) {
+    return nullptr;
+  }
+  auto it = series->second.find(date);
+  return it == series->second.end() ? nullptr : &it->second;
+}
+
+const size_t* CurrencyRateIndex::FindPairAsOf(const CurrencyPair& pair,
+                                              const string& date) const {
+  auto series = pair_series_.find(pair);
+  if (series == pair_series_.end()) {
+    return nullptr;
+  }
+  auto it = series->second.upper_bound(date);
+  if (it == series->second.begin()) {
+    return nullptr;
+  }
+  return &std::prev(it)->second;
+}
+
+vector<size_t> CurrencyRateIndex::FindPairDateRange(const CurrencyPair& pair,
+                                                    const string& from,
+                                                    const string& to) const {
+  vector<size_t> positions;
+  auto series = pair_series_.find(pair);
+  if (series == pair_series_.end() ||
+      (!from.empty() && !to.empty() && from > to)) {
+    return positions;
+  }
+
+  const auto& dates = series->second;
+  auto begin = from.empty() ? dates.begin() : dates.lower_bound(from);
+  auto end = to.empty() ? dates.end() : dates.upper_bound(to);
+  for (auto it = begin; it != end; ++it) {
+    positions.push_back(it->second);
+  }
+  return positions;
+}
+
+vector<size_t> CurrencyRateIndex::FindDateRange(const string& from,
+                                                const string& to) const {
+  if (!from.empty() && !to.empty() && from > to) {
+    return {};
+  }
+
+  auto begin = from.empty() ? by_date_.begin() : by_date_.lower_bound(from);
+  auto end = to.empty() ? by_date_.end() : by_date_.upper_bound(to);
+
+  vector<size_t> positions;
+  for (auto it = begin; it != end; ++it) {
+    positions.insert(positions.end(), it->second.begin(), it->second.end());
+  }
+  std::sort(positions.begin(), positions.end());
+  return positions;
+}
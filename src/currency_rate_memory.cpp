@@ -0,0 +1,38 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_memory.h"
+
+#include <sstream>
+
+using std::string;
+
+namespace {
+
+// Capacity of the inline buffer of an empty string.
+const size_t kInlineCapacity = string().capacity();
+
+}  // namespace
+
+string MemoryUsageReport::ToString() const {
+  std::ostringstream out;
+  out << "records " << records << '\n'
+      << "record_storage " << record_storage << '\n'
+      << "string_heap " << string_heap << '\n'
+      << "indexes " << indexes << '\n'
+      << "caches " << caches << '\n'
+      << "slack " << slack << '\n'
+      << "total " << Total() << '\n';
+  return out.str();
+}
+
+size_t MemoryAccounting::StringHeap(const string& text) {
+  return text.capacity() > kInlineCapacity ? text.size() + 1 : 0;
+}
+
+size_t MemoryAccounting::StringSlack(const string& text) {
+  return text.capacity() > kInlineCapacity
+             ? text.capacity() - text.size()
+             : 0;
+}
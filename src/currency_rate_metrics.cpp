@@ -0,0 +1,327 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include "currency_rate.h"
+
+using std::lock_guard;
+using std::make_unique;
+using std::mutex;
+using std::ofstream;
+using std::runtime_error;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+const char* const kRejectReasons[] = {
+    "InvalidFormatException", "InvalidCurrencyException",
+    "InvalidRateException",   "InvalidDateException",
+    "CurrencyRateException",  "std::exception",
+};
+
+// Prometheus bucket bounds are 2^k ns for these k.
+constexpr int kFirstExportedPower = 6;
+constexpr int kLastExportedPower = 36;
+
+string FamilyName(const string& name) {
+  return name.substr(0, name.find('{'));
+}
+
+// Labels of |name| with |extra| appended, in braces; empty if none.
+string Labels(const string& name, const string& extra) {
+  size_t brace = name.find('{');
+  string labels = brace == string::npos
+                      ? string()
+                      : name.substr(brace + 1, name.size() - brace - 2);
+  if (!extra.empty()) {
+    labels += labels.empty() ? extra : "," + extra;
+  }
+  return labels.empty() ? string() : "{" + labels + "}";
+}
+
+string Seconds(uint64_t nanoseconds) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.9g", nanoseconds / 1e9);
+  return buffer;
+}
+
+void AppendFamilyHeader(const MetricsSnapshot& snapshot, const string& family,
+                        const char* type, string* previous, string* out) {
+  if (family == *previous) {
+    return;
+  }
+  *previous = family;
+  auto help = snapshot.help.find(family);
+  if (help != snapshot.help.end() && !help->second.empty()) {
+    out->append("# HELP ").append(family).append(" ")
+        .append(help->second).push_back('\n');
+  }
+  out->append("# TYPE ").append(family).append(" ").append(type)
+      .push_back('\n');
+}
+
+}  // namespace
+
+void LatencyHistogram::Reset() {
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  sum_.store(0, std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+  if (value < kSubBuckets) {
+    return static_cast<size_t>(value);
+  }
+#if defined(__GNUC__)
+  int exponent = 63 - __builtin_clzll(value);
+#else
+  int exponent = kSubBucketBits;
+  while ((value >> exponent) > 1) {
+    ++exponent;
+  }
+#endif
+  size_t sub = static_cast<size_t>(value >> (exponent - kSubBucketBits)) &
+               (kSubBuckets - 1);
+  return static_cast<size_t>(exponent - kSubBucketBits + 1) * kSubBuckets +
+         sub;
+}
+
+uint64_t LatencyHistogram::BucketLimit(size_t index) {
+  if (index < kSubBuckets) {
+    return index + 1;
+  }
+  int shift = static_cast<int>(index / kSubBuckets) - 1;
+  uint64_t sub = index % kSubBuckets;
+  uint64_t limit = (kSubBuckets + sub + 1) << shift;
+  // The last bucket ends at 2^64, which saturates.
+  return limit == 0 ? UINT64_MAX : limit;
+}
+
+double HistogramSnapshot::MeanNanoseconds() const {
+  return count == 0 ? 0.0 : static_cast<double>(sum_ns) / count;
+}
+
+uint64_t HistogramSnapshot::QuantileNanoseconds(double q) const {
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(std::ceil(q * count));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (const auto& bucket : buckets) {
+    seen += bucket.second;
+    if (seen >= rank) {
+      return bucket.first;
+    }
+  }
+  return buckets.back().first;
+}
+
+const CounterSnapshot* MetricsSnapshot::FindCounter(const string& name) const {
+  for (const auto& counter : counters) {
+    if (counter.name == name) {
+      return &counter;
+    }
+  }
+  return nullptr;
+}
+
+const HistogramSnapshot* MetricsSnapshot::FindHistogram(
+    const string& name) const {
+  for (const auto& histogram : histograms) {
+    if (histogram.name == name) {
+      return &histogram;
+    }
+  }
+  return nullptr;
+}
+
+string MetricsSnapshot::ToPrometheus() const {
+  string out;
+  string previous;
+
+  for (const auto& counter : counters) {
+    string family = FamilyName(counter.name);
+    AppendFamilyHeader(*this, family, "counter", &previous, &out);
+    out.append(counter.name).append(" ").append(to_string(counter.value))
+        .push_back('\n');
+  }
+
+  for (const auto& histogram : histograms) {
+    string family = FamilyName(histogram.name);
+    AppendFamilyHeader(*this, family, "histogram", &previous, &out);
+
+    // Fine buckets never straddle a power of two, so the cumulative
+    // counts at these bounds are exact.
+    size_t next = 0;
+    uint64_t cumulative = 0;
+    for (int power = kFirstExportedPower; power <= kLastExportedPower;
+         ++power) {
+      uint64_t bound = uint64_t{1} << power;
+      while (next < histogram.buckets.size() &&
+             histogram.buckets[next].first <= bound) {
+        cumulative += histogram.buckets[next++].second;
+      }
+      out.append(family).append("_bucket")
+          .append(Labels(histogram.name, "le=\"" + Seconds(bound) + "\""))
+          .append(" ").append(to_string(cumulative)).push_back('\n');
+    }
+    out.append(family).append("_bucket")
+        .append(Labels(histogram.name, "le=\"+Inf\""))
+        .append(" ").append(to_string(histogram.count)).push_back('\n');
+    out.append(family).append("_sum").append(Labels(histogram.name, ""))
+        .append(" ").append(Seconds(histogram.sum_ns)).push_back('\n');
+    out.append(family).append("_count").append(Labels(histogram.name, ""))
+        .append(" ").append(to_string(histogram.count)).push_back('\n');
+  }
+  return out;
+}
+
+MetricsRegistry& MetricsRegistry::Global() {
+  // Never destroyed, so metrics can be recorded during static destruction.
+  static MetricsRegistry* registry = new MetricsRegistry();
+  return *registry;
+}
+
+MetricCounter& MetricsRegistry::Counter(const string& name,
+                                        const string& help) {
+  lock_guard<mutex> lock(mutex_);
+  SetHelp(name, help);
+  auto& counter = counters_[name];
+  if (!counter) {
+    counter = make_unique<MetricCounter>();
+  }
+  return *counter;
+}
+
+LatencyHistogram& MetricsRegistry::Histogram(const string& name,
+                                             const string& help) {
+  lock_guard<mutex> lock(mutex_);
+  SetHelp(name, help);
+  auto& histogram = histograms_[name];
+  if (!histogram) {
+    histogram = make_unique<LatencyHistogram>();
+  }
+  return *histogram;
+}
+
+void MetricsRegistry::SetHelp(const string& name, const string& help) {
+  string& text = help_[FamilyName(name)];
+  if (text.empty()) {
+    text = help;
+  }
+}
+
+MetricsSnapshot MetricsRegistry::Snapshot() const {
+  lock_guard<mutex> lock(mutex_);
+  MetricsSnapshot snapshot;
+  snapshot.help = help_;
+
+  for (const auto& entry : counters_) {
+    snapshot.counters.push_back({entry.first, entry.second->value()});
+  }
+
+  for (const auto& entry : histograms_) {
+    const LatencyHistogram& histogram = *entry.second;
+    HistogramSnapshot result;
+    result.name = entry.first;
+    for (size_t i = 0; i < LatencyHistogram::kBucketCount; ++i) {
+      if (uint64_t recorded = histogram.bucket(i)) {
+        result.buckets.emplace_back(LatencyHistogram::BucketLimit(i),
+                                    recorded);
+        result.count += recorded;
+      }
+    }
+    // Under concurrent recording the sum may run slightly ahead of the
+    // buckets; the count always agrees with them.
+    result.sum_ns = histogram.sum();
+    snapshot.histograms.push_back(std::move(result));
+  }
+  return snapshot;
+}
+
+void MetricsRegistry::Reset() {
+  lock_guard<mutex> lock(mutex_);
+  for (auto& entry : counters_) {
+    entry.second->Reset();
+  }
+  for (auto& entry : histograms_) {
+    entry.second->Reset();
+  }
+}
+
+void MetricsRegistry::WritePrometheus(const string& filename) const {
+  string text = Snapshot().ToPrometheus();
+  ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw runtime_error("Failed to open file for writing: " + filename);
+  }
+  file.write(text.data(), static_cast<std::streamsize>(text.size()));
+  if (!file) {
+    throw runtime_error("Failed to write file: " + filename);
+  }
+}
+
+const char* RateLoadMetrics::RejectReason(const std::exception* error) {
+  if (error == nullptr) {
+    return kRejectReasons[0];
+  }
+  try {
+    std::rethrow_if_nested(*error);
+  } catch (const CurrencyRateException& cause) {
+    return RejectReason(&cause);
+  } catch (...) {
+    // Causes from outside the library are reported as their wrapper.
+  }
+
+  if (dynamic_cast<const InvalidFormatException*>(error)) {
+    return kRejectReasons[0];
+  }
+  if (dynamic_cast<const InvalidCurrencyException*>(error)) {
+    return kRejectReasons[1];
+  }
+  if (dynamic_cast<const InvalidRateException*>(error)) {
+    return kRejectReasons[2];
+  }
+  if (dynamic_cast<const InvalidDateException*>(error)) {
+    return kRejectReasons[3];
+  }
+  if (dynamic_cast<const CurrencyRateException*>(error)) {
+    return kRejectReasons[4];
+  }
+  return kRejectReasons[5];
+}
+
+void RateLoadMetrics::CountRejectedLine(const std::exception* error) {
+  // Every reason is registered up front so that the series exist at zero.
+  static const vector<MetricCounter*> counters = []() {
+    vector<MetricCounter*> result;
+    for (const char* reason : kRejectReasons) {
+      result.push_back(&MetricsRegistry::Global().Counter(
+          string("currency_rate_rejected_lines_total{reason=\"") + reason +
+              "\"}",
+          "Lines rejected while loading, by the exception type that "
+          "rejected them."));
+    }
+    return result;
+  }();
+
+  const char* reason = RejectReason(error);
+  for (size_t i = 0; i < counters.size(); ++i) {
+    if (reason == kRejectReasons[i]) {
+      counters[i]->Add();
+      return;
+    }
+  }
+}
@@ -4,51 +4,394 @@
 
 #include "currency_rate_parser.h"
 
+#include <cctype>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
 #include <regex>
+#include <stdexcept>
+
+#include "currency_rate_dialect.h"
+#include "currency_rate_metrics.h"
+#include "currency_rate_trace.h"
+#include "rate_format.h"
 
 using std::invalid_argument;
 using std::make_unique;
 using std::regex;
 using std::regex_match;
 using std::smatch;
-using std::stod;
 using std::string;
+using std::string_view;
 using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+bool IsSpace(char c) {
+  return std::isspace(static_cast<unsigned char>(c));
+}
+
+bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// [\d.]+
+bool IsRateText(string_view text) {
+  if (text.empty()) {
+    return false;
+  }
+  for (char c : text) {
+    if (!IsDigit(c) && c != '.') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// \d{4}\.\d{2}\.\d{2}
+bool IsDateText(string_view text) {
+  if (text.size() != 10 || text[4] != '.' || text[7] != '.') {
+    return false;
+  }
+  for (size_t i : {0, 1, 2, 3, 5, 6, 8, 9}) {
+    if (!IsDigit(text[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+void RateColumnBatch::Clear() {
+  currency1.clear();
+  currency2.clear();
+  rate.clear();
+  date.clear();
+  units.clear();
+  errors.clear();
+}
+
+void RateColumnBatch::AppendRow(string_view currency1_value,
+                                string_view currency2_value,
+                                double rate_value, string_view date_value,
+                                int64_t units_value) {
+  currency1.emplace_back(currency1_value);
+  currency2.emplace_back(currency2_value);
+  rate.push_back(rate_value);
+  date.emplace_back(date_value);
+  if (scale >= 0) {
+    units.push_back(units_value);
+  }
+  errors.resize((size() + 63) / 64);
+}
+
+void RateColumnBatch::AppendError() {
+  AppendRow(string_view(), string_view(), 0.0, string_view());
+  size_t row = size() - 1;
+  errors[row / 64] |= uint64_t{1} << (row % 64);
+}
+
+CurrencyRate RateColumnBatch::ToRate(size_t row) const {
+  if (HasError(row)) {
+    throw InvalidFormatException("Row " + std::to_string(row) +
+                                 " does not match expected format");
+  }
+  if (scale >= 0) {
+    return CurrencyRate(currency1[row], currency2[row],
+                        FixedRate(units[row], scale), date[row]);
+  }
+  return CurrencyRate(currency1[row], currency2[row], rate[row], date[row]);
+}
+
+void ICurrencyRateParser::ParseBatch(const vector<string_view>& lines,
+                                     RateColumnBatch* batch) const {
+  batch->scale = -1;
+  for (string_view line : lines) {
+    try {
+      CurrencyRate rate = Parse(string(line));
+      batch->AppendRow(rate.currency1(), rate.currency2(), rate.rate(),
+                       rate.date());
+    } catch (const CurrencyRateException&) {
+      batch->AppendError();
+    }
+  }
+}
+
+size_t ICurrencyRateParser::SplitLines(string_view buffer,
+                                       vector<string_view>* lines) {
+  const char* begin = buffer.data();
+  const char* end = begin + buffer.size();
+  const char* position = begin;
+
+  while (position < end) {
+    const char* newline = static_cast<const char*>(
+        std::memchr(position, '\n', static_cast<size_t>(end - position)));
+    if (newline == nullptr) {
+      break;
+    }
+    lines->emplace_back(position, static_cast<size_t>(newline - position));
+    position = newline + 1;
+  }
+
+  return static_cast<size_t>(position - begin);
+}
+
+RegexCurrencyRateParser::RegexCurrencyRateParser(int fixed_scale)
+    : fixed_scale_(fixed_scale) {
+  if (fixed_scale > FixedRate::kMaxScale) {
+    throw invalid_argument("Fixed-point scale must be at most " +
+                           std::to_string(FixedRate::kMaxScale));
+  }
+  if (fixed_scale < 0) {
+    fixed_scale_ = kFloatingPoint;
+  }
+}
 
 const regex RegexCurrencyRateParser::kPattern(
     "^\\s*(\"([^\"]*)\"|([^ \"]+))\\s+(\"([^\"]*)\"|([^ \"]+))\\s+([\\d.]+)\\s+(\\d{4}\\.\\d{2}\\.\\d{2})\\s*$");
 
+bool RegexCurrencyRateParser::SplitFields(string_view line, Fields* fields) {
+  size_t begin = 0;
+  size_t end = line.size();
+  while (begin < end && IsSpace(line[begin])) {
+    ++begin;
+  }
+  while (end > begin && IsSpace(line[end - 1])) {
+    --end;
+  }
+
+  string_view tokens[4];
+  size_t count = 0;
+  size_t position = begin;
+  while (position < end) {
+    size_t token_end = position;
+    while (token_end < end && line[token_end] != ' ') {
+      char c = line[token_end];
+      // Quoted names and other whitespace take the regex path.
+      if (c == '"' || IsSpace(c)) {
+        return false;
+      }
+      ++token_end;
+    }
+    if (count == 4) {
+      return false;
+    }
+    tokens[count++] = line.substr(position, token_end - position);
+
+    position = token_end;
+    while (position < end && line[position] == ' ') {
+      ++position;
+    }
+  }
+
+  if (count != 4 || !IsRateText(tokens[2]) || !IsDateText(tokens[3])) {
+    return false;
+  }
+
+  fields->currency1 = tokens[0];
+  fields->currency2 = tokens[1];
+  fields->rate = tokens[2];
+  fields->date = tokens[3];
+  return true;
+}
+
+bool RegexCurrencyRateParser::MatchFields(const string& line, smatch* matches,
+                                          Fields* fields) {
+  if (!regex_match(line, *matches, kPattern)) {
+    return false;
+  }
+
+  auto view = [&line](const std::ssub_match& match) {
+    return string_view(line).substr(
+        static_cast<size_t>(match.first - line.begin()),
+        static_cast<size_t>(match.length()));
+  };
+
+  const smatch& m = *matches;
+  fields->currency1 = view(m[2].matched ? m[2] : m[3]);
+  fields->currency2 = view(m[5].matched ? m[5] : m[6]);
+  fields->rate = view(m[7]);
+  fields->date = view(m[8]);
+  return true;
+}
+
 CurrencyRate RegexCurrencyRateParser::Parse(const string& line) const {
+  Fields fields;
   smatch matches;
 
-  if (!regex_match(line, matches, kPattern)) {
+  if (!SplitFields(line, &fields) && !MatchFields(line, &matches, &fields)) {
     throw InvalidFormatException(
         "Line does not match expected format: " + line);
   }
 
   try {
-    string currency1 = matches[2].matched ?
-        matches[2].str() : matches[3].str();
-
-    string currency2 = matches[5].matched ?
-        matches[5].str() : matches[6].str();
+    return MakeRate(fields);
+  } catch (const std::exception& e) {
+    // The cause stays attached for callers that report by error type.
+    std::throw_with_nested(InvalidFormatException(
+        "Error parsing line: " + string(e.what())));
+  }
+}
 
-    double rate = stod(matches[7].str());
-    string date = matches[8].str();
+CurrencyRate RegexCurrencyRateParser::MakeRate(const Fields& fields) const {
+  string currency1(fields.currency1);
+  string currency2(fields.currency2);
+  string date(fields.date);
 
+  if (fixed_scale_ >= 0) {
+    FixedRate rate;
+    if (!FixedRate::Parse(fields.rate, fixed_scale_, &rate)) {
+      throw invalid_argument("invalid rate " + string(fields.rate));
+    }
     return CurrencyRate(currency1, currency2, rate, date);
+  }
 
-  } catch (const std::exception& e) {
-    throw InvalidFormatException(
-        "Error parsing line: " + string(e.what()));
+  double rate = 0.0;
+  if (!RateFormat::Parse(fields.rate, &rate)) {
+    throw invalid_argument("invalid rate " + string(fields.rate));
   }
+  return CurrencyRate(currency1, currency2, rate, date);
 }
 
 bool RegexCurrencyRateParser::CanParse(const string& line) const {
-  return regex_match(line, kPattern);
+  Fields fields;
+  return SplitFields(line, &fields) || regex_match(line, kPattern);
+}
+
+void RegexCurrencyRateParser::ParseBatch(const vector<string_view>& lines,
+                                         RateColumnBatch* batch) const {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_parse_batch_seconds",
+                           "Time to parse one batch of lines into columns.");
+  CURRENCY_RATE_TRACE_SPAN("ParseBatch");
+  string line_copy;
+  smatch matches;
+  batch->scale = fixed_scale_;
+
+  for (string_view line : lines) {
+    Fields fields;
+    bool matched = SplitFields(line, &fields);
+    if (!matched) {
+      line_copy.assign(line);
+      matched = MatchFields(line_copy, &matches, &fields);
+    }
+
+    if (!matched) {
+      batch->AppendError();
+      continue;
+    }
+
+    if (fixed_scale_ >= 0) {
+      FixedRate rate;
+      if (FixedRate::Parse(fields.rate, fixed_scale_, &rate)) {
+        batch->AppendRow(fields.currency1, fields.currency2,
+                         rate.ToDouble(), fields.date, rate.units());
+      } else {
+        batch->AppendError();
+      }
+      continue;
+    }
+
+    double rate = 0.0;
+    if (RateFormat::Parse(fields.rate, &rate)) {
+      batch->AppendRow(fields.currency1, fields.currency2, rate, fields.date);
+    } else {
+      batch->AppendError();
+    }
+  }
 }
 
 unique_ptr<ICurrencyRateParser>
 CurrencyRateParserFactory::CreateDefaultParser() {
   return make_unique<RegexCurrencyRateParser>();
-}
\ No newline at end of file
+}
+
+unique_ptr<ICurrencyRateParser>
+CurrencyRateParserFactory::CreateFixedPointParser(int scale) {
+  return make_unique<RegexCurrencyRateParser>(scale);
+}
+
+unique_ptr<ICurrencyRateParser> CurrencyRateParserFactory::DetectParser(
+    string_view sample, int fixed_scale) {
+  using Factory = std::function<unique_ptr<ICurrencyRateParser>()>;
+  // The default format comes first so that it wins ties.
+  const Factory kCandidates[] = {
+      [=] { return make_unique<RegexCurrencyRateParser>(fixed_scale); },
+      [=] {
+        return make_unique<DelimitedCurrencyRateParser<SpaceIsoDialect>>(
+            fixed_scale);
+      },
+      [=] {
+        return make_unique<DelimitedCurrencyRateParser<CsvDialect>>(
+            fixed_scale);
+      },
+      [=] {
+        return make_unique<DelimitedCurrencyRateParser<CsvIsoDialect>>(
+            fixed_scale);
+      },
+      [=] {
+        return make_unique<DelimitedCurrencyRateParser<SemicolonDialect>>(
+            fixed_scale);
+      },
+      [=] {
+        return make_unique<DelimitedCurrencyRateParser<SemicolonIsoDialect>>(
+            fixed_scale);
+      },
+      [=] {
+        return make_unique<
+            DelimitedCurrencyRateParser<SemicolonCommaDialect>>(fixed_scale);
+      },
+      [=] {
+        return make_unique<
+            DelimitedCurrencyRateParser<SemicolonCommaIsoDialect>>(
+            fixed_scale);
+      },
+  };
+
+  vector<string_view> views;
+  size_t consumed = ICurrencyRateParser::SplitLines(sample, &views);
+  if (consumed < sample.size()) {
+    views.push_back(sample.substr(consumed));
+  }
+  vector<string> lines(views.begin(), views.end());
+
+  unique_ptr<ICurrencyRateParser> best;
+  size_t best_matches = 0;
+  for (const auto& create : kCandidates) {
+    unique_ptr<ICurrencyRateParser> parser = create();
+    size_t matches = 0;
+    for (const auto& line : lines) {
+      if (parser->CanParse(line)) {
+        ++matches;
+      }
+    }
+    if (!best || matches > best_matches) {
+      best = std::move(parser);
+      best_matches = matches;
+    }
+  }
+  return best;
+}
+
+unique_ptr<ICurrencyRateParser> CurrencyRateParserFactory::DetectFileParser(
+    const string& filename, int fixed_scale) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + filename);
+  }
+
+  string sample(kSniffSize, '\0');
+  file.read(&sample[0], static_cast<std::streamsize>(sample.size()));
+  sample.resize(static_cast<size_t>(file.gcount()));
+
+  // A line cut off by the sample size is not representative.
+  if (sample.size() == kSniffSize) {
+    size_t last_newline = sample.rfind('\n');
+    if (last_newline != string::npos) {
+      sample.resize(last_newline + 1);
+    }
+  }
+  return DetectParser(sample, fixed_scale);
+}
@@ -0,0 +1,271 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_quantiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "currency_date.h"
+#include "currency_rate_validator.h"
+
+using std::invalid_argument;
+using std::map;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::pair;
+using std::vector;
+
+namespace {
+
+// Smallest supported k; below it the lower levels degenerate to the
+// minimum capacity of two.
+constexpr size_t kMinK = 8;
+// Capacity ratio between a level and the one above it.
+constexpr double kLevelRatio = 2.0 / 3.0;
+
+// Retained values with their weights, sorted by value.
+vector<pair<double, uint64_t>> WeightedValues(
+    const vector<vector<double>>& levels) {
+  vector<pair<double, uint64_t>> values;
+  for (size_t level = 0; level < levels.size(); ++level) {
+    uint64_t weight = uint64_t{1} << level;
+    for (double value : levels[level]) {
+      values.emplace_back(value, weight);
+    }
+  }
+  std::sort(values.begin(), values.end());
+  return values;
+}
+
+double ValueAt(const vector<pair<double, uint64_t>>& values, uint64_t total,
+               double fraction, double min, double max) {
+  if (values.empty()) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  if (!(fraction > 0.0)) {
+    return min;
+  }
+  if (fraction >= 1.0) {
+    return max;
+  }
+
+  double target = fraction * static_cast<double>(total);
+  uint64_t cumulative = 0;
+  for (const auto& value : values) {
+    cumulative += value.second;
+    if (static_cast<double>(cumulative) > target) {
+      return value.first;
+    }
+  }
+  return max;
+}
+
+}  // namespace
+
+KllSketch::KllSketch(size_t k) : k_(k) {
+  if (k_ < kMinK) {
+    throw invalid_argument("Quantile sketch k must be at least 8");
+  }
+}
+
+void KllSketch::Update(double value) {
+  if (count_ == 0) {
+    min_ = value;
+    max_ = value;
+  } else {
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+  ++count_;
+
+  if (levels_.empty()) {
+    AddLevel();
+  }
+  levels_[0].push_back(value);
+  if (++retained_ >= capacity_) {
+    Compress();
+  }
+}
+
+void KllSketch::Merge(const KllSketch& other) {
+  if (other.k_ != k_) {
+    throw invalid_argument("Cannot merge quantile sketches of different k");
+  }
+  if (other.count_ == 0) {
+    return;
+  }
+  if (count_ == 0) {
+    min_ = other.min_;
+    max_ = other.max_;
+  } else {
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+  count_ += other.count_;
+
+  while (levels_.size() < other.levels_.size()) {
+    AddLevel();
+  }
+  for (size_t level = 0; level < other.levels_.size(); ++level) {
+    levels_[level].insert(levels_[level].end(), other.levels_[level].begin(),
+                          other.levels_[level].end());
+  }
+  retained_ += other.retained_;
+  while (retained_ >= capacity_) {
+    Compress();
+  }
+}
+
+double KllSketch::Quantile(double fraction) const {
+  return ValueAt(WeightedValues(levels_), count_, fraction, min_, max_);
+}
+
+vector<double> KllSketch::Quantiles(const vector<double>& fractions) const {
+  vector<pair<double, uint64_t>> values = WeightedValues(levels_);
+  vector<double> result;
+  result.reserve(fractions.size());
+  for (double fraction : fractions) {
+    result.push_back(ValueAt(values, count_, fraction, min_, max_));
+  }
+  return result;
+}
+
+size_t KllSketch::HeapBytes() const {
+  size_t bytes = levels_.capacity() * sizeof(vector<double>);
+  for (const auto& level : levels_) {
+    bytes += level.capacity() * sizeof(double);
+  }
+  bytes += capacities_.capacity() * sizeof(size_t);
+  return bytes;
+}
+
+void KllSketch::AddLevel() {
+  levels_.emplace_back();
+  capacities_.resize(levels_.size());
+  capacity_ = 0;
+  // The top level holds k values, each level below two thirds of the one
+  // above.
+  double capacity = static_cast<double>(k_);
+  for (size_t level = levels_.size(); level-- > 0;) {
+    capacities_[level] =
+        std::max<size_t>(2, static_cast<size_t>(std::ceil(capacity)));
+    capacity_ += capacities_[level];
+    capacity *= kLevelRatio;
+  }
+}
+
+// Compacts the levels at or over their capacity, bottom up, so values
+// pushed into a level are compacted along with it in the same pass. A
+// single pass suffices after Update(); after Merge() it may take several.
+void KllSketch::Compress() {
+  for (size_t level = 0; level < levels_.size(); ++level) {
+    if (levels_[level].size() >= capacities_[level]) {
+      CompactLevel(level);
+    }
+  }
+}
+
+// Halves |level| into the one above. An odd item out stays behind so the
+// total weight is preserved exactly.
+void KllSketch::CompactLevel(size_t level) {
+  if (level + 1 == levels_.size()) {
+    AddLevel();
+  }
+
+  vector<double>& items = levels_[level];
+  std::sort(items.begin(), items.end());
+  size_t kept = items.size() % 2;
+  size_t offset = NextBit() ? 1 : 0;
+  vector<double>& above = levels_[level + 1];
+  size_t moved = 0;
+  for (size_t i = kept + offset; i < items.size(); i += 2, ++moved) {
+    above.push_back(items[i]);
+  }
+  retained_ -= items.size() - kept - moved;
+  items.resize(kept);
+}
+
+bool KllSketch::NextBit() {
+  random_ ^= random_ << 13;
+  random_ ^= random_ >> 7;
+  random_ ^= random_ << 17;
+  return (random_ >> 32) & 1;
+}
+
+QuantileSketchTracker::QuantileSketchTracker(AggregationBucket bucket,
+                                             size_t k)
+    : bucket_(bucket), k_(k) {
+  if (k_ < kMinK) {
+    throw invalid_argument("Quantile sketch k must be at least 8");
+  }
+}
+
+void QuantileSketchTracker::Add(const CurrencyRate& rate) {
+  CurrencyPair pair(rate.currency1(), rate.currency2());
+  auto it = series_.find(pair);
+  if (it == series_.end()) {
+    it = series_.emplace(move(pair), Series{KllSketch(k_), {}}).first;
+  }
+  int start = CurrencyRateAggregator::BucketStart(
+      CurrencyDate::ToDayNumber(rate.date()), bucket_);
+  it->second.buckets.try_emplace(start, k_).first->second.Update(rate.rate());
+  it->second.all.Update(rate.rate());
+}
+
+void QuantileSketchTracker::Clear() {
+  series_.clear();
+}
+
+optional<KllSketch> QuantileSketchTracker::Get(const CurrencyPair& pair,
+                                               const DateRange& range) const {
+  auto it = series_.find(pair);
+  if (it == series_.end()) {
+    return nullopt;
+  }
+  if (range.from.empty() && range.to.empty()) {
+    return it->second.all;
+  }
+  const map<int, KllSketch>& buckets = it->second.buckets;
+
+  int first = std::numeric_limits<int>::min();
+  if (!range.from.empty()) {
+    CurrencyRateValidator::ValidateDate(range.from);
+    first = CurrencyRateAggregator::BucketStart(
+        CurrencyDate::ToDayNumber(range.from), bucket_);
+  }
+  int last = std::numeric_limits<int>::max();
+  if (!range.to.empty()) {
+    CurrencyRateValidator::ValidateDate(range.to);
+    last = CurrencyDate::ToDayNumber(range.to);
+  }
+
+  KllSketch merged(k_);
+  for (auto bucket = buckets.lower_bound(first);
+       bucket != buckets.end() && bucket->first <= last; ++bucket) {
+    merged.Merge(bucket->second);
+  }
+  if (merged.empty()) {
+    return nullopt;
+  }
+  return merged;
+}
+
+void QuantileSketchTracker::AccountMemory(MemoryUsageReport* usage) const {
+  size_t bytes = MemoryAccounting::HashNodes(series_);
+  for (const auto& entry : series_) {
+    bytes += MemoryAccounting::StringHeap(entry.first.currency1) +
+             MemoryAccounting::StringHeap(entry.first.currency2) +
+             entry.second.all.HeapBytes() +
+             MemoryAccounting::TreeNodes(entry.second.buckets);
+    for (const auto& bucket : entry.second.buckets) {
+      bytes += bucket.second.HeapBytes();
+    }
+  }
+  usage->caches += bytes;
+}
@@ -0,0 +1,172 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_query.h"
+
+#include <algorithm>
+
+using std::make_shared;
+using std::vector;
+
+namespace {
+
+// Next unread position of one date bucket during a storage-order merge.
+struct BucketHead {
+  size_t position;
+  const vector<size_t>* bucket;
+  size_t next;
+
+  // Inverted, so that the standard max-heap yields the lowest position.
+  bool operator<(const BucketHead& other) const {
+    return position > other.position;
+  }
+};
+
+}  // namespace
+
+struct RateQueryRange::Cursor {
+  explicit Cursor(const RateQueryRange& source) : range(source) {}
+
+  RateQueryRange range;
+  // Next index into the position list, the records or the date bucket.
+  size_t next = 0;
+  DateBuckets::const_iterator date;
+  // Buckets still being merged, when merging.
+  vector<BucketHead> heads;
+  size_t position = 0;
+  size_t skipped = 0;
+  size_t produced = 0;
+  const CurrencyRate* current = nullptr;
+};
+
+const CurrencyRate& RateQueryRange::iterator::operator*() const {
+  return *cursor_->current;
+}
+
+RateQueryRange::iterator& RateQueryRange::iterator::operator++() {
+  cursor_->range.Advance(cursor_.get());
+  return *this;
+}
+
+RateQueryRange::iterator RateQueryRange::iterator::operator++(int) {
+  iterator previous = *this;
+  ++*this;
+  return previous;
+}
+
+const CurrencyRate* RateQueryRange::iterator::Current() const {
+  return cursor_ ? cursor_->current : nullptr;
+}
+
+RateQueryRange::iterator RateQueryRange::begin() const {
+  auto cursor = make_shared<Cursor>(*this);
+  cursor->date = descending_ ? date_last_ : date_first_;
+  if (merge_dates_) {
+    for (auto date = date_first_; date != date_last_; ++date) {
+      if (!date->second.empty()) {
+        cursor->heads.push_back({date->second.front(), &date->second, 1});
+      }
+    }
+    std::make_heap(cursor->heads.begin(), cursor->heads.end());
+  }
+  // Without a filter every candidate counts, so a list can be entered
+  // at the offset directly.
+  if (!filter_ && dates_ == nullptr) {
+    cursor->next = offset_;
+    cursor->skipped = offset_;
+  }
+  Advance(cursor.get());
+  return iterator(cursor);
+}
+
+RateQueryRange RateQueryRange::Page(size_t offset, size_t limit) const {
+  RateQueryRange page = *this;
+  page.offset_ = offset_ + std::min(offset, limit_);
+  if (limit_ != QueryOptions::kUnlimited) {
+    page.limit_ = std::min(limit, limit_ - std::min(offset, limit_));
+  } else {
+    page.limit_ = limit;
+  }
+  return page;
+}
+
+vector<CurrencyRate> RateQueryRange::ToVector() const {
+  vector<CurrencyRate> result;
+  for (const auto& rate : *this) {
+    result.push_back(rate);
+  }
+  return result;
+}
+
+bool RateQueryRange::NextPosition(Cursor* cursor) const {
+  if (dates_ == nullptr) {
+    size_t size = positions_ != nullptr ? positions_->size() : rates_->size();
+    if (cursor->next >= size) {
+      return false;
+    }
+    cursor->position = positions_ != nullptr ? (*positions_)[cursor->next]
+                                             : cursor->next;
+    ++cursor->next;
+    return true;
+  }
+
+  if (merge_dates_) {
+    vector<BucketHead>& heads = cursor->heads;
+    if (heads.empty()) {
+      return false;
+    }
+    std::pop_heap(heads.begin(), heads.end());
+    BucketHead& head = heads.back();
+    cursor->position = head.position;
+    if (head.next < head.bucket->size()) {
+      head.position = (*head.bucket)[head.next++];
+      std::push_heap(heads.begin(), heads.end());
+    } else {
+      heads.pop_back();
+    }
+    return true;
+  }
+
+  if (!descending_) {
+    for (; cursor->date != date_last_; ++cursor->date, cursor->next = 0) {
+      const vector<size_t>& bucket = cursor->date->second;
+      if (cursor->next < bucket.size()) {
+        cursor->position = bucket[cursor->next++];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Walking back, |date| is one past the bucket being read.
+  for (; cursor->date != date_first_; --cursor->date, cursor->next = 0) {
+    const vector<size_t>& bucket = std::prev(cursor->date)->second;
+    if (cursor->next < bucket.size()) {
+      cursor->position = bucket[bucket.size() - 1 - cursor->next++];
+      return true;
+    }
+  }
+  return false;
+}
+
+void RateQueryRange::Advance(Cursor* cursor) const {
+  cursor->current = nullptr;
+  if (cursor->produced >= limit_) {
+    return;
+  }
+
+  while (NextPosition(cursor)) {
+    const CurrencyRate& rate = (*rates_)[cursor->position];
+    if (filter_ && !filter_->Matches(rate)) {
+      continue;
+    }
+    if (cursor->skipped < offset_) {
+      ++cursor->skipped;
+      continue;
+    }
+    ++cursor->produced;
+    cursor->current = &rate;
+    return;
+  }
+}
@@ -6,8 +6,17 @@
 
 #include <algorithm>
 #include <cctype>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+
+#include "currency_rate_metrics.h"
+#include "currency_rate_trace.h"
+#include "fixed_rate.h"
+#include "parallel_executor.h"
 
 using std::cerr;
 using std::cout;
@@ -16,21 +25,167 @@ using std::function;
 using std::getline;
 using std::ifstream;
 using std::ios;
+using std::istream;
+using std::make_shared;
 using std::make_unique;
 using std::move;
+using std::nullopt;
+using std::optional;
 using std::ofstream;
+using std::ostream;
 using std::runtime_error;
+using std::shared_ptr;
 using std::sort;
 using std::string;
 using std::unique_ptr;
 using std::vector;
 
+namespace {
+
+// Bytes of the file start used to recognize a rotated file.
+constexpr uint64_t kHeadFingerprintSize = 256;
+
+// FNV-1a hash of the first |length| bytes of |file|. Returns 0 when the
+// file is shorter than |length|, which never matches a stored fingerprint
+// of a non-empty head.
+uint64_t HashHead(ifstream& file, uint64_t length) {
+  uint64_t hash = 14695981039346656037ULL;
+  if (length == 0) {
+    return hash;
+  }
+
+  string head(static_cast<size_t>(length), '\0');
+  file.clear();
+  file.seekg(0);
+  if (!file.read(&head[0], static_cast<std::streamsize>(length))) {
+    return 0;
+  }
+
+  for (unsigned char c : head) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Files parsed ahead of the merge per worker thread in AddFromFiles().
+constexpr size_t kFilesPerThreadInWindow = 4;
+
+// Shell-style match of |name| against |pattern| with '*' and '?'.
+bool MatchesGlob(const string& name, const string& pattern) {
+  size_t n = 0;
+  size_t p = 0;
+  size_t star = string::npos;
+  size_t star_match = 0;
+
+  while (n < name.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+      ++n;
+      ++p;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      star_match = n;
+    } else if (star != string::npos) {
+      p = star + 1;
+      n = ++star_match;
+    } else {
+      return false;
+    }
+  }
+
+  while (p < pattern.size() && pattern[p] == '*') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+void AccountString(const string& text, MemoryUsageReport* usage) {
+  usage->string_heap += MemoryAccounting::StringHeap(text);
+  usage->slack += MemoryAccounting::StringSlack(text);
+}
+
+void FingerprintHead(const string& filename, SourceCheckpoint* checkpoint) {
+  ifstream file(filename, ios::binary);
+  checkpoint->head_size = std::min(checkpoint->offset, kHeadFingerprintSize);
+  checkpoint->head_hash = HashHead(file, checkpoint->head_size);
+}
+
+// Bytes one stored record is expected to add besides its slot in the
+// record array: the heap blocks of its strings, its positions in the
+// currency (twice), pair and date lists and its node in the pair series.
+size_t RecordFootprint(const CurrencyRate& rate) {
+  return MemoryAccounting::StringHeap(rate.currency1()) +
+         MemoryAccounting::StringHeap(rate.currency2()) +
+         MemoryAccounting::StringHeap(rate.date()) + 4 * sizeof(size_t) +
+         sizeof(std::map<string, size_t>::value_type) + 4 * sizeof(void*);
+}
+
+// Whether inverting |inverse| again gives |rate| back at its own scale.
+// Always true for floating-point rates.
+bool InvertsBack(const CurrencyRate& rate, const CurrencyRate& inverse) {
+  if (!rate.fixed_rate() || !inverse.fixed_rate()) {
+    return true;
+  }
+  const FixedRate& original = *rate.fixed_rate();
+  FixedRate back = inverse.fixed_rate()->Inverse();
+  return FixedRate::FromDouble(back.ToDouble(), original.scale()) == original;
+}
+
+}  // namespace
+
 MemoryCurrencyRateRepository::MemoryCurrencyRateRepository(
     unique_ptr<ICurrencyRateParser> parser)
     : parser_(move(parser)) {}
 
 void MemoryCurrencyRateRepository::Add(const CurrencyRate& rate) {
+  Insert(rate);
+}
+
+void MemoryCurrencyRateRepository::Insert(const CurrencyRate& rate) {
+  if (canonical_pairs_ && rate.currency1() > rate.currency2()) {
+    optional<CurrencyRate> inverse;
+    try {
+      inverse = rate.Inverse();
+    } catch (const InvalidRateException&) {
+      // 1/rate is outside the valid range; keep the quote as it came.
+    }
+    // Likewise a fixed-point quote whose inverse loses digits.
+    if (inverse && InvertsBack(rate, *inverse)) {
+      Store(*inverse);
+      return;
+    }
+  }
+
+  Store(rate);
+}
+
+void MemoryCurrencyRateRepository::Store(const CurrencyRate& rate) {
+  if (canonical_pairs_) {
+    // Quotes kept in their own orientation are the same market too.
+    CurrencyPair pair(rate.currency1(), rate.currency2());
+    if (index().FindPairDate(pair, rate.date()) != nullptr ||
+        index().FindPairDate(pair.Inverse(), rate.date()) != nullptr) {
+      ++canonical_duplicates_;
+      return;
+    }
+  }
+
+  if (rates_.size() == rates_.capacity()) {
+    CURRENCY_RATE_TRACE_SPAN("GrowStorage");
+    ReserveRecords(std::max<size_t>(rates_.capacity() * 2, 16));
+  }
   rates_.push_back(rate);
+  ++generation_;
+  estimated_usage_ += RecordFootprint(rates_.back());
+
+  index_.Add(rates_.back(), rates_.size() - 1);
+
+  if (rolling_stats_) {
+    rolling_stats_->Add(rate);
+  }
+  if (quantile_sketches_) {
+    quantile_sketches_->Add(rate);
+  }
 }
 
 vector<CurrencyRate> MemoryCurrencyRateRepository::GetAll() const {
@@ -43,6 +198,18 @@ size_t MemoryCurrencyRateRepository::Count() const {
 
 void MemoryCurrencyRateRepository::Clear() {
   rates_.clear();
+  ++generation_;
+  checkpoints_.clear();
+  source_parsers_.clear();
+  index_.Clear();
+
+  if (rolling_stats_) {
+    rolling_stats_->Clear();
+  }
+  if (quantile_sketches_) {
+    quantile_sketches_->Clear();
+  }
+  RemeasureMemory();
 }
 
 void MemoryCurrencyRateRepository::SortByDate() {
@@ -60,24 +227,493 @@ void MemoryCurrencyRateRepository::SortByCurrency() {
   });
 }
 
+vector<CurrencyRate> MemoryCurrencyRateRepository::FilterByCurrency(
+    const string& currency) const {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_filter_seconds",
+                           "Time to evaluate one filter or query.");
+  const vector<size_t>* positions = index().FindCurrency(currency);
+  if (positions == nullptr) {
+    return {};
+  }
+
+  // A rate quoted against itself is rejected on construction, so every
+  // position appears at most once in the currency index.
+  return Collect(*positions);
+}
+
+vector<CurrencyRate> MemoryCurrencyRateRepository::FilterByDate(
+    const string& date) const {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_filter_seconds",
+                           "Time to evaluate one filter or query.");
+  const vector<size_t>* positions = index().FindDate(date);
+  return positions == nullptr ? vector<CurrencyRate>() : Collect(*positions);
+}
+
+vector<CurrencyRate> MemoryCurrencyRateRepository::Query(
+    const FilterExpression& expression) const {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_filter_seconds",
+                           "Time to evaluate one filter or query.");
+  CURRENCY_RATE_TRACE_SPAN("Query");
+  CompiledFilter filter(expression);
+  const FilterIndexHint& hint = filter.index_hint();
+  vector<size_t> selection;
+
+  if (canonical_pairs_ && hint.kind == FilterIndexHint::Kind::kPairs) {
+    return QueryCanonicalPairs(filter);
+  }
+
+  switch (hint.kind) {
+    case FilterIndexHint::Kind::kPairs:
+      for (const auto& pair : hint.pairs) {
+        if (const auto* positions = index().FindPair(pair)) {
+          selection.insert(selection.end(), positions->begin(),
+                           positions->end());
+        }
+      }
+      std::sort(selection.begin(), selection.end());
+      selection.erase(std::unique(selection.begin(), selection.end()),
+                      selection.end());
+      break;
+    case FilterIndexHint::Kind::kCurrency:
+      if (const auto* positions = index().FindCurrency(hint.currency)) {
+        selection = *positions;
+      }
+      break;
+    case FilterIndexHint::Kind::kDateRange:
+      selection = index().FindDateRange(hint.date_from, hint.date_to);
+      break;
+    case FilterIndexHint::Kind::kNone:
+      selection.resize(rates_.size());
+      for (size_t i = 0; i < selection.size(); ++i) {
+        selection[i] = i;
+      }
+      break;
+  }
+
+  filter.Apply(rates_, &selection);
+  return Collect(selection);
+}
+
+RateQueryRange MemoryCurrencyRateRepository::QueryRange(
+    const FilterExpression& expression, const QueryOptions& options) const {
+  auto filter = make_shared<const CompiledFilter>(expression);
+  const FilterIndexHint& hint = filter->index_hint();
+  RateQueryRange range;
+  range.rates_ = &rates_;
+  range.offset_ = options.offset;
+  range.limit_ = options.limit;
+  if (!expression.conditions().empty()) {
+    range.filter_ = filter;
+  }
+
+  if (canonical_pairs_ && hint.kind == FilterIndexHint::Kind::kPairs) {
+    // Inverted quotes exist only in the result, so it is built in full.
+    auto result = make_shared<vector<CurrencyRate>>(
+        QueryCanonicalPairs(*filter));
+    if (options.order != QueryOrder::kStorage) {
+      std::stable_sort(result->begin(), result->end(),
+                       [](const CurrencyRate& a, const CurrencyRate& b) {
+                         return a.date() < b.date();
+                       });
+      if (options.order == QueryOrder::kDateDescending) {
+        std::reverse(result->begin(), result->end());
+      }
+    }
+    range.owned_rates_ = result;
+    range.rates_ = result.get();
+    range.filter_.reset();
+    return range;
+  }
+
+  // Date orders walk the dates; a date range in storage order merges the
+  // position lists of its dates.
+  bool date_range = hint.kind == FilterIndexHint::Kind::kDateRange;
+  if (options.order != QueryOrder::kStorage || date_range) {
+    const auto& dates = index().dates();
+    range.dates_ = &dates;
+    range.descending_ = options.order == QueryOrder::kDateDescending;
+    range.merge_dates_ = options.order == QueryOrder::kStorage;
+    range.date_first_ = dates.begin();
+    range.date_last_ = dates.end();
+    if (date_range) {
+      if (!hint.date_from.empty()) {
+        range.date_first_ = dates.lower_bound(hint.date_from);
+      }
+      if (!hint.date_to.empty()) {
+        range.date_last_ = dates.upper_bound(hint.date_to);
+      }
+      if (!hint.date_from.empty() && !hint.date_to.empty() &&
+          hint.date_from > hint.date_to) {
+        range.date_last_ = range.date_first_;
+      }
+    }
+    return range;
+  }
+
+  static const vector<size_t> kNoPositions;
+  switch (hint.kind) {
+    case FilterIndexHint::Kind::kPairs:
+      if (hint.pairs.size() == 1) {
+        const auto* positions = index().FindPair(hint.pairs[0]);
+        range.positions_ = positions != nullptr ? positions : &kNoPositions;
+      } else {
+        auto merged = make_shared<vector<size_t>>();
+        for (const auto& pair : hint.pairs) {
+          if (const auto* positions = index().FindPair(pair)) {
+            merged->insert(merged->end(), positions->begin(),
+                           positions->end());
+          }
+        }
+        std::sort(merged->begin(), merged->end());
+        merged->erase(std::unique(merged->begin(), merged->end()),
+                      merged->end());
+        range.owned_positions_ = merged;
+        range.positions_ = merged.get();
+      }
+      break;
+    case FilterIndexHint::Kind::kCurrency: {
+      const auto* positions = index().FindCurrency(hint.currency);
+      range.positions_ = positions != nullptr ? positions : &kNoPositions;
+      break;
+    }
+    case FilterIndexHint::Kind::kDateRange:
+    case FilterIndexHint::Kind::kNone:
+      break;
+  }
+  return range;
+}
+
+RateQueryRange MemoryCurrencyRateRepository::Latest(
+    const FilterExpression& expression, size_t count) const {
+  QueryOptions options;
+  options.limit = count;
+  options.order = QueryOrder::kDateDescending;
+  return QueryRange(expression, options);
+}
+
+vector<CurrencyRate> MemoryCurrencyRateRepository::QueryCanonicalPairs(
+    const CompiledFilter& filter) const {
+  vector<CurrencyRate> candidates;
+
+  for (const auto& pair : filter.index_hint().pairs) {
+    vector<size_t> direct;
+    if (const auto* positions = index().FindPair(pair)) {
+      direct = *positions;
+    }
+    vector<size_t> inverse;
+    if (const auto* positions = index().FindPair(pair.Inverse())) {
+      inverse = *positions;
+    }
+
+    vector<size_t> merged;
+    std::merge(direct.begin(), direct.end(), inverse.begin(), inverse.end(),
+               std::back_inserter(merged));
+    for (size_t position : merged) {
+      const CurrencyRate& rate = rates_[position];
+      if (rate.currency1() == pair.currency1) {
+        candidates.push_back(rate);
+        continue;
+      }
+      try {
+        candidates.push_back(rate.Inverse());
+      } catch (const InvalidRateException&) {
+        // Not representable in the requested orientation.
+      }
+    }
+  }
+
+  vector<size_t> selection(candidates.size());
+  for (size_t i = 0; i < selection.size(); ++i) {
+    selection[i] = i;
+  }
+  filter.Apply(candidates, &selection);
+
+  vector<CurrencyRate> result;
+  result.reserve(selection.size());
+  for (size_t position : selection) {
+    result.push_back(candidates[position]);
+  }
+  return result;
+}
+
+void MemoryCurrencyRateRepository::SetCanonicalPairs(bool enabled) {
+  if (enabled == canonical_pairs_) {
+    return;
+  }
+
+  canonical_pairs_ = enabled;
+  if (!enabled) {
+    return;
+  }
+
+  vector<CurrencyRate> existing;
+  existing.swap(rates_);
+  ++generation_;
+  index_.Clear();
+  if (rolling_stats_) {
+    rolling_stats_->Clear();
+  }
+  if (quantile_sketches_) {
+    quantile_sketches_->Clear();
+  }
+
+  for (const auto& rate : existing) {
+    Insert(rate);
+  }
+  existing = vector<CurrencyRate>();
+  RemeasureMemory();
+}
+
+optional<double> MemoryCurrencyRateRepository::GetRate(
+    const string& from, const string& to, const string& date,
+    bool* inverted) const {
+  CurrencyPair pair(from, to);
+
+  if (const size_t* position = index().FindPairDate(pair, date)) {
+    if (inverted != nullptr) {
+      *inverted = false;
+    }
+    return rates_[*position].rate();
+  }
+  if (const size_t* position = index().FindPairDate(pair.Inverse(), date)) {
+    if (inverted != nullptr) {
+      *inverted = true;
+    }
+    return 1.0 / rates_[*position].rate();
+  }
+  return nullopt;
+}
+
+optional<CurrencyRate> MemoryCurrencyRateRepository::GetRateAsOf(
+    const string& from, const string& to, const string& date) const {
+  CurrencyPair pair(from, to);
+  const size_t* direct = index().FindPairAsOf(pair, date);
+  const size_t* inverse = index().FindPairAsOf(pair.Inverse(), date);
+
+  if (inverse != nullptr &&
+      (direct == nullptr ||
+       rates_[*inverse].date() > rates_[*direct].date())) {
+    try {
+      return rates_[*inverse].Inverse();
+    } catch (const InvalidRateException&) {
+      // Fall back to the direct series.
+    }
+  }
+  if (direct != nullptr) {
+    return rates_[*direct];
+  }
+  return nullopt;
+}
+
+vector<CurrencyRate> MemoryCurrencyRateRepository::GetRange(
+    const string& from, const string& to, const DateRange& range) const {
+  CurrencyPair pair(from, to);
+  vector<CurrencyRate> result =
+      Collect(index().FindPairDateRange(pair, range.from, range.to));
+
+  for (size_t position : index().FindPairDateRange(pair.Inverse(), range.from,
+                                                   range.to)) {
+    try {
+      result.push_back(rates_[position].Inverse());
+    } catch (const InvalidRateException&) {
+      // Not representable in the requested orientation.
+    }
+  }
+
+  std::stable_sort(result.begin(), result.end(),
+                   [](const CurrencyRate& a, const CurrencyRate& b) {
+                     return a.date() < b.date();
+                   });
+  return result;
+}
+
+vector<CurrencyRate> MemoryCurrencyRateRepository::Collect(
+    const vector<size_t>& positions) const {
+  vector<CurrencyRate> result;
+  result.reserve(positions.size());
+  for (size_t position : positions) {
+    result.push_back(rates_[position]);
+  }
+  return result;
+}
+
 void MemoryCurrencyRateRepository::Sort(
     const function<bool(const CurrencyRate&, const CurrencyRate&)>& comparator) {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_sort_seconds",
+                           "Time to sort a repository.");
+  CURRENCY_RATE_TRACE_SPAN("Sort");
   std::sort(rates_.begin(), rates_.end(), comparator);
+  ++generation_;
+  // Rebuilt at once rather than on the next lookup, so that const
+  // queries never write the index and can run concurrently.
+  index_.Rebuild(rates_);
 }
 
 void MemoryCurrencyRateRepository::AddFromFile(const string& filename) {
-  ifstream file(filename);
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_load_file_seconds",
+                           "Time to load one rate file with AddFromFile.");
+  CURRENCY_RATE_TRACE_SPAN("AddFromFile", filename);
+  ifstream file(filename, ios::binary);
 
   if (!file.is_open()) {
     throw runtime_error("Failed to open file: " + filename);
   }
 
+  shared_ptr<ICurrencyRateParser> detected = DetectParser(filename);
+  SourceCheckpoint checkpoint;
+  size_t successfully_parsed = LoadLines(
+      detected ? *detected : *parser_, file, true, &checkpoint, cerr,
+      [this](const CurrencyRate& rate) { Insert(rate); });
+  file.close();
+
+  if (successfully_parsed == 0 && checkpoint.line_number > 0) {
+    cerr << "Warning: no lines were successfully parsed!" << endl;
+  }
+
+  FingerprintHead(filename, &checkpoint);
+  checkpoints_[filename] = checkpoint;
+  if (detected) {
+    source_parsers_[filename] = detected;
+  }
+  ApplyMemoryBudget();
+}
+
+vector<FileLoadStats> MemoryCurrencyRateRepository::AddFromFiles(
+    const vector<string>& filenames, size_t max_in_flight) {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_load_files_seconds",
+                           "Time to load a set of files with AddFromFiles.");
+  CURRENCY_RATE_TRACE_SPAN("AddFromFiles");
+  struct ParsedFile {
+    vector<CurrencyRate> rates;
+    SourceCheckpoint checkpoint;
+    shared_ptr<ICurrencyRateParser> parser;
+    string log;
+  };
+
+  size_t thread_count = max_in_flight == 0
+                            ? ParallelExecutor::DefaultThreadCount()
+                            : max_in_flight;
+  // Files are parsed in windows so that at most a few files per thread
+  // are held in memory before being merged in input order.
+  size_t window = thread_count * kFilesPerThreadInWindow;
+
+  vector<FileLoadStats> stats(filenames.size());
+  vector<ParsedFile> parsed;
+
+  for (size_t start = 0; start < filenames.size(); start += window) {
+    size_t count = std::min(window, filenames.size() - start);
+    parsed.assign(count, ParsedFile());
+
+    ParallelExecutor::For(count, thread_count, [&](size_t i) {
+      const string& filename = filenames[start + i];
+      CURRENCY_RATE_TRACE_SPAN("LoadFile", filename);
+      FileLoadStats& file_stats = stats[start + i];
+      ParsedFile& result = parsed[i];
+      file_stats.filename = filename;
+
+      ifstream file(filename, ios::binary);
+      if (!file.is_open()) {
+        file_stats.error = "Failed to open file: " + filename;
+        return;
+      }
+
+      result.parser = DetectParser(filename);
+      std::ostringstream log;
+      file_stats.records = LoadLines(
+          result.parser ? *result.parser : *parser_, file, true,
+          &result.checkpoint, log,
+          [&result](const CurrencyRate& rate) {
+            result.rates.push_back(rate);
+          },
+          &file_stats.rejected);
+      file.close();
+
+      file_stats.lines = result.checkpoint.line_number;
+      file_stats.bytes = result.checkpoint.offset;
+      FingerprintHead(filename, &result.checkpoint);
+      result.log = log.str();
+    });
+
+    CURRENCY_RATE_TRACE_SPAN("MergeFiles");
+    // One reservation for the whole window, still growing geometrically
+    // so that a run of windows does not reallocate on each.
+    size_t incoming = 0;
+    for (size_t i = 0; i < count; ++i) {
+      incoming += parsed[i].rates.size();
+    }
+    if (rates_.size() + incoming > rates_.capacity()) {
+      ReserveRecords(
+          std::max(rates_.size() + incoming, rates_.capacity() * 2));
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+      const FileLoadStats& file_stats = stats[start + i];
+      if (!file_stats.error.empty()) {
+        continue;
+      }
+
+      ParsedFile& result = parsed[i];
+      cerr << result.log;
+      if (file_stats.records == 0 && file_stats.lines > 0) {
+        cerr << "Warning: no lines were successfully parsed in "
+             << file_stats.filename << endl;
+      }
+
+      for (const auto& rate : result.rates) {
+        Insert(rate);
+      }
+      checkpoints_[file_stats.filename] = result.checkpoint;
+      if (result.parser) {
+        source_parsers_[file_stats.filename] = result.parser;
+      }
+    }
+  }
+
+  ApplyMemoryBudget();
+  return stats;
+}
+
+vector<FileLoadStats> MemoryCurrencyRateRepository::AddFromDirectory(
+    const string& directory, const string& pattern, size_t max_in_flight) {
+  std::error_code error;
+  std::filesystem::directory_iterator it(directory, error);
+  if (error) {
+    throw runtime_error("Failed to read directory: " + directory);
+  }
+
+  vector<string> filenames;
+  for (; it != std::filesystem::directory_iterator(); it.increment(error)) {
+    if (error) {
+      throw runtime_error("Failed to read directory: " + directory);
+    }
+    if (it->is_regular_file(error) &&
+        MatchesGlob(it->path().filename().string(), pattern)) {
+      filenames.push_back(it->path().string());
+    }
+  }
+  sort(filenames.begin(), filenames.end());
+
+  return AddFromFiles(filenames, max_in_flight);
+}
+
+size_t MemoryCurrencyRateRepository::LoadLines(
+    const ICurrencyRateParser& parser, istream& input,
+    bool consume_unterminated, SourceCheckpoint* checkpoint, ostream& log,
+    const function<void(const CurrencyRate&)>& sink, size_t* rejected) const {
   string line;
-  int line_number = 0;
-  int successfully_parsed = 0;
+  size_t successfully_parsed = 0;
+  size_t failed = 0;
+  uint64_t first_line = checkpoint->line_number;
+  uint64_t first_offset = checkpoint->offset;
+
+  while (getline(input, line)) {
+    bool terminated = !input.eof();
+    if (!terminated && !consume_unterminated) {
+      break;
+    }
 
-  while (getline(file, line)) {
-    line_number++;
+    checkpoint->offset += line.size() + (terminated ? 1 : 0);
+    uint64_t line_number = ++checkpoint->line_number;
 
     if (line.empty() || std::all_of(line.begin(), line.end(),
         [](unsigned char c) { return std::isspace(c); })) {
@@ -85,32 +721,147 @@ void MemoryCurrencyRateRepository::AddFromFile(const string& filename) {
     }
 
     try {
-      if (parser_->CanParse(line)) {
-        CurrencyRate rate = parser_->Parse(line);
-        rates_.push_back(rate);
+      if (parser.CanParse(line)) {
+        CurrencyRate rate = parser.Parse(line);
+        sink(rate);
         successfully_parsed++;
-      } else {
-        cerr << "Warning: line " << line_number
-             << " has invalid format and will be skipped: "
-             << line << endl;
+        continue;
       }
+      log << "Warning: line " << line_number
+          << " has invalid format and will be skipped: "
+          << line << endl;
+      CURRENCY_RATE_COUNT_REJECTED(nullptr);
     } catch (const CurrencyRateException& e) {
-      cerr << "Error parsing line " << line_number
-           << ": " << e.what() << endl;
+      log << "Error parsing line " << line_number
+          << ": " << e.what() << endl;
+      CURRENCY_RATE_COUNT_REJECTED(&e);
     } catch (const std::exception& e) {
-      cerr << "Unexpected error parsing line " << line_number
-           << ": " << e.what() << endl;
+      log << "Unexpected error parsing line " << line_number
+          << ": " << e.what() << endl;
+      CURRENCY_RATE_COUNT_REJECTED(&e);
     }
+    ++failed;
   }
 
-  file.close();
+  CURRENCY_RATE_COUNT("currency_rate_lines_read_total",
+                      "Lines read from rate files.",
+                      checkpoint->line_number - first_line);
+  CURRENCY_RATE_COUNT("currency_rate_bytes_read_total",
+                      "Bytes read from rate files.",
+                      checkpoint->offset - first_offset);
+  CURRENCY_RATE_COUNT("currency_rate_records_loaded_total",
+                      "Records parsed from rate files.", successfully_parsed);
 
-  if (successfully_parsed == 0 && line_number > 0) {
-    cerr << "Warning: no lines were successfully parsed!" << endl;
+  if (rejected != nullptr) {
+    *rejected += failed;
+  }
+  return successfully_parsed;
+}
+
+RefreshResult MemoryCurrencyRateRepository::Refresh() {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_refresh_seconds",
+                           "Time to read the lines appended to all sources.");
+  CURRENCY_RATE_TRACE_SPAN("Refresh");
+  RefreshResult result;
+
+  for (auto& source : checkpoints_) {
+    const string& filename = source.first;
+    SourceCheckpoint& checkpoint = source.second;
+
+    ifstream file(filename, ios::binary);
+    if (!file.is_open()) {
+      continue;
+    }
+    ++result.files;
+
+    file.seekg(0, ios::end);
+    uint64_t size = static_cast<uint64_t>(file.tellg());
+
+    if (size < checkpoint.offset) {
+      ++result.truncations;
+      checkpoint = SourceCheckpoint();
+    } else if (HashHead(file, checkpoint.head_size) != checkpoint.head_hash) {
+      ++result.rotations;
+      checkpoint = SourceCheckpoint();
+    }
+
+    if (size == checkpoint.offset) {
+      continue;
+    }
+    // A replaced or previously empty file may be in another dialect.
+    if (checkpoint.offset == 0 && format_detection_) {
+      source_parsers_[filename] = DetectParser(filename);
+    }
+
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(checkpoint.offset));
+    uint64_t start_offset = checkpoint.offset;
+    result.records_added += LoadLines(
+        SourceParser(filename), file, false, &checkpoint, cerr,
+        [this](const CurrencyRate& rate) { Insert(rate); });
+    result.bytes_read += checkpoint.offset - start_offset;
+
+    file.close();
+    FingerprintHead(filename, &checkpoint);
+  }
+
+  ApplyMemoryBudget();
+  return result;
+}
+
+StreamStats MemoryCurrencyRateRepository::StreamFile(
+    const string& filename, const RateBatchSink& sink,
+    const StreamOptions& options) const {
+  shared_ptr<ICurrencyRateParser> detected = DetectParser(filename);
+  return CurrencyRateStreamReader::StreamFile(
+      filename, detected ? *detected : *parser_, sink, options);
+}
+
+void MemoryCurrencyRateRepository::SetFormatDetection(bool enabled,
+                                                      int fixed_scale) {
+  format_detection_ = enabled;
+  detection_scale_ = fixed_scale;
+  if (!enabled) {
+    source_parsers_.clear();
+  }
+}
+
+shared_ptr<ICurrencyRateParser> MemoryCurrencyRateRepository::DetectParser(
+    const string& filename) const {
+  if (!format_detection_) {
+    return nullptr;
   }
+  return CurrencyRateParserFactory::DetectFileParser(filename,
+                                                     detection_scale_);
+}
+
+const ICurrencyRateParser& MemoryCurrencyRateRepository::SourceParser(
+    const string& filename) const {
+  auto it = source_parsers_.find(filename);
+  return it != source_parsers_.end() ? *it->second : *parser_;
+}
+
+vector<string> MemoryCurrencyRateRepository::SourceFiles() const {
+  vector<string> files;
+  for (const auto& source : checkpoints_) {
+    files.push_back(source.first);
+  }
+  return files;
+}
+
+optional<SourceCheckpoint> MemoryCurrencyRateRepository::GetCheckpoint(
+    const string& filename) const {
+  auto it = checkpoints_.find(filename);
+  if (it == checkpoints_.end()) {
+    return nullopt;
+  }
+  return it->second;
 }
 
 void MemoryCurrencyRateRepository::SaveToFile(const string& filename) const {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_save_seconds",
+                           "Time to save a repository to a file.");
+  CURRENCY_RATE_TRACE_SPAN("SaveToFile", filename);
   ofstream file(filename);
 
   if (!file.is_open()) {
@@ -126,6 +877,9 @@ void MemoryCurrencyRateRepository::SaveToFile(const string& filename) const {
 
 void MemoryCurrencyRateRepository::AppendToFile(const string& filename,
                                                 const CurrencyRate& rate) const {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_append_seconds",
+                           "Time to append one record to a file.");
+  CURRENCY_RATE_TRACE_SPAN("AppendToFile", filename);
   ofstream file(filename, ios::app);
 
   if (!file.is_open()) {
@@ -134,4 +888,178 @@ void MemoryCurrencyRateRepository::AppendToFile(const string& filename,
 
   file << rate.ToFileString() << endl;
   file.close();
-}
\ No newline at end of file
+}
+
+vector<RateAggregate> MemoryCurrencyRateRepository::Aggregate(
+    const PairFilter& pair_filter, const DateRange& date_range,
+    AggregationBucket bucket) const {
+  return CurrencyRateAggregator::Aggregate(rates_, pair_filter, date_range,
+                                           bucket);
+}
+
+RateMatrix MemoryCurrencyRateRepository::Resample(
+    const ResampleOptions& options) const {
+  return CurrencyRateResampler::Resample(rates_, options);
+}
+
+vector<ArbitrageCycle> MemoryCurrencyRateRepository::DetectArbitrage(
+    const ArbitrageOptions& options) const {
+  return ArbitrageDetector::Detect(rates_, options);
+}
+
+void MemoryCurrencyRateRepository::EnableRollingStatistics(
+    const vector<size_t>& windows) {
+  auto tracker = make_unique<RollingStatisticsTracker>(windows);
+  for (const auto& rate : rates_) {
+    tracker->Add(rate);
+  }
+  rolling_stats_ = move(tracker);
+  RemeasureMemory();
+}
+
+void MemoryCurrencyRateRepository::DisableRollingStatistics() {
+  rolling_stats_.reset();
+  RemeasureMemory();
+}
+
+optional<RollingIndicators> MemoryCurrencyRateRepository::GetRollingStatistics(
+    const string& currency1, const string& currency2, size_t window) const {
+  if (!rolling_stats_) {
+    return nullopt;
+  }
+  return rolling_stats_->Get(CurrencyPair(currency1, currency2), window);
+}
+
+void MemoryCurrencyRateRepository::EnableQuantileSketches(
+    AggregationBucket bucket, size_t k) {
+  auto tracker = make_unique<QuantileSketchTracker>(bucket, k);
+  for (const auto& rate : rates_) {
+    tracker->Add(rate);
+  }
+  quantile_sketches_ = move(tracker);
+  RemeasureMemory();
+}
+
+void MemoryCurrencyRateRepository::DisableQuantileSketches() {
+  quantile_sketches_.reset();
+  RemeasureMemory();
+}
+
+optional<KllSketch> MemoryCurrencyRateRepository::GetQuantileSketch(
+    const string& currency1, const string& currency2,
+    const DateRange& range) const {
+  if (!quantile_sketches_) {
+    return nullopt;
+  }
+  return quantile_sketches_->Get(CurrencyPair(currency1, currency2), range);
+}
+
+MemoryUsageReport MemoryCurrencyRateRepository::MemoryUsage() const {
+  MemoryUsageReport usage;
+  usage.records = rates_.size();
+  usage.record_storage = MemoryAccounting::VectorBytes(rates_);
+  usage.slack = MemoryAccounting::VectorSlack(rates_);
+  for (const auto& rate : rates_) {
+    AccountString(rate.currency1(), &usage);
+    AccountString(rate.currency2(), &usage);
+    AccountString(rate.date(), &usage);
+  }
+
+  index_.AccountMemory(&usage);
+
+  usage.caches += MemoryAccounting::TreeNodes(checkpoints_) +
+                  MemoryAccounting::TreeNodes(source_parsers_);
+  for (const auto& source : checkpoints_) {
+    usage.caches += MemoryAccounting::StringHeap(source.first);
+  }
+  for (const auto& source : source_parsers_) {
+    usage.caches += MemoryAccounting::StringHeap(source.first);
+  }
+  if (rolling_stats_) {
+    usage.caches += sizeof(RollingStatisticsTracker);
+    rolling_stats_->AccountMemory(&usage);
+  }
+  if (quantile_sketches_) {
+    usage.caches += sizeof(QuantileSketchTracker);
+    quantile_sketches_->AccountMemory(&usage);
+  }
+  return usage;
+}
+
+void MemoryCurrencyRateRepository::SetMemoryBudget(size_t bytes) {
+  memory_budget_ = bytes;
+  budget_failed_ = false;
+  budget_retry_usage_ = 0;
+  EnforceMemoryBudget();
+}
+
+bool MemoryCurrencyRateRepository::EnforceMemoryBudget() {
+  if (memory_budget_ == 0) {
+    return true;
+  }
+  // Nothing has changed that could make another attempt succeed.
+  if (budget_failed_ && budget_failed_generation_ == generation_) {
+    return false;
+  }
+  CURRENCY_RATE_TRACE_SPAN("EnforceMemoryBudget");
+  bool within = CompactToBudget();
+  estimated_usage_ = MemoryUsage().Total();
+  budget_failed_ = !within;
+  budget_failed_generation_ = generation_;
+  budget_retry_usage_ = within ? 0 : estimated_usage_ + estimated_usage_ / 8;
+  return within;
+}
+
+bool MemoryCurrencyRateRepository::CompactToBudget() {
+  MemoryUsageReport usage = MemoryUsage();
+  if (usage.Total() <= memory_budget_) {
+    return true;
+  }
+
+  // Spare capacity goes first, as nothing has to be rebuilt.
+  rates_.shrink_to_fit();
+  index_.ShrinkToFit();
+  usage = MemoryUsage();
+  if (usage.Total() <= memory_budget_) {
+    return true;
+  }
+
+  // Shrinking moves the strings, which keeps their buffers; copies get
+  // buffers sized to their contents. Positions do not change.
+  if (usage.slack > 0) {
+    vector<CurrencyRate> compact(rates_);
+    rates_.swap(compact);
+    usage = MemoryUsage();
+    if (usage.Total() <= memory_budget_) {
+      return true;
+    }
+  }
+
+  // The index only mirrors |rates_|; rebuilding it into a fresh object
+  // also frees the hash buckets that Clear() keeps.
+  CurrencyRateIndex rebuilt;
+  rebuilt.Rebuild(rates_);
+  rebuilt.ShrinkToFit();
+  index_ = move(rebuilt);
+  return MemoryUsage().Total() <= memory_budget_;
+}
+
+void MemoryCurrencyRateRepository::ApplyMemoryBudget() {
+  if (memory_budget_ == 0 || estimated_usage_ <= memory_budget_ ||
+      estimated_usage_ < budget_retry_usage_) {
+    return;
+  }
+  EnforceMemoryBudget();
+}
+
+void MemoryCurrencyRateRepository::RemeasureMemory() {
+  if (memory_budget_ != 0) {
+    estimated_usage_ = MemoryUsage().Total();
+  }
+}
+
+void MemoryCurrencyRateRepository::ReserveRecords(size_t capacity) {
+  size_t before = rates_.capacity();
+  rates_.reserve(capacity);
+  estimated_usage_ += (rates_.capacity() - before) * sizeof(CurrencyRate);
+}
@@ -0,0 +1,145 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_resample.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include "currency_date.h"
+#include "currency_rate_metrics.h"
+#include "currency_rate_trace.h"
+#include "currency_rate_validator.h"
+#include "parallel_executor.h"
+
+using std::unordered_map;
+using std::vector;
+
+namespace {
+
+struct Quote {
+  int day;
+  double rate;
+};
+
+constexpr double kNoValue = std::numeric_limits<double>::quiet_NaN();
+
+// The pair's quotes by day, the last stored one winning within a day.
+vector<Quote> DailyQuotes(const vector<CurrencyRate>& rates,
+                          const vector<size_t>& positions) {
+  vector<std::pair<int, size_t>> days(positions.size());
+  for (size_t i = 0; i < positions.size(); ++i) {
+    days[i] = {CurrencyDate::ToDayNumber(rates[positions[i]].date()),
+               positions[i]};
+  }
+  std::sort(days.begin(), days.end());
+
+  vector<Quote> quotes;
+  quotes.reserve(days.size());
+  for (size_t i = 0; i < days.size(); ++i) {
+    if (i + 1 < days.size() && days[i + 1].first == days[i].first) {
+      continue;
+    }
+    quotes.push_back({days[i].first, rates[days[i].second].rate()});
+  }
+  return quotes;
+}
+
+void FillRow(const vector<Quote>& quotes, const vector<int>& days,
+             GapFill fill, double* row) {
+  // |next| is the first quote after the current day.
+  size_t next = 0;
+  for (size_t column = 0; column < days.size(); ++column) {
+    int day = days[column];
+    while (next < quotes.size() && quotes[next].day <= day) {
+      ++next;
+    }
+    const Quote* previous = next > 0 ? &quotes[next - 1] : nullptr;
+
+    double value = kNoValue;
+    if (previous != nullptr && previous->day == day) {
+      value = previous->rate;
+    } else if (previous != nullptr && fill == GapFill::kForward) {
+      value = previous->rate;
+    } else if (previous != nullptr && fill == GapFill::kLinear &&
+               next < quotes.size()) {
+      const Quote& after = quotes[next];
+      double weight = static_cast<double>(day - previous->day) /
+                      static_cast<double>(after.day - previous->day);
+      value = previous->rate + (after.rate - previous->rate) * weight;
+    }
+    row[column] = value;
+  }
+}
+
+}  // namespace
+
+vector<int> CurrencyRateResampler::CalendarDays(int from, int to,
+                                                ResampleCalendar calendar) {
+  vector<int> days;
+  for (int day = from; day <= to; ++day) {
+    if (calendar == ResampleCalendar::kWeekdays &&
+        CurrencyDate::DayOfWeek(day) >= 5) {
+      continue;
+    }
+    days.push_back(day);
+  }
+  return days;
+}
+
+RateMatrix CurrencyRateResampler::Resample(const vector<CurrencyRate>& rates,
+                                           const ResampleOptions& options) {
+  CURRENCY_RATE_TIME_SCOPE("currency_rate_resample_seconds",
+                           "Time to resample rates into a pair x day matrix.");
+  CURRENCY_RATE_TRACE_SPAN("Resample");
+  CurrencyRateValidator::ValidateDate(options.from);
+  CurrencyRateValidator::ValidateDate(options.to);
+  vector<int> days = CalendarDays(CurrencyDate::ToDayNumber(options.from),
+                                  CurrencyDate::ToDayNumber(options.to),
+                                  options.calendar);
+
+  unordered_map<CurrencyPair, size_t, CurrencyPairHash> pair_slots;
+  vector<CurrencyPair> pairs;
+  vector<vector<size_t>> positions;
+  for (size_t i = 0; i < rates.size(); ++i) {
+    const CurrencyRate& rate = rates[i];
+    if (!options.pair_filter.Matches(rate)) {
+      continue;
+    }
+    CurrencyPair pair(rate.currency1(), rate.currency2());
+    auto inserted = pair_slots.emplace(pair, pairs.size());
+    if (inserted.second) {
+      pairs.push_back(pair);
+      positions.emplace_back();
+    }
+    positions[inserted.first->second].push_back(i);
+  }
+
+  vector<size_t> order(pairs.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&pairs](size_t a, size_t b) {
+    return pairs[a] < pairs[b];
+  });
+
+  RateMatrix matrix;
+  matrix.pairs.reserve(order.size());
+  for (size_t slot : order) {
+    matrix.pairs.push_back(pairs[slot]);
+  }
+  matrix.days.reserve(days.size());
+  for (int day : days) {
+    matrix.days.push_back(CurrencyDate::FromDayNumber(day));
+  }
+  matrix.values.resize(order.size() * days.size());
+
+  ParallelExecutor::For(order.size(), options.max_threads, [&](size_t i) {
+    vector<Quote> quotes = DailyQuotes(rates, positions[order[i]]);
+    FillRow(quotes, days, options.fill,
+            matrix.values.data() + i * days.size());
+  });
+  return matrix;
+}
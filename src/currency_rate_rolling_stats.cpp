@@ -0,0 +1,176 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_rolling_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using std::invalid_argument;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::out_of_range;
+using std::to_string;
+using std::vector;
+
+RollingWindowStatistics::RollingWindowStatistics(
+    const vector<size_t>& windows) {
+  for (size_t length : windows) {
+    Window window;
+    window.length = length;
+    window.ema_alpha = 2.0 / (static_cast<double>(length) + 1.0);
+    window.rates.assign(length, 0.0);
+    window.returns.assign(length, 0.0);
+    windows_.push_back(window);
+  }
+}
+
+void RollingWindowStatistics::Add(double rate) {
+  bool has_return = has_last_rate_;
+  double log_return = has_return ? std::log(rate / last_rate_) : 0.0;
+
+  for (auto& window : windows_) {
+    Push(&window, rate, has_return, log_return);
+  }
+
+  last_rate_ = rate;
+  has_last_rate_ = true;
+}
+
+void RollingWindowStatistics::Push(Window* window, double rate,
+                                   bool has_return, double log_return) {
+  if (window->rates_count == 0) {
+    window->ema = rate;
+  } else {
+    window->ema += window->ema_alpha * (rate - window->ema);
+  }
+
+  if (window->rates_count == window->length) {
+    window->rate_sum -= window->rates[window->rates_head];
+  } else {
+    ++window->rates_count;
+  }
+  window->rates[window->rates_head] = rate;
+  window->rate_sum += rate;
+  window->rates_head = (window->rates_head + 1) % window->length;
+
+  if (has_return) {
+    if (window->returns_count == window->length) {
+      double evicted = window->returns[window->returns_head];
+      window->return_sum -= evicted;
+      window->return_square_sum -= evicted * evicted;
+    } else {
+      ++window->returns_count;
+    }
+    window->returns[window->returns_head] = log_return;
+    window->return_sum += log_return;
+    window->return_square_sum += log_return * log_return;
+    window->returns_head = (window->returns_head + 1) % window->length;
+  }
+
+  // Running sums accumulate rounding error as values are evicted;
+  // recomputing them once per full cycle keeps updates amortized O(1).
+  if (window->rates_head == 0 && window->rates_count == window->length) {
+    Resum(window);
+  }
+}
+
+void RollingWindowStatistics::Resum(Window* window) {
+  window->rate_sum = 0.0;
+  for (size_t i = 0; i < window->rates_count; ++i) {
+    window->rate_sum += window->rates[i];
+  }
+
+  window->return_sum = 0.0;
+  window->return_square_sum = 0.0;
+  for (size_t i = 0; i < window->returns_count; ++i) {
+    window->return_sum += window->returns[i];
+    window->return_square_sum += window->returns[i] * window->returns[i];
+  }
+}
+
+RollingIndicators RollingWindowStatistics::Get(size_t length) const {
+  auto it = std::find_if(windows_.begin(), windows_.end(),
+                         [length](const Window& window) {
+                           return window.length == length;
+                         });
+  if (it == windows_.end()) {
+    throw out_of_range("Rolling window " + to_string(length) +
+                       " is not configured");
+  }
+
+  RollingIndicators indicators;
+  indicators.window = it->length;
+  indicators.count = it->rates_count;
+  indicators.ema = it->ema;
+
+  if (it->rates_count > 0) {
+    indicators.sma = it->rate_sum / static_cast<double>(it->rates_count);
+  }
+
+  if (it->returns_count > 1) {
+    double n = static_cast<double>(it->returns_count);
+    double mean = it->return_sum / n;
+    double variance = (it->return_square_sum - n * mean * mean) / (n - 1.0);
+    indicators.volatility = std::sqrt(std::max(variance, 0.0));
+  }
+
+  return indicators;
+}
+
+size_t RollingWindowStatistics::HeapBytes() const {
+  size_t bytes = windows_.capacity() * sizeof(Window);
+  for (const auto& window : windows_) {
+    bytes += (window.rates.capacity() + window.returns.capacity()) *
+             sizeof(double);
+  }
+  return bytes;
+}
+
+RollingStatisticsTracker::RollingStatisticsTracker(vector<size_t> windows)
+    : windows_(move(windows)) {
+  if (windows_.empty()) {
+    throw invalid_argument("At least one rolling window is required");
+  }
+  for (size_t window : windows_) {
+    if (window == 0) {
+      throw invalid_argument("Rolling window length must be positive");
+    }
+  }
+}
+
+void RollingStatisticsTracker::Add(const CurrencyRate& rate) {
+  CurrencyPair pair(rate.currency1(), rate.currency2());
+  auto it = series_.find(pair);
+  if (it == series_.end()) {
+    it = series_.emplace(move(pair), RollingWindowStatistics(windows_)).first;
+  }
+  it->second.Add(rate.rate());
+}
+
+void RollingStatisticsTracker::Clear() {
+  series_.clear();
+}
+
+void RollingStatisticsTracker::AccountMemory(MemoryUsageReport* usage) const {
+  size_t bytes = windows_.capacity() * sizeof(size_t) +
+                 MemoryAccounting::HashNodes(series_);
+  for (const auto& entry : series_) {
+    bytes += MemoryAccounting::StringHeap(entry.first.currency1) +
+             MemoryAccounting::StringHeap(entry.first.currency2) +
+             entry.second.HeapBytes();
+  }
+  usage->caches += bytes;
+}
+
+optional<RollingIndicators> RollingStatisticsTracker::Get(
+    const CurrencyPair& pair, size_t window) const {
+  auto it = series_.find(pair);
+  if (it == series_.end()) {
+    return nullopt;
+  }
+  return it->second.Get(window);
+}
@@ -0,0 +1,545 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_server.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "currency_rate_filter.h"
+#include "currency_rate_follower.h"
+#include "currency_rate_trace.h"
+#include "rate_format.h"
+
+using std::lock_guard;
+using std::make_unique;
+using std::move;
+using std::mutex;
+using std::ofstream;
+using std::runtime_error;
+using std::shared_lock;
+using std::shared_mutex;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::unique_lock;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+constexpr int kPollIntervalMs = 100;
+// Bytes read from a connection per turn of a worker.
+constexpr size_t kReceiveChunk = 64 * 1024;
+// Longest request line accepted; a client sending a longer one is
+// answered with ERR and disconnected.
+constexpr size_t kMaxRequestLine = 64 * 1024;
+
+vector<string> SplitFields(const string& line) {
+  vector<string> fields;
+  size_t start = 0;
+  while (true) {
+    size_t tab = line.find('\t', start);
+    fields.push_back(line.substr(start, tab - start));
+    if (tab == string::npos) {
+      return fields;
+    }
+    start = tab + 1;
+  }
+}
+
+string Error(const string& message) {
+  string response = "ERR ";
+  for (char c : message) {
+    response.push_back(c == '\n' ? ' ' : c);
+  }
+  response.push_back('\n');
+  return response;
+}
+
+string RatesResponse(const vector<CurrencyRate>& rates) {
+  string response = "OK " + to_string(rates.size()) + "\n";
+  for (const auto& rate : rates) {
+    response.append(rate.ToFileString()).push_back('\n');
+  }
+  return response;
+}
+
+// Sends as much of |pending| as the socket takes without blocking and
+// drops it from |pending|. Returns false if the peer is gone.
+bool SendPending(int fd, string* pending) {
+  size_t sent = 0;
+  while (sent < pending->size()) {
+    ssize_t written = ::send(fd, pending->data() + sent,
+                             pending->size() - sent,
+                             MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return false;
+      }
+      break;
+    }
+    sent += static_cast<size_t>(written);
+  }
+  pending->erase(0, sent);
+  return true;
+}
+
+string SystemError(const string& what) {
+  return what + ": " + std::strerror(errno);
+}
+
+bool SetNonBlocking(int fd) {
+  int flags = ::fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+}  // namespace
+
+CurrencyRateServer::CurrencyRateServer(
+    MemoryCurrencyRateRepository* repository, ServerOptions options)
+    : repository_(repository),
+      options_(move(options)),
+      parser_(CurrencyRateParserFactory::CreateDefaultParser()) {}
+
+CurrencyRateServer::~CurrencyRateServer() {
+  Stop();
+}
+
+void CurrencyRateServer::Start() {
+  if (running_) {
+    return;
+  }
+
+  if (options_.tcp_port != 0) {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+      throw runtime_error(SystemError("Failed to create socket"));
+    }
+    int reuse = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options_.tcp_port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+               sizeof(address)) < 0) {
+      string message = SystemError("Failed to bind port " +
+                                   to_string(options_.tcp_port));
+      ::close(listen_fd_);
+      listen_fd_ = -1;
+      throw runtime_error(message);
+    }
+    bound_port_ = options_.tcp_port;
+  } else {
+    sockaddr_un address{};
+    if (options_.socket_path.empty() ||
+        options_.socket_path.size() >= sizeof(address.sun_path)) {
+      throw runtime_error("Invalid socket path: " + options_.socket_path);
+    }
+
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+      throw runtime_error(SystemError("Failed to create socket"));
+    }
+    ::unlink(options_.socket_path.c_str());
+
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, options_.socket_path.c_str(),
+                 sizeof(address.sun_path) - 1);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+               sizeof(address)) < 0) {
+      string message = SystemError("Failed to bind " + options_.socket_path);
+      ::close(listen_fd_);
+      listen_fd_ = -1;
+      throw runtime_error(message);
+    }
+  }
+
+  if (::listen(listen_fd_, SOMAXCONN) < 0) {
+    string message = SystemError("Failed to listen");
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+    throw runtime_error(message);
+  }
+
+  if (::pipe(wake_fds_) < 0 || !SetNonBlocking(wake_fds_[0]) ||
+      !SetNonBlocking(wake_fds_[1])) {
+    string message = SystemError("Failed to create wake pipe");
+    for (int& fd : wake_fds_) {
+      if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+      }
+    }
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+    throw runtime_error(message);
+  }
+
+  running_ = true;
+  poller_ = thread(&CurrencyRateServer::PollLoop, this);
+  size_t worker_count = options_.worker_threads == 0 ? 1
+                                                     : options_.worker_threads;
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers_.emplace_back(&CurrencyRateServer::WorkerLoop, this);
+  }
+  writer_ = thread(&CurrencyRateServer::WriterLoop, this);
+
+  if (options_.follow_sources) {
+    stop_following_ = false;
+    follower_ = thread([this]() {
+      TraceRecorder::SetThreadName("source follower");
+      CurrencyRateFollower follower(repository_->SourceFiles(), [this]() {
+        unique_lock<shared_mutex> lock(repository_mutex_);
+        return repository_->Refresh();
+      });
+      follower.Run(stop_following_);
+    });
+  }
+}
+
+void CurrencyRateServer::Stop() {
+  // Cleared under both mutexes, so that a worker or the writer cannot
+  // test its wait condition before the flag changes and then sleep
+  // through the notifications below.
+  bool was_running = false;
+  {
+    std::scoped_lock lock(connections_mutex_, log_mutex_);
+    was_running = running_.exchange(false);
+  }
+  if (!was_running) {
+    return;
+  }
+
+  connections_ready_.notify_all();
+  log_ready_.notify_all();
+  stop_following_ = true;
+
+  if (follower_.joinable()) {
+    follower_.join();
+  }
+  poller_.join();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+  writer_.join();
+
+  for (const auto& connection : ready_connections_) {
+    ::close(connection->fd);
+  }
+  ready_connections_.clear();
+  for (const auto& connection : returned_connections_) {
+    ::close(connection->fd);
+  }
+  returned_connections_.clear();
+
+  for (int& fd : wake_fds_) {
+    ::close(fd);
+    fd = -1;
+  }
+  ::close(listen_fd_);
+  listen_fd_ = -1;
+  if (options_.tcp_port == 0) {
+    ::unlink(options_.socket_path.c_str());
+  }
+}
+
+string CurrencyRateServer::HandleRequest(const string& line) {
+  CURRENCY_RATE_TRACE_SPAN("HandleRequest", line);
+  string request = line;
+  if (!request.empty() && request.back() == '\r') {
+    request.pop_back();
+  }
+
+  vector<string> fields = SplitFields(request);
+  const string& command = fields[0];
+
+  try {
+    if (command == "PING") {
+      return "OK 0\n";
+    }
+
+    if (command == "ADD") {
+      if (fields.size() < 2) {
+        return Error("ADD expects a rate line");
+      }
+      return HandleAdd(request.substr(4));
+    }
+
+    shared_lock<shared_mutex> lock(repository_mutex_);
+
+    if (command == "COUNT") {
+      return "OK 1\n" + to_string(repository_->Count()) + "\n";
+    }
+
+    if (command == "ASOF") {
+      if (fields.size() != 4) {
+        return Error("ASOF expects <from> <to> <date>");
+      }
+      auto rate = repository_->GetRateAsOf(fields[1], fields[2], fields[3]);
+      return rate ? RatesResponse({*rate}) : "OK 0\n";
+    }
+
+    if (command == "RANGE") {
+      if (fields.size() != 5) {
+        return Error("RANGE expects <from> <to> <date from> <date to>");
+      }
+      return RatesResponse(repository_->GetRange(fields[1], fields[2],
+                                                 {fields[3], fields[4]}));
+    }
+
+    if (command == "FILTER") {
+      if (fields.size() != 2) {
+        return Error("FILTER expects <expression>");
+      }
+      return RatesResponse(
+          repository_->Query(FilterExpression::Parse(fields[1])));
+    }
+
+    if (command == "CONVERT") {
+      if (fields.size() != 5) {
+        return Error("CONVERT expects <amount> <from> <to> <date>");
+      }
+      double amount = 0.0;
+      if (!RateFormat::Parse(fields[1], &amount)) {
+        return Error("Invalid amount: " + fields[1]);
+      }
+      auto rate = repository_->GetRateAsOf(fields[2], fields[3], fields[4]);
+      if (!rate) {
+        return Error("No rate for " + fields[2] + "/" + fields[3] +
+                     " on or before " + fields[4]);
+      }
+      return "OK 1\n" + RateFormat::ToFixed(amount * rate->rate()) + "\n";
+    }
+  } catch (const std::exception& e) {
+    return Error(e.what());
+  }
+
+  return Error("Unknown command: " + command);
+}
+
+string CurrencyRateServer::HandleAdd(const string& line) {
+  CurrencyRate rate = parser_->Parse(line);
+
+  {
+    unique_lock<shared_mutex> lock(repository_mutex_);
+    repository_->Add(rate);
+  }
+
+  if (!options_.append_log.empty()) {
+    lock_guard<mutex> lock(log_mutex_);
+    pending_log_.push_back(rate.ToFileString());
+    if (pending_log_.size() >= options_.max_log_batch) {
+      log_ready_.notify_one();
+    }
+  }
+  return "OK 0\n";
+}
+
+void CurrencyRateServer::PollLoop() {
+  TraceRecorder::SetThreadName("server poller");
+  vector<unique_ptr<Connection>> idle;
+  vector<pollfd> fds;
+
+  while (running_) {
+    {
+      lock_guard<mutex> lock(connections_mutex_);
+      for (auto& connection : returned_connections_) {
+        idle.push_back(move(connection));
+      }
+      returned_connections_.clear();
+    }
+
+    fds.clear();
+    fds.push_back({listen_fd_, POLLIN, 0});
+    fds.push_back({wake_fds_[0], POLLIN, 0});
+    // A connection with replies left to send waits until it can write
+    // and is not read meanwhile.
+    for (const auto& connection : idle) {
+      short events = connection->output.empty() ? POLLIN : POLLOUT;
+      fds.push_back({connection->fd, events, 0});
+    }
+    int ready = ::poll(fds.data(), fds.size(), kPollIntervalMs);
+    if (ready <= 0) {
+      continue;
+    }
+
+    if (fds[1].revents != 0) {
+      char drain[64];
+      while (::read(wake_fds_[0], drain, sizeof(drain)) > 0) {
+      }
+    }
+
+    // Data, room to write, a hangup or an error all need a worker.
+    size_t handed = 0;
+    {
+      lock_guard<mutex> lock(connections_mutex_);
+      size_t kept = 0;
+      for (size_t i = 0; i < idle.size(); ++i) {
+        if (fds[i + 2].revents != 0) {
+          ready_connections_.push_back(move(idle[i]));
+          ++handed;
+        } else {
+          idle[kept++] = move(idle[i]);
+        }
+      }
+      idle.resize(kept);
+    }
+    for (; handed > 0; --handed) {
+      connections_ready_.notify_one();
+    }
+
+    if (fds[0].revents != 0) {
+      int fd = ::accept(listen_fd_, nullptr, nullptr);
+      if (fd >= 0 && !SetNonBlocking(fd)) {
+        ::close(fd);
+      } else if (fd >= 0) {
+        idle.push_back(make_unique<Connection>(Connection{fd, {}, {}}));
+      }
+    }
+  }
+
+  for (const auto& connection : idle) {
+    ::close(connection->fd);
+  }
+}
+
+void CurrencyRateServer::WorkerLoop() {
+  TraceRecorder::SetThreadName("server worker");
+  while (true) {
+    unique_ptr<Connection> connection;
+    {
+      unique_lock<mutex> lock(connections_mutex_);
+      connections_ready_.wait(lock, [this]() {
+        return !running_ || !ready_connections_.empty();
+      });
+      if (!running_) {
+        return;
+      }
+      connection = move(ready_connections_.front());
+      ready_connections_.pop_front();
+    }
+
+    if (ServeConnection(connection.get())) {
+      ReturnConnection(move(connection));
+    } else {
+      ::close(connection->fd);
+    }
+  }
+}
+
+bool CurrencyRateServer::ServeConnection(Connection* connection) {
+  string& output = connection->output;
+  if (!SendPending(connection->fd, &output)) {
+    return false;
+  }
+  // Requests are not read while earlier replies are still unsent, so a
+  // client that does not read them only stalls itself.
+  if (!output.empty()) {
+    return true;
+  }
+
+  char chunk[kReceiveChunk];
+  ssize_t received = 0;
+  do {
+    received = ::recv(connection->fd, chunk, sizeof(chunk), 0);
+  } while (received < 0 && errno == EINTR);
+  if (received < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+  }
+  if (received == 0) {
+    return false;
+  }
+
+  string& buffer = connection->buffer;
+  buffer.append(chunk, static_cast<size_t>(received));
+  size_t start = 0;
+  size_t newline = 0;
+  bool overlong = false;
+  while (!overlong && (newline = buffer.find('\n', start)) != string::npos) {
+    overlong = newline - start > kMaxRequestLine;
+    output += overlong ? Error("Request line too long")
+                       : HandleRequest(buffer.substr(start, newline - start));
+    start = newline + 1;
+  }
+  buffer.erase(0, start);
+  if (!overlong && buffer.size() > kMaxRequestLine) {
+    overlong = true;
+    output += Error("Request line too long");
+  }
+
+  // The error reply is sent on a best-effort basis before disconnecting.
+  return SendPending(connection->fd, &output) && !overlong;
+}
+
+void CurrencyRateServer::ReturnConnection(unique_ptr<Connection> connection) {
+  {
+    lock_guard<mutex> lock(connections_mutex_);
+    returned_connections_.push_back(move(connection));
+  }
+  // A write can only fail on a full pipe, which wakes the loop anyway.
+  char wake = 1;
+  ssize_t written = ::write(wake_fds_[1], &wake, 1);
+  (void)written;
+}
+
+void CurrencyRateServer::WriterLoop() {
+  TraceRecorder::SetThreadName("append log writer");
+  vector<string> batch;
+
+  while (true) {
+    bool stopping = false;
+    {
+      unique_lock<mutex> lock(log_mutex_);
+      log_ready_.wait_for(lock, options_.flush_interval, [this]() {
+        return !running_ || pending_log_.size() >= options_.max_log_batch;
+      });
+      stopping = !running_;
+      batch.swap(pending_log_);
+    }
+
+    FlushLog(&batch);
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+void CurrencyRateServer::FlushLog(vector<string>* lines) {
+  if (lines->empty()) {
+    return;
+  }
+  CURRENCY_RATE_TRACE_SPAN("FlushLog", options_.append_log);
+
+  string block;
+  for (const auto& line : *lines) {
+    block.append(line).push_back('\n');
+  }
+  lines->clear();
+
+  ofstream file(options_.append_log, std::ios::app | std::ios::binary);
+  if (!file.is_open()) {
+    std::fprintf(stderr, "Failed to open append log: %s\n",
+                 options_.append_log.c_str());
+    return;
+  }
+  file.write(block.data(), static_cast<std::streamsize>(block.size()));
+}
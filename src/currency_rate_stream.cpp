@@ -0,0 +1,300 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_stream.h"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "currency_rate_metrics.h"
+#include "currency_rate_trace.h"
+
+using std::cerr;
+using std::condition_variable;
+using std::endl;
+using std::ifstream;
+using std::ios;
+using std::lock_guard;
+using std::mutex;
+using std::runtime_error;
+using std::string;
+using std::string_view;
+using std::thread;
+using std::unique_lock;
+using std::vector;
+
+namespace {
+
+struct ReadBuffer {
+  vector<char> data;
+  size_t size = 0;
+  bool filled = false;
+  bool last = false;
+};
+
+// Hands two buffers back and forth between a reader thread and the
+// consumer. The reader fills whichever buffer the consumer released last
+// and blocks while both are full.
+class ReadAhead {
+public:
+  ReadAhead(const string& filename, size_t buffer_size)
+      : filename_(filename), file_(filename, ios::binary) {
+    if (!file_.is_open()) {
+      throw runtime_error("Failed to open file: " + filename);
+    }
+    for (auto& buffer : buffers_) {
+      buffer.data.resize(std::max<size_t>(buffer_size, 1));
+    }
+    reader_ = thread(&ReadAhead::ReadLoop, this);
+  }
+
+  ~ReadAhead() {
+    {
+      lock_guard<mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    changed_.notify_all();
+    reader_.join();
+  }
+
+  ReadAhead(const ReadAhead&) = delete;
+  ReadAhead& operator=(const ReadAhead&) = delete;
+
+  // Releases the buffer returned by the previous call and waits for the
+  // next one. Returns nullptr after the last buffer.
+  const ReadBuffer* Next() {
+    unique_lock<mutex> lock(mutex_);
+    if (current_ != nullptr) {
+      bool was_last = current_->last;
+      current_->filled = false;
+      current_ = nullptr;
+      changed_.notify_all();
+      if (was_last) {
+        return nullptr;
+      }
+    }
+
+    ReadBuffer& buffer = buffers_[next_];
+    changed_.wait(lock, [&buffer]() { return buffer.filled; });
+    if (failed_ && buffer.last) {
+      throw runtime_error("Failed to read file: " + filename_);
+    }
+    next_ = 1 - next_;
+    current_ = &buffer;
+    return current_;
+  }
+
+private:
+  void ReadLoop() {
+    TraceRecorder::SetThreadName("stream read-ahead");
+    for (size_t index = 0;; index = 1 - index) {
+      ReadBuffer& buffer = buffers_[index];
+      {
+        unique_lock<mutex> lock(mutex_);
+        changed_.wait(lock,
+                      [&]() { return stopping_ || !buffer.filled; });
+        if (stopping_) {
+          return;
+        }
+      }
+
+      // The buffer is owned by this thread until it is marked filled.
+      bool failed = false;
+      {
+        CURRENCY_RATE_TRACE_SPAN("ReadBlock");
+        file_.read(buffer.data.data(),
+                   static_cast<std::streamsize>(buffer.data.size()));
+        buffer.size = static_cast<size_t>(file_.gcount());
+        failed = file_.bad();
+        buffer.last = failed || buffer.size < buffer.data.size() ||
+                      file_.peek() == std::char_traits<char>::eof();
+      }
+
+      {
+        lock_guard<mutex> lock(mutex_);
+        failed_ = failed;
+        buffer.filled = true;
+      }
+      changed_.notify_all();
+      if (buffer.last) {
+        return;
+      }
+    }
+  }
+
+  string filename_;
+  ifstream file_;
+  ReadBuffer buffers_[2];
+  size_t next_ = 0;
+  ReadBuffer* current_ = nullptr;
+
+  mutex mutex_;
+  condition_variable changed_;
+  bool stopping_ = false;
+  bool failed_ = false;
+  thread reader_;
+};
+
+// Parses lines a buffer at a time and forwards full batches to the sink.
+class BatchParser {
+public:
+  BatchParser(const ICurrencyRateParser& parser, const RateBatchSink& sink,
+              size_t batch_size, StreamStats* stats)
+      : parser_(parser),
+        sink_(sink),
+        batch_size_(std::max<size_t>(batch_size, 1)),
+        stats_(stats) {
+    batch_.reserve(batch_size_);
+  }
+
+  // Returns false once the sink has asked to stop.
+  bool AddLines(const vector<string_view>& lines) {
+    columns_.Clear();
+    parser_.ParseBatch(lines, &columns_);
+
+    for (size_t row = 0; row < columns_.size(); ++row) {
+      uint64_t line_number = ++stats_->lines;
+
+      try {
+        if (columns_.HasError(row)) {
+          if (IsBlank(lines[row])) {
+            continue;
+          }
+          // Parse again for the error message.
+          parser_.Parse(string(lines[row]));
+        }
+        batch_.push_back(columns_.ToRate(row));
+        ++stats_->records;
+      } catch (const CurrencyRateException& e) {
+        ++stats_->rejected;
+        cerr << "Error parsing line " << line_number
+             << ": " << e.what() << endl;
+        CURRENCY_RATE_COUNT_REJECTED(&e);
+        continue;
+      }
+
+      if (batch_.size() >= batch_size_ && !Flush()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Counts the next line as rejected without parsing it.
+  void RejectLine(const string& reason) {
+    uint64_t line_number = ++stats_->lines;
+    ++stats_->rejected;
+    cerr << "Error parsing line " << line_number << ": " << reason << endl;
+    InvalidFormatException error(reason);
+    CURRENCY_RATE_COUNT_REJECTED(&error);
+  }
+
+  bool Flush() {
+    if (batch_.empty()) {
+      return true;
+    }
+    bool proceed = sink_(batch_);
+    batch_.clear();
+    stats_->stopped = !proceed;
+    return proceed;
+  }
+
+private:
+  static bool IsBlank(string_view line) {
+    return std::all_of(line.begin(), line.end(),
+                       [](unsigned char c) { return std::isspace(c); });
+  }
+
+  const ICurrencyRateParser& parser_;
+  const RateBatchSink& sink_;
+  size_t batch_size_;
+  StreamStats* stats_;
+  RateColumnBatch columns_;
+  vector<CurrencyRate> batch_;
+};
+
+StreamStats CountRead(const StreamStats& stats) {
+  CURRENCY_RATE_COUNT("currency_rate_lines_read_total",
+                      "Lines read from rate files.", stats.lines);
+  CURRENCY_RATE_COUNT("currency_rate_bytes_read_total",
+                      "Bytes read from rate files.", stats.bytes);
+  CURRENCY_RATE_COUNT("currency_rate_records_loaded_total",
+                      "Records parsed from rate files.", stats.records);
+  return stats;
+}
+
+}  // namespace
+
+StreamStats CurrencyRateStreamReader::StreamFile(
+    const string& filename, const ICurrencyRateParser& parser,
+    const RateBatchSink& sink, const StreamOptions& options) {
+  CURRENCY_RATE_TRACE_SPAN("StreamFile", filename);
+  StreamStats stats;
+  BatchParser batch(parser, sink, options.batch_size, &stats);
+  ReadAhead read_ahead(filename, options.buffer_size);
+
+  // Holds the start of a line that continues in the next buffer, unless
+  // the line has grown past the limit and is being dropped.
+  string carry;
+  bool overlong = false;
+  size_t max_line_length = std::max<size_t>(options.max_line_length, 1);
+  auto hold = [&](string_view part) {
+    if (overlong || carry.size() + part.size() > max_line_length) {
+      overlong = true;
+      string().swap(carry);
+      return;
+    }
+    carry.append(part);
+  };
+  // Hands on the held line once its end is read.
+  auto release = [&]() {
+    if (overlong) {
+      overlong = false;
+      batch.RejectLine("Line is longer than " +
+                       std::to_string(max_line_length) + " bytes");
+      return true;
+    }
+    bool proceed = batch.AddLines({carry});
+    carry.clear();
+    return proceed;
+  };
+  vector<string_view> lines;
+
+  while (const ReadBuffer* buffer = read_ahead.Next()) {
+    stats.bytes += buffer->size;
+    string_view data(buffer->data.data(), buffer->size);
+
+    if (!carry.empty() || overlong) {
+      size_t newline = data.find('\n');
+      hold(data.substr(0, newline));
+      if (newline == string_view::npos) {
+        continue;
+      }
+      data.remove_prefix(newline + 1);
+      if (!release()) {
+        return CountRead(stats);
+      }
+    }
+
+    lines.clear();
+    size_t consumed = ICurrencyRateParser::SplitLines(data, &lines);
+    if (!batch.AddLines(lines)) {
+      return CountRead(stats);
+    }
+    hold(data.substr(consumed));
+  }
+
+  if ((!carry.empty() || overlong) && !release()) {
+    return CountRead(stats);
+  }
+  batch.Flush();
+  return CountRead(stats);
+}
@@ -0,0 +1,227 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "currency_rate_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using std::lock_guard;
+using std::make_shared;
+using std::mutex;
+using std::ofstream;
+using std::runtime_error;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace {
+
+struct TraceEvent {
+  const char* name = nullptr;
+  string detail;
+  uint64_t start_ns = 0;
+  uint64_t end_ns = 0;
+};
+
+// Ring buffer of one thread. Only the owning thread writes; the lock is
+// uncontended except while a trace is being exported or cleared.
+struct ThreadTrace {
+  mutex lock;
+  uint32_t tid = 0;
+  string name;
+  vector<TraceEvent> events;
+  size_t next = 0;
+  uint64_t recorded = 0;
+};
+
+struct TraceState {
+  mutex lock;
+  vector<shared_ptr<ThreadTrace>> threads;
+  size_t capacity = TraceRecorder::kDefaultBufferCapacity;
+  uint32_t next_tid = 1;
+  std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+};
+
+TraceState& State() {
+  // Never destroyed, so threads may still record during static destruction.
+  static TraceState* state = new TraceState();
+  return *state;
+}
+
+ThreadTrace& LocalTrace() {
+  thread_local shared_ptr<ThreadTrace> local;
+  if (!local) {
+    TraceState& state = State();
+    local = make_shared<ThreadTrace>();
+    lock_guard<mutex> lock(state.lock);
+    local->tid = state.next_tid++;
+    local->events.resize(std::max<size_t>(state.capacity, 1));
+    state.threads.push_back(local);
+  }
+  return *local;
+}
+
+void AppendEscaped(const string& text, string* out) {
+  for (char c : text) {
+    unsigned char uc = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (uc < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", uc);
+      out->append(escaped);
+    } else {
+      out->push_back(c);
+    }
+  }
+}
+
+// Trace-event timestamps are microseconds.
+void AppendMicroseconds(uint64_t nanoseconds, string* out) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%llu.%03llu",
+                static_cast<unsigned long long>(nanoseconds / 1000),
+                static_cast<unsigned long long>(nanoseconds % 1000));
+  out->append(buffer);
+}
+
+void AppendEvent(const TraceEvent& event, uint32_t tid, string* out) {
+  out->append(",\n{\"name\":\"");
+  AppendEscaped(event.name, out);
+  out->append("\",\"cat\":\"currency_rate\",\"ph\":\"X\",\"pid\":1,\"tid\":")
+      .append(std::to_string(tid)).append(",\"ts\":");
+  AppendMicroseconds(event.start_ns, out);
+  out->append(",\"dur\":");
+  AppendMicroseconds(event.end_ns - event.start_ns, out);
+  if (!event.detail.empty()) {
+    out->append(",\"args\":{\"detail\":\"");
+    AppendEscaped(event.detail, out);
+    out->append("\"}");
+  }
+  out->push_back('}');
+}
+
+}  // namespace
+
+std::atomic<bool> TraceRecorder::enabled_{false};
+
+void TraceRecorder::SetBufferCapacity(size_t capacity) {
+  TraceState& state = State();
+  lock_guard<mutex> lock(state.lock);
+  state.capacity = capacity;
+}
+
+void TraceRecorder::SetThreadName(const string& name) {
+  if (!IsEnabled()) {
+    return;
+  }
+  ThreadTrace& trace = LocalTrace();
+  lock_guard<mutex> lock(trace.lock);
+  trace.name = name;
+}
+
+void TraceRecorder::Clear() {
+  TraceState& state = State();
+  lock_guard<mutex> lock(state.lock);
+
+  vector<shared_ptr<ThreadTrace>> live;
+  for (auto& trace : state.threads) {
+    {
+      lock_guard<mutex> trace_lock(trace->lock);
+      for (auto& event : trace->events) {
+        event = TraceEvent();
+      }
+      trace->next = 0;
+      trace->recorded = 0;
+    }
+    // The thread_local reference keeps a running thread's buffer alive.
+    if (trace.use_count() > 1) {
+      live.push_back(trace);
+    }
+  }
+  state.threads.swap(live);
+}
+
+uint64_t TraceRecorder::RecordedCount() {
+  TraceState& state = State();
+  lock_guard<mutex> lock(state.lock);
+  uint64_t count = 0;
+  for (const auto& trace : state.threads) {
+    lock_guard<mutex> trace_lock(trace->lock);
+    count += trace->recorded;
+  }
+  return count;
+}
+
+void TraceRecorder::Record(const char* name, string detail,
+                           uint64_t start_ns, uint64_t end_ns) {
+  ThreadTrace& trace = LocalTrace();
+  lock_guard<mutex> lock(trace.lock);
+  TraceEvent& event = trace.events[trace.next];
+  event.name = name;
+  event.detail = std::move(detail);
+  event.start_ns = start_ns;
+  event.end_ns = end_ns;
+  trace.next = (trace.next + 1) % trace.events.size();
+  ++trace.recorded;
+}
+
+uint64_t TraceRecorder::Now() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - State().epoch).count());
+}
+
+string TraceRecorder::ToChromeTrace() {
+  TraceState& state = State();
+  lock_guard<mutex> lock(state.lock);
+
+  string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"args\":{\"name\":\"currency_rate\"}}";
+
+  for (const auto& trace : state.threads) {
+    lock_guard<mutex> trace_lock(trace->lock);
+    if (!trace->name.empty()) {
+      out.append(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":").append(std::to_string(trace->tid))
+          .append(",\"args\":{\"name\":\"");
+      AppendEscaped(trace->name, &out);
+      out.append("\"}}");
+    }
+
+    // Oldest first: after a wrap the oldest span sits at |next|.
+    size_t size = trace->events.size();
+    size_t kept = static_cast<size_t>(
+        std::min<uint64_t>(trace->recorded, size));
+    size_t first = trace->recorded > size ? trace->next : 0;
+    for (size_t i = 0; i < kept; ++i) {
+      AppendEvent(trace->events[(first + i) % size], trace->tid, &out);
+    }
+  }
+
+  out.append("\n]}\n");
+  return out;
+}
+
+void TraceRecorder::WriteChromeTrace(const string& filename) {
+  string text = ToChromeTrace();
+  ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw runtime_error("Failed to open file for writing: " + filename);
+  }
+  file.write(text.data(), static_cast<std::streamsize>(text.size()));
+  if (!file) {
+    throw runtime_error("Failed to write file: " + filename);
+  }
+}
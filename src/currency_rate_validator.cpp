@@ -4,6 +4,7 @@
 
 #include "currency_rate_validator.h"
 #include "currency_rate.h"
+#include "rate_format.h"
 
 #include <ctime>
 #include <regex>
@@ -20,7 +21,12 @@ using std::string;
 using std::time;
 using std::time_t;
 using std::tm;
-using std::to_string;
+
+namespace {
+
+constexpr int64_t kMaxRate = 1000000;
+
+}  // namespace
 
 bool CurrencyRateValidator::IsValidCurrencyName(const string& name) {
   if (name.empty() || name.length() > 50) {
@@ -39,7 +45,12 @@ bool CurrencyRateValidator::IsValidCurrencyName(const string& name) {
 }
 
 bool CurrencyRateValidator::IsValidRate(double rate) {
-  return rate > 0 && rate < 1000000;
+  return rate > 0 && rate < kMaxRate;
+}
+
+bool CurrencyRateValidator::IsValidRate(const FixedRate& rate) {
+  return rate.units() > 0 &&
+         rate.units() < kMaxRate * FixedRate::Pow10(rate.scale());
 }
 
 bool CurrencyRateValidator::IsValidDate(const string& date) {
@@ -112,7 +123,14 @@ void CurrencyRateValidator::ValidateCurrencyName(const string& name) {
 
 void CurrencyRateValidator::ValidateRate(double rate) {
   if (!IsValidRate(rate)) {
-    throw InvalidRateException("Rate " + to_string(rate) +
+    throw InvalidRateException("Rate " + RateFormat::ToExact(rate) +
+        " is outside valid limits (0...1000000)");
+  }
+}
+
+void CurrencyRateValidator::ValidateRate(const FixedRate& rate) {
+  if (!IsValidRate(rate)) {
+    throw InvalidRateException("Rate " + rate.ToString() +
         " is outside valid limits (0...1000000)");
   }
 }
@@ -0,0 +1,195 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "fixed_rate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "currency_rate.h"
+
+using std::invalid_argument;
+using std::string;
+using std::string_view;
+
+namespace {
+
+constexpr int64_t kMaxUnits = std::numeric_limits<int64_t>::max();
+
+// Fraction of |units| expressed in 10^-kMaxScale units.
+int64_t NormalizedFraction(int64_t units, int scale) {
+  return (units % FixedRate::Pow10(scale)) *
+         FixedRate::Pow10(FixedRate::kMaxScale - scale);
+}
+
+}  // namespace
+
+FixedRate::FixedRate(int64_t units, int scale) : units_(units), scale_(scale) {
+  if (scale < 0 || scale > kMaxScale) {
+    throw invalid_argument("Fixed-point scale must be between 0 and " +
+                           std::to_string(kMaxScale));
+  }
+}
+
+int64_t FixedRate::Pow10(int exponent) {
+  static const int64_t kPowers[] = {
+      1LL,
+      10LL,
+      100LL,
+      1000LL,
+      10000LL,
+      100000LL,
+      1000000LL,
+      10000000LL,
+      100000000LL,
+      1000000000LL,
+      10000000000LL,
+      100000000000LL,
+      1000000000000LL,
+      10000000000000LL,
+      100000000000000LL,
+      1000000000000000LL,
+      10000000000000000LL,
+      100000000000000000LL,
+      1000000000000000000LL};
+  return kPowers[exponent];
+}
+
+bool FixedRate::Parse(string_view text, int scale, FixedRate* rate) {
+  if (scale < 0 || scale > kMaxScale) {
+    return false;
+  }
+
+  int64_t units = 0;
+  int fraction_digits = -1;
+  bool any_digit = false;
+  // First dropped digit, and whether any later dropped digit is non-zero.
+  int round_digit = 0;
+  bool sticky = false;
+
+  for (char c : text) {
+    if (c == '.') {
+      if (fraction_digits >= 0) {
+        return false;
+      }
+      fraction_digits = 0;
+      continue;
+    }
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    any_digit = true;
+
+    int digit = c - '0';
+    if (fraction_digits >= scale) {
+      if (fraction_digits == scale) {
+        round_digit = digit;
+      } else if (digit != 0) {
+        sticky = true;
+      }
+      ++fraction_digits;
+      continue;
+    }
+
+    if (units > (kMaxUnits - digit) / 10) {
+      return false;
+    }
+    units = units * 10 + digit;
+    if (fraction_digits >= 0) {
+      ++fraction_digits;
+    }
+  }
+
+  if (!any_digit) {
+    return false;
+  }
+
+  for (int i = std::max(fraction_digits, 0); i < scale; ++i) {
+    if (units > kMaxUnits / 10) {
+      return false;
+    }
+    units *= 10;
+  }
+
+  if (round_digit > 5 || (round_digit == 5 && (sticky || units % 2 != 0))) {
+    if (units == kMaxUnits) {
+      return false;
+    }
+    ++units;
+  }
+
+  *rate = FixedRate(units, scale);
+  return true;
+}
+
+FixedRate FixedRate::FromDouble(double value, int scale) {
+  FixedRate rate(0, scale);
+  rate.units_ = std::llround(value * static_cast<double>(Pow10(scale)));
+  return rate;
+}
+
+double FixedRate::ToDouble() const {
+  return static_cast<double>(units_) / static_cast<double>(Pow10(scale_));
+}
+
+string FixedRate::ToString() const {
+  int64_t magnitude = units_ < 0 ? -units_ : units_;
+  string text = units_ < 0 ? "-" : "";
+  text += std::to_string(magnitude / Pow10(scale_));
+  if (scale_ == 0) {
+    return text;
+  }
+
+  string fraction = std::to_string(magnitude % Pow10(scale_));
+  fraction.insert(0, static_cast<size_t>(scale_) - fraction.size(), '0');
+
+  size_t keep = fraction.size();
+  size_t min_digits = std::min<size_t>(4, fraction.size());
+  while (keep > min_digits && fraction[keep - 1] == '0') {
+    --keep;
+  }
+  text.push_back('.');
+  text.append(fraction, 0, keep);
+  return text;
+}
+
+FixedRate FixedRate::Inverse() const {
+  if (units_ == 0) {
+    throw InvalidRateException("Cannot invert a zero rate");
+  }
+
+  // 10^(scale + kMaxScale) / units, rounded half away from zero. At the
+  // input scale a rate above 10^scale would invert to zero.
+  int64_t numerator = Pow10(scale_ + kMaxScale);
+  int64_t magnitude = units_ < 0 ? -units_ : units_;
+  int64_t quotient = numerator / magnitude;
+  if ((numerator % magnitude) * 2 >= magnitude) {
+    ++quotient;
+  }
+  return FixedRate(units_ < 0 ? -quotient : quotient, kMaxScale);
+}
+
+bool FixedRate::operator==(const FixedRate& other) const {
+  if (scale_ == other.scale_) {
+    return units_ == other.units_;
+  }
+  return units_ / Pow10(scale_) == other.units_ / Pow10(other.scale_) &&
+         NormalizedFraction(units_, scale_) ==
+             NormalizedFraction(other.units_, other.scale_);
+}
+
+bool FixedRate::operator<(const FixedRate& other) const {
+  if (scale_ == other.scale_) {
+    return units_ < other.units_;
+  }
+  int64_t whole = units_ / Pow10(scale_);
+  int64_t other_whole = other.units_ / Pow10(other.scale_);
+  if (whole != other_whole) {
+    return whole < other_whole;
+  }
+  return NormalizedFraction(units_, scale_) <
+         NormalizedFraction(other.units_, other.scale_);
+}
@@ -0,0 +1,123 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rate_dataset_generator.h"
+
+using std::cerr;
+using std::cout;
+using std::invalid_argument;
+using std::string;
+using std::vector;
+
+namespace {
+
+void PrintUsage() {
+  cerr << "Usage: currency_rate_generator [OPTION...]\n"
+       << "  --output FILE         write to FILE instead of stdout\n"
+       << "  --seed N              random seed (default 1)\n"
+       << "  --pairs N             currency pairs (default 20)\n"
+       << "  --from YYYY.MM.DD     first date (default 2000.01.01)\n"
+       << "  --to YYYY.MM.DD       last date (default 2023.12.31)\n"
+       << "  --records N           lines to write (default: one per pair "
+       << "and day)\n"
+       << "  --volatility X        largest relative step (default 0.01)\n"
+       << "  --quoted X            share of quoted multi-word names\n"
+       << "  --malformed X         share of malformed lines\n"
+       << "  --order ORDER         date, currency or shuffled\n"
+       << "  --shuffle-window N    lines shuffled together (default "
+       << "1048576)\n"
+       << "Example: currency_rate_generator --pairs 100 --records 100000000 "
+       << "--malformed 0.001 --output rates.txt\n";
+}
+
+const string& NextValue(const vector<string>& args, size_t* i) {
+  if (*i + 1 >= args.size()) {
+    throw invalid_argument("Missing value for " + args[*i]);
+  }
+  return args[++*i];
+}
+
+DatasetOrder ParseOrder(const string& name) {
+  if (name == "date") return DatasetOrder::kDate;
+  if (name == "currency") return DatasetOrder::kCurrency;
+  if (name == "shuffled") return DatasetOrder::kShuffled;
+  throw invalid_argument("Unknown order: " + name);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  vector<string> args(argv + 1, argv + argc);
+  DatasetOptions options;
+  string output;
+
+  try {
+    for (size_t i = 0; i < args.size(); ++i) {
+      const string& arg = args[i];
+      if (arg == "--output") {
+        output = NextValue(args, &i);
+      } else if (arg == "--seed") {
+        options.seed = std::stoull(NextValue(args, &i));
+      } else if (arg == "--pairs") {
+        options.pair_count = std::stoul(NextValue(args, &i));
+      } else if (arg == "--from") {
+        options.first_date = NextValue(args, &i);
+      } else if (arg == "--to") {
+        options.last_date = NextValue(args, &i);
+      } else if (arg == "--records") {
+        options.records = std::stoull(NextValue(args, &i));
+      } else if (arg == "--volatility") {
+        options.volatility = std::stod(NextValue(args, &i));
+      } else if (arg == "--quoted") {
+        options.quoted_fraction = std::stod(NextValue(args, &i));
+      } else if (arg == "--malformed") {
+        options.malformed_fraction = std::stod(NextValue(args, &i));
+      } else if (arg == "--order") {
+        options.order = ParseOrder(NextValue(args, &i));
+      } else if (arg == "--shuffle-window") {
+        options.shuffle_window = std::stoul(NextValue(args, &i));
+      } else if (arg == "--help" || arg == "-h") {
+        PrintUsage();
+        return 0;
+      } else {
+        throw invalid_argument("Unknown option: " + arg);
+      }
+    }
+  } catch (const std::exception& e) {
+    cerr << "Error: " << e.what() << '\n';
+    PrintUsage();
+    return 1;
+  }
+
+  try {
+    RateDatasetGenerator generator(options);
+    auto start = std::chrono::steady_clock::now();
+
+    DatasetStats stats;
+    if (output.empty()) {
+      std::ios::sync_with_stdio(false);
+      stats = generator.Write(cout);
+      cout.flush();
+    } else {
+      stats = generator.WriteFile(output);
+    }
+
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    cerr << "Wrote " << stats.lines << " lines (" << stats.malformed
+         << " malformed, " << stats.bytes << " bytes) in " << seconds
+         << " s\n";
+  } catch (const std::exception& e) {
+    cerr << "Error: " << e.what() << '\n';
+    return 2;
+  }
+
+  return 0;
+}
@@ -13,10 +13,14 @@
 #include <string>
 #include <vector>
 
+#include "batch_cli.h"
 #include "currency_rate.h"
+#include "currency_rate_cache.h"
+#include "currency_rate_filter.h"
 #include "currency_rate_parser.h"
 #include "currency_rate_repository.h"
 #include "currency_rate_validator.h"
+#include "rate_format.h"
 
 using std::cin;
 using std::cout;
@@ -30,7 +34,6 @@ using std::move;
 using std::ostringstream;
 using std::setprecision;
 using std::shared_ptr;
-using std::stod;
 using std::stoi;
 using std::string;
 using std::to_string;
@@ -39,22 +42,40 @@ using std::vector;
 
 namespace {
 
-bool ShowAllRates(shared_ptr<ICurrencyRateRepository> repository) {
+// Records printed before the listing asks whether to go on.
+constexpr size_t kPageSize = 20;
+
+bool ShowAllRates(shared_ptr<MemoryCurrencyRateRepository> storage) {
   cout << "\n=== All Currency Rates ===" << endl;
-  auto rates = repository->GetAll();
+  size_t total = storage->Count();
 
-  if (rates.empty()) {
+  if (total == 0) {
     cout << "No data to display." << endl;
-  } else {
-    cout << "Total records: " << rates.size() << endl;
-    cout << "----------------------------------------" << endl;
-    for (const auto& rate : rates) {
-      cout << "Currency 1: " << rate.currency1() << endl;
-      cout << "Currency 2: " << rate.currency2() << endl;
-      cout << std::fixed << setprecision(4)
-           << "Rate: " << rate.rate() << endl;
-      cout << "Date: " << rate.date() << endl;
-      cout << "----------------------------------------" << endl;
+    return true;
+  }
+
+  cout << "Total records: " << total << endl;
+  cout << "----------------------------------------" << endl;
+  // One lazy pass: each page only reads the records it shows.
+  RateQueryRange rates = storage->QueryRange(FilterExpression());
+  size_t shown = 0;
+  for (auto it = rates.begin(); it != rates.end();) {
+    const CurrencyRate& rate = *it;
+    cout << "Currency 1: " << rate.currency1() << '\n';
+    cout << "Currency 2: " << rate.currency2() << '\n';
+    cout << std::fixed << setprecision(4)
+         << "Rate: " << rate.rate() << '\n';
+    cout << "Date: " << rate.date() << '\n';
+    cout << "----------------------------------------" << '\n';
+
+    ++it;
+    if (++shown % kPageSize == 0 && it != rates.end()) {
+      cout << "Shown " << shown << " of " << total
+           << ". Press Enter for more or q to stop: ";
+      string answer;
+      if (!getline(cin, answer) || answer == "q" || answer == "Q") {
+        break;
+      }
     }
   }
   return true;
@@ -75,7 +96,7 @@ bool SortByDateMenu(shared_ptr<ICurrencyRateRepository> repository) {
   for (const auto& rate : sorted_rates) {
     cout << "Date: " << rate.date()
          << " | " << rate.currency1() << "/" << rate.currency2()
-         << " = " << std::fixed << setprecision(4) << rate.rate() << endl;
+         << " = " << std::fixed << setprecision(4) << rate.rate() << '\n';
   }
   return true;
 }
@@ -95,15 +116,14 @@ bool SortByCurrencyMenu(shared_ptr<ICurrencyRateRepository> repository) {
   for (const auto& rate : sorted_rates) {
     cout << rate.currency1() << "/" << rate.currency2()
          << " | " << std::fixed << setprecision(4) << rate.rate()
-         << " | " << rate.date() << endl;
+         << " | " << rate.date() << '\n';
   }
   return true;
 }
 
-bool FilterByCurrencyMenu(shared_ptr<ICurrencyRateRepository> repository) {
-  auto rates = repository->GetAll();
-
-  if (rates.empty()) {
+bool FilterByCurrencyMenu(
+    shared_ptr<CachingCurrencyRateRepository> repository) {
+  if (repository->Count() == 0) {
     cout << "No data to filter." << endl;
     return true;
   }
@@ -117,13 +137,9 @@ bool FilterByCurrencyMenu(shared_ptr<ICurrencyRateRepository> repository) {
     return true;
   }
 
-  vector<CurrencyRate> filtered;
-  for (const auto& rate : rates) {
-    if (rate.currency1() == currency_filter ||
-        rate.currency2() == currency_filter) {
-      filtered.push_back(rate);
-    }
-  }
+  CachingCurrencyRateRepository::SharedRates shared =
+      repository->SharedFilterByCurrency(currency_filter);
+  const vector<CurrencyRate>& filtered = *shared;
 
   cout << "\n=== Data for currency '" << currency_filter << "' ===" << endl;
   cout << "Found records: " << filtered.size() << endl;
@@ -134,16 +150,14 @@ bool FilterByCurrencyMenu(shared_ptr<ICurrencyRateRepository> repository) {
     for (const auto& data : filtered) {
       cout << data.currency1() << "/" << data.currency2()
            << " | " << std::fixed << setprecision(4) << data.rate()
-           << " | " << data.date() << endl;
+           << " | " << data.date() << '\n';
     }
   }
   return true;
 }
 
-bool FilterByDateMenu(shared_ptr<ICurrencyRateRepository> repository) {
-  auto rates = repository->GetAll();
-
-  if (rates.empty()) {
+bool FilterByDateMenu(shared_ptr<CachingCurrencyRateRepository> repository) {
+  if (repository->Count() == 0) {
     cout << "No data to filter." << endl;
     return true;
   }
@@ -159,12 +173,9 @@ bool FilterByDateMenu(shared_ptr<ICurrencyRateRepository> repository) {
     return true;
   }
 
-  vector<CurrencyRate> filtered;
-  for (const auto& rate : rates) {
-    if (rate.date() == date_filter) {
-      filtered.push_back(rate);
-    }
-  }
+  CachingCurrencyRateRepository::SharedRates shared =
+      repository->SharedFilterByDate(date_filter);
+  const vector<CurrencyRate>& filtered = *shared;
 
   cout << "\n=== Data for date '" << date_filter << "' ===" << endl;
   cout << "Found records: " << filtered.size() << endl;
@@ -174,12 +185,42 @@ bool FilterByDateMenu(shared_ptr<ICurrencyRateRepository> repository) {
   } else {
     for (const auto& data : filtered) {
       cout << data.currency1() << "/" << data.currency2()
-           << " = " << std::fixed << setprecision(4) << data.rate() << endl;
+           << " = " << std::fixed << setprecision(4) << data.rate() << '\n';
     }
   }
   return true;
 }
 
+bool FilterByExpressionMenu(shared_ptr<MemoryCurrencyRateRepository> storage) {
+  if (storage->Count() == 0) {
+    cout << "No data to filter." << endl;
+    return true;
+  }
+
+  string expression;
+  cout << "Enter filter (e.g., pair in (USD/EUR, USD/JPY) and "
+       << "date >= 2023.01.01 and rate > 1.1): ";
+  getline(cin, expression);
+
+  vector<CurrencyRate> filtered;
+  try {
+    filtered = storage->Query(FilterExpression::Parse(expression));
+  } catch (const CurrencyRateException& e) {
+    cout << "Error: " << e.what() << endl;
+    return true;
+  }
+
+  cout << "\n=== Data for filter '" << expression << "' ===" << endl;
+  cout << "Found records: " << filtered.size() << endl;
+
+  for (const auto& data : filtered) {
+    cout << data.currency1() << "/" << data.currency2()
+         << " | " << std::fixed << setprecision(4) << data.rate()
+         << " | " << data.date() << '\n';
+  }
+  return true;
+}
+
 string ReadString(const string& prompt, bool required = true) {
   string value;
   while (true) {
@@ -209,19 +250,16 @@ double ReadRate() {
   while (true) {
     string input = ReadString("Enter exchange rate: ", true);
 
-    try {
-      value = stod(input);
-
-      try {
-        CurrencyRateValidator::ValidateRate(value);
-        break;
-      } catch (const CurrencyRateException& e) {
-        cout << "Error: " << e.what() << endl;
-      }
-    } catch (const std::invalid_argument&) {
+    if (!RateFormat::Parse(input, &value)) {
       cout << "Error: enter a valid numeric value!" << endl;
-    } catch (const std::out_of_range&) {
-      cout << "Error: number out of valid range!" << endl;
+      continue;
+    }
+
+    try {
+      CurrencyRateValidator::ValidateRate(value);
+      break;
+    } catch (const CurrencyRateException& e) {
+      cout << "Error: " << e.what() << endl;
     }
   }
   return value;
@@ -243,6 +281,7 @@ string ReadDate() {
 }
 
 bool AddManualData(shared_ptr<ICurrencyRateRepository> repository,
+                   shared_ptr<MemoryCurrencyRateRepository> storage,
                    const string& filename) {
   cout << "\n=== Manual Data Entry ===" << endl;
 
@@ -258,12 +297,7 @@ bool AddManualData(shared_ptr<ICurrencyRateRepository> repository,
 
     CurrencyRate new_data(currency1, currency2, rate, date);
     repository->Add(new_data);
-
-    auto memory_repo = std::dynamic_pointer_cast<MemoryCurrencyRateRepository>(
-        repository);
-    if (memory_repo) {
-      memory_repo->AppendToFile(filename, new_data);
-    }
+    storage->AppendToFile(filename, new_data);
 
     cout << "\nData successfully added!" << endl;
     cout << "Currency 1: " << new_data.currency1() << endl;
@@ -281,7 +315,7 @@ bool AddManualData(shared_ptr<ICurrencyRateRepository> repository,
   return true;
 }
 
-bool SaveToFileMenu(shared_ptr<ICurrencyRateRepository> repository) {
+bool SaveToFileMenu(shared_ptr<MemoryCurrencyRateRepository> storage) {
   string filename;
   cout << "Enter filename to save: ";
   getline(cin, filename);
@@ -292,14 +326,8 @@ bool SaveToFileMenu(shared_ptr<ICurrencyRateRepository> repository) {
   }
 
   try {
-    auto memory_repo = std::dynamic_pointer_cast<MemoryCurrencyRateRepository>(
-        repository);
-    if (memory_repo) {
-      memory_repo->SaveToFile(filename);
-      cout << "Data successfully saved to file: " << filename << endl;
-    } else {
-      cout << "Error: operation not supported" << endl;
-    }
+    storage->SaveToFile(filename);
+    cout << "Data successfully saved to file: " << filename << endl;
   } catch (const std::exception& e) {
     cout << "Error saving file: " << e.what() << endl;
   }
@@ -314,8 +342,13 @@ bool ExitProgram(shared_ptr<ICurrencyRateRepository> repository) {
 
 }  // namespace
 
-int main() {
+int main(int argc, char** argv) {
   setlocale(LC_ALL, "en_US.UTF-8");
+
+  if (argc > 1) {
+    return BatchCommandLine::Main(argc, argv);
+  }
+
   cout << "=== Currency Rate Manager ===" << endl;
 
   string filename;
@@ -329,10 +362,11 @@ int main() {
   }
 
   auto parser = make_unique<RegexCurrencyRateParser>();
-  auto repository = make_shared<MemoryCurrencyRateRepository>(move(parser));
+  auto storage = make_shared<MemoryCurrencyRateRepository>(move(parser));
+  auto repository = make_shared<CachingCurrencyRateRepository>(storage);
 
   try {
-    repository->AddFromFile(filename);
+    storage->AddFromFile(filename);
     cout << "Successfully loaded records from file: "
          << repository->Count() << endl;
   } catch (const std::exception& e) {
@@ -344,14 +378,15 @@ int main() {
   bool should_continue = true;
 
   const map<int, function<bool()>> menu_functions = {
-    {1, [&]() { return ShowAllRates(repository); }},
+    {1, [&]() { return ShowAllRates(storage); }},
     {2, [&]() { return SortByDateMenu(repository); }},
     {3, [&]() { return SortByCurrencyMenu(repository); }},
     {4, [&]() { return FilterByCurrencyMenu(repository); }},
     {5, [&]() { return FilterByDateMenu(repository); }},
-    {6, [&]() { return AddManualData(repository, filename); }},
-    {7, [&]() { return SaveToFileMenu(repository); }},
-    {8, [&]() { return ExitProgram(repository); }}
+    {6, [&]() { return FilterByExpressionMenu(storage); }},
+    {7, [&]() { return AddManualData(repository, storage, filename); }},
+    {8, [&]() { return SaveToFileMenu(storage); }},
+    {9, [&]() { return ExitProgram(repository); }}
   };
 
   do {
@@ -361,16 +396,17 @@ int main() {
     cout << "3. Sort by currency" << endl;
     cout << "4. Filter by currency" << endl;
     cout << "5. Filter by date" << endl;
-    cout << "6. Add rate manually" << endl;
-    cout << "7. Save to file" << endl;
-    cout << "8. Exit" << endl;
+    cout << "6. Filter by expression" << endl;
+    cout << "7. Add rate manually" << endl;
+    cout << "8. Save to file" << endl;
+    cout << "9. Exit" << endl;
     cout << "Choose action: ";
 
     string input;
     getline(cin, input);
 
     if (input.empty()) {
-      cout << "Error: enter a number from 1 to 8!" << endl;
+      cout << "Error: enter a number from 1 to 9!" << endl;
       continue;
     }
 
@@ -380,7 +416,7 @@ int main() {
       if (menu_functions.find(choice) != menu_functions.end()) {
         should_continue = menu_functions.at(choice)();
       } else {
-        cout << "Error: invalid menu item! Choose from 1 to 8." << endl;
+        cout << "Error: invalid menu item! Choose from 1 to 9." << endl;
       }
     } catch (const std::invalid_argument&) {
       cout << "Error: enter a valid number!" << endl;
@@ -0,0 +1,83 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "parallel_executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "currency_rate_trace.h"
+
+using std::atomic;
+using std::exception_ptr;
+using std::function;
+using std::lock_guard;
+using std::mutex;
+using std::thread;
+using std::vector;
+
+size_t ParallelExecutor::DefaultThreadCount() {
+  size_t count = thread::hardware_concurrency();
+  return count == 0 ? 1 : count;
+}
+
+void ParallelExecutor::For(size_t count, size_t max_threads,
+                           const function<void(size_t)>& body) {
+  if (count == 0) {
+    return;
+  }
+
+  size_t thread_count = max_threads == 0 ? DefaultThreadCount() : max_threads;
+  thread_count = std::min(thread_count, count);
+
+  if (thread_count == 1) {
+    for (size_t i = 0; i < count; ++i) {
+      body(i);
+    }
+    return;
+  }
+
+  atomic<size_t> next_index(0);
+  mutex error_mutex;
+  exception_ptr first_error;
+
+  auto worker = [&]() {
+    while (true) {
+      size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+      if (index >= count) {
+        return;
+      }
+      try {
+        body(index);
+      } catch (...) {
+        lock_guard<mutex> lock(error_mutex);
+        if (!first_error) {
+          first_error = std::current_exception();
+        }
+        next_index.store(count, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  vector<thread> workers;
+  workers.reserve(thread_count - 1);
+  for (size_t i = 1; i < thread_count; ++i) {
+    workers.emplace_back([&worker]() {
+      TraceRecorder::SetThreadName("parallel worker");
+      worker();
+    });
+  }
+  worker();
+  for (auto& t : workers) {
+    t.join();
+  }
+
+  if (first_error) {
+    std::rethrow_exception(first_error);
+  }
+}
@@ -0,0 +1,347 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "rate_dataset_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#include "currency_date.h"
+#include "currency_rate_validator.h"
+#include "rate_format.h"
+
+using std::invalid_argument;
+using std::move;
+using std::ofstream;
+using std::ostream;
+using std::runtime_error;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace {
+
+constexpr size_t kBlockSize = 1 << 20;
+constexpr double kMinRate = 0.001;
+constexpr double kMaxRate = 100000.0;
+constexpr int kMalformedKinds = 5;
+
+struct Currency {
+  const char* code;
+  const char* name;
+};
+
+const Currency kCurrencies[] = {
+    {"USD", "US Dollar"},         {"EUR", "Euro"},
+    {"JPY", "Japanese Yen"},      {"GBP", "Pound Sterling"},
+    {"CHF", "Swiss Franc"},       {"CAD", "Canadian Dollar"},
+    {"AUD", "Australian Dollar"}, {"NZD", "New Zealand Dollar"},
+    {"SEK", "Swedish Krona"},     {"NOK", "Norwegian Krone"},
+    {"DKK", "Danish Krone"},      {"PLN", "Polish Zloty"},
+    {"CZK", "Czech Koruna"},      {"HUF", "Hungarian Forint"},
+    {"CNY", "Chinese Yuan"},      {"HKD", "Hong Kong Dollar"},
+    {"SGD", "Singapore Dollar"},  {"KRW", "South Korean Won"},
+    {"INR", "Indian Rupee"},      {"BRL", "Brazilian Real"},
+    {"MXN", "Mexican Peso"},      {"ZAR", "South African Rand"},
+    {"TRY", "Turkish Lira"},      {"RUB", "Russian Ruble"},
+};
+constexpr size_t kKnownCurrencies =
+    sizeof(kCurrencies) / sizeof(kCurrencies[0]);
+
+// SplitMix64: eight bytes of state per pair, so millions of pairs fit.
+class SplitMix {
+public:
+  explicit SplitMix(uint64_t seed) : state_(seed) {}
+
+  uint64_t Next() {
+    uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [0, 1).
+  double NextUnit() { return static_cast<double>(Next() >> 11) * 0x1.0p-53; }
+
+private:
+  uint64_t state_;
+};
+
+// Currency |index| of the pool: known codes first, then C<index>.
+void AppendCurrency(size_t index, bool quoted, string* out) {
+  if (index < kKnownCurrencies) {
+    if (quoted) {
+      out->push_back('"');
+      out->append(kCurrencies[index].name);
+      out->push_back('"');
+    } else {
+      out->append(kCurrencies[index].code);
+    }
+    return;
+  }
+
+  string number = std::to_string(index);
+  if (quoted) {
+    out->append("\"Currency ").append(number).push_back('"');
+  } else {
+    out->append("C").append(number);
+  }
+}
+
+struct PairState {
+  SplitMix random;
+  size_t currency1 = 0;
+  size_t currency2 = 0;
+  double rate = 1.0;
+
+  PairState(uint64_t seed, size_t pair)
+      : random(SplitMix(seed + pair * 0x632BE59BD9B4E019ULL).Next()) {
+    // Pairs enumerate (i, j), i < j, ordered by j, so a small pair count
+    // uses the major currencies only.
+    size_t j = static_cast<size_t>((1.0 + std::sqrt(1.0 + 8.0 * pair)) / 2.0);
+    while (j * (j - 1) / 2 > pair) {
+      --j;
+    }
+    while ((j + 1) * j / 2 <= pair) {
+      ++j;
+    }
+    size_t i = pair - j * (j - 1) / 2;
+    bool swap = random.Next() & 1;
+    currency1 = swap ? j : i;
+    currency2 = swap ? i : j;
+    rate = std::pow(10.0, random.NextUnit() * 5.0 - 2.0);
+  }
+};
+
+class LineWriter {
+public:
+  LineWriter(const DatasetOptions& options, const vector<string>& dates)
+      : options_(options), dates_(dates) {}
+
+  // Appends the next quote of |pair| on day |day_index| of the span.
+  void Append(PairState* pair, size_t day_index, string* out,
+              DatasetStats* stats) const {
+    SplitMix& random = pair->random;
+    double step = options_.volatility * (2.0 * random.NextUnit() - 1.0);
+    double next = pair->rate * (1.0 + step);
+    pair->rate = next < kMinRate || next > kMaxRate ? pair->rate * (1.0 - step)
+                                                    : next;
+    bool quoted = random.NextUnit() < options_.quoted_fraction;
+    bool malformed = random.NextUnit() < options_.malformed_fraction;
+    const string& date = dates_[day_index];
+
+    size_t start = out->size();
+    AppendCurrency(pair->currency1, quoted, out);
+    out->push_back(' ');
+    AppendCurrency(pair->currency2, quoted, out);
+    out->push_back(' ');
+
+    if (!malformed) {
+      RateFormat::AppendFixed(pair->rate, RateFormat::kDisplayDecimals, out);
+      out->append(" ").append(date).push_back('\n');
+    } else {
+      ++stats->malformed;
+      switch (random.Next() % kMalformedKinds) {
+        case 0:  // missing date
+          RateFormat::AppendFixed(pair->rate, RateFormat::kDisplayDecimals,
+                                  out);
+          break;
+        case 1:  // rate is not a number
+          out->append("n/a ").append(date);
+          break;
+        case 2:  // date separators
+          RateFormat::AppendFixed(pair->rate, RateFormat::kDisplayDecimals,
+                                  out);
+          out->append(" ").append(date.substr(0, 4)).append("/")
+              .append(date.substr(5, 2)).append("/").append(date.substr(8));
+          break;
+        case 3:  // day out of range
+          RateFormat::AppendFixed(pair->rate, RateFormat::kDisplayDecimals,
+                                  out);
+          out->append(" ").append(date.substr(0, 8)).append("32");
+          break;
+        default:  // unterminated quote
+          if (quoted) {
+            out->erase(out->size() - 2, 1);
+          } else {
+            out->insert(start, 1, '"');
+          }
+          RateFormat::AppendFixed(pair->rate, RateFormat::kDisplayDecimals,
+                                  out);
+          out->append(" ").append(date);
+          break;
+      }
+      out->push_back('\n');
+    }
+
+    ++stats->lines;
+    stats->bytes += out->size() - start;
+  }
+
+private:
+  const DatasetOptions& options_;
+  const vector<string>& dates_;
+};
+
+}  // namespace
+
+RateDatasetGenerator::RateDatasetGenerator(DatasetOptions options)
+    : options_(move(options)) {
+  if (options_.pair_count == 0) {
+    throw invalid_argument("Pair count must be positive");
+  }
+  for (const string* date : {&options_.first_date, &options_.last_date}) {
+    if (!CurrencyRateValidator::IsValidDate(*date)) {
+      throw invalid_argument("Invalid or future date: " + *date);
+    }
+  }
+  first_day_ = CurrencyDate::ToDayNumber(options_.first_date);
+  day_count_ = CurrencyDate::ToDayNumber(options_.last_date) - first_day_ + 1;
+  if (day_count_ <= 0) {
+    throw invalid_argument("First date is after last date");
+  }
+  for (double fraction : {options_.quoted_fraction,
+                          options_.malformed_fraction}) {
+    if (!(fraction >= 0.0 && fraction <= 1.0)) {
+      throw invalid_argument("Fractions must be between 0 and 1");
+    }
+  }
+  if (!(options_.volatility >= 0.0 && options_.volatility < 1.0)) {
+    throw invalid_argument("Volatility must be in [0, 1)");
+  }
+  if (options_.order == DatasetOrder::kShuffled &&
+      options_.shuffle_window == 0) {
+    throw invalid_argument("Shuffle window must be positive");
+  }
+}
+
+uint64_t RateDatasetGenerator::LineCount() const {
+  return options_.records != 0
+             ? options_.records
+             : static_cast<uint64_t>(options_.pair_count) * day_count_;
+}
+
+DatasetStats RateDatasetGenerator::Generate(const BlockSink& sink) const {
+  const uint64_t pairs = options_.pair_count;
+  const uint64_t total = LineCount();
+  const uint64_t steps = (total + pairs - 1) / pairs;
+
+  vector<string> dates(static_cast<size_t>(day_count_));
+  for (int i = 0; i < day_count_; ++i) {
+    dates[i] = CurrencyDate::FromDayNumber(first_day_ + i);
+  }
+  vector<PairState> states;
+  states.reserve(options_.pair_count);
+  for (size_t pair = 0; pair < options_.pair_count; ++pair) {
+    states.emplace_back(options_.seed, pair);
+  }
+
+  DatasetStats stats;
+  LineWriter writer(options_, dates);
+  string block;
+  block.reserve(kBlockSize + 256);
+
+  // Shuffled order keeps a window of lines and their offsets.
+  SplitMix shuffle_random(options_.seed ^ 0x5DEECE66DULL);
+  vector<size_t> offsets;
+  vector<size_t> order;
+  string shuffled;
+
+  auto flush_window = [&]() {
+    order.resize(offsets.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    for (size_t i = order.size(); i > 1; --i) {
+      std::swap(order[i - 1], order[shuffle_random.Next() % i]);
+    }
+    for (size_t index : order) {
+      size_t end = index + 1 < offsets.size() ? offsets[index + 1]
+                                                : block.size();
+      shuffled.append(block, offsets[index], end - offsets[index]);
+      if (shuffled.size() >= kBlockSize) {
+        sink(shuffled);
+        shuffled.clear();
+      }
+    }
+    offsets.clear();
+    block.clear();
+  };
+
+  auto emit = [&](uint64_t step, size_t pair) {
+    size_t day = static_cast<size_t>(step * day_count_ / steps);
+    if (options_.order == DatasetOrder::kShuffled) {
+      offsets.push_back(block.size());
+      writer.Append(&states[pair], day, &block, &stats);
+      if (offsets.size() >= options_.shuffle_window) {
+        flush_window();
+      }
+      return;
+    }
+    writer.Append(&states[pair], day, &block, &stats);
+    if (block.size() >= kBlockSize) {
+      sink(block);
+      block.clear();
+    }
+  };
+
+  if (options_.order == DatasetOrder::kCurrency) {
+    for (size_t pair = 0; pair < pairs; ++pair) {
+      for (uint64_t step = 0; step < steps && step * pairs + pair < total;
+           ++step) {
+        emit(step, pair);
+      }
+    }
+  } else {
+    for (uint64_t step = 0; step < steps; ++step) {
+      for (size_t pair = 0; pair < pairs && step * pairs + pair < total;
+           ++pair) {
+        emit(step, pair);
+      }
+    }
+  }
+
+  if (options_.order == DatasetOrder::kShuffled) {
+    flush_window();
+    block.swap(shuffled);
+  }
+  if (!block.empty()) {
+    sink(block);
+  }
+  return stats;
+}
+
+DatasetStats RateDatasetGenerator::Write(ostream& out) const {
+  return Generate([&out](string_view block) {
+    out.write(block.data(), static_cast<std::streamsize>(block.size()));
+  });
+}
+
+DatasetStats RateDatasetGenerator::WriteFile(const string& filename) const {
+  ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw runtime_error("Failed to open file for writing: " + filename);
+  }
+  DatasetStats stats = Write(file);
+  file.close();
+  if (!file) {
+    throw runtime_error("Failed to write file: " + filename);
+  }
+  return stats;
+}
+
+vector<string> RateDatasetGenerator::GenerateLines() const {
+  vector<string> lines;
+  lines.reserve(static_cast<size_t>(LineCount()));
+  Generate([&lines](string_view block) {
+    while (!block.empty()) {
+      size_t newline = block.find('\n');
+      lines.emplace_back(block.substr(0, newline));
+      block.remove_prefix(newline + 1);
+    }
+  });
+  return lines;
+}
@@ -0,0 +1,58 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+// Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
+
+#include "rate_format.h"
+
+#include <charconv>
+#include <system_error>
+
+using std::chars_format;
+using std::string;
+using std::string_view;
+
+namespace {
+
+// Fixed notation of the largest double plus sign, point and decimals.
+constexpr size_t kBufferSize = 512;
+
+}  // namespace
+
+bool RateFormat::Parse(string_view text, double* value) {
+  const char* end = text.data() + text.size();
+  auto result = std::from_chars(text.data(), end, *value);
+  return result.ec == std::errc() && result.ptr == end;
+}
+
+string RateFormat::ToFixed(double value, int decimals) {
+  string text;
+  AppendFixed(value, decimals, &text);
+  return text;
+}
+
+void RateFormat::AppendFixed(double value, int decimals, string* out) {
+  char buffer[kBufferSize];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                              chars_format::fixed, decimals);
+  out->append(buffer, result.ptr);
+}
+
+string RateFormat::ToExact(double value) {
+  string text;
+  AppendExact(value, &text);
+  return text;
+}
+
+void RateFormat::AppendExact(double value, string* out) {
+  char buffer[kBufferSize];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                              chars_format::fixed, kDisplayDecimals);
+
+  double read_back = 0.0;
+  if (!Parse(string_view(buffer, result.ptr - buffer), &read_back) ||
+      read_back != value) {
+    result = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                           chars_format::fixed);
+  }
+  out->append(buffer, result.ptr);
+}
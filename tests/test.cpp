@@ -2,15 +2,44 @@
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 // Copyright 2024 Maslakov Saveliy KI24-07B. All rights reserved.
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <memory>
+#include <sstream>
+#include <thread>
 #include <tuple>
 #include <vector>
 
+#include "batch_cli.h"
+#include "currency_date.h"
 #include "currency_rate.h"
+#include "currency_rate_cache.h"
+#include "currency_rate_conversion.h"
+#include "currency_rate_dialect.h"
+#include "currency_rate_diff.h"
+#include "currency_rate_filter.h"
+#include "currency_rate_follower.h"
+#include "currency_rate_metrics.h"
 #include "currency_rate_parser.h"
+#include "currency_rate_quantiles.h"
 #include "currency_rate_repository.h"
+#include "currency_rate_trace.h"
 #include "currency_rate_validator.h"
+#include "rate_dataset_generator.h"
+#include "rate_format.h"
+#ifdef CURRENCY_RATE_HAVE_SERVER
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "currency_rate_client.h"
+#include "currency_rate_server.h"
+#endif
 #include "gtest/gtest.h"
 
 using std::ifstream;
@@ -370,6 +399,1975 @@ TEST(CurrencyRateStaticTest, IsValidDate) {
   EXPECT_FALSE(CurrencyRate::IsValidDate(2024, 4, 31));
 }
 
+TEST(CurrencyDateTest, DayNumberRoundTrip) {
+  EXPECT_EQ(CurrencyDate::ToDayNumber("1970.01.01"), 0);
+  EXPECT_EQ(CurrencyDate::ToDayNumber("2024.01.15"), 19737);
+  EXPECT_EQ(CurrencyDate::FromDayNumber(19737), "2024.01.15");
+  EXPECT_EQ(CurrencyDate::FromDayNumber(
+      CurrencyDate::ToDayNumber("2000.02.29")), "2000.02.29");
+  EXPECT_EQ(CurrencyDate::DayOfWeek(CurrencyDate::ToDayNumber("2024.01.15")),
+            0);
+  EXPECT_THROW(CurrencyDate::ToDayNumber("2024-01-15"), InvalidDateException);
+}
+
+TEST(CurrencyRateAggregationTest, MonthlyOhlc) {
+  auto parser = make_unique<RegexCurrencyRateParser>();
+  MemoryCurrencyRateRepository repo(move(parser));
+
+  repo.Add(CurrencyRate("USD", "EUR", 0.95, "2024.01.20"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.90, "2024.01.02"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.97, "2024.01.10"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.93, "2024.02.01"));
+  repo.Add(CurrencyRate("USD", "JPY", 150.0, "2024.01.05"));
+
+  auto aggregates = repo.Aggregate({"USD", "EUR"}, {},
+                                   AggregationBucket::kMonth);
+  ASSERT_EQ(aggregates.size(), 2);
+  EXPECT_EQ(aggregates[0].bucket_start, "2024.01.01");
+  EXPECT_EQ(aggregates[0].count, 3);
+  EXPECT_DOUBLE_EQ(aggregates[0].open, 0.90);
+  EXPECT_DOUBLE_EQ(aggregates[0].close, 0.95);
+  EXPECT_DOUBLE_EQ(aggregates[0].low, 0.90);
+  EXPECT_DOUBLE_EQ(aggregates[0].high, 0.97);
+  EXPECT_NEAR(aggregates[0].mean, (0.95 + 0.90 + 0.97) / 3, 1e-12);
+  EXPECT_EQ(aggregates[1].bucket_start, "2024.02.01");
+  EXPECT_EQ(aggregates[1].count, 1);
+}
+
+TEST(CurrencyRateAggregationTest, WeeklyBucketsAndDateRange) {
+  auto parser = make_unique<RegexCurrencyRateParser>();
+  MemoryCurrencyRateRepository repo(move(parser));
+
+  repo.Add(CurrencyRate("USD", "EUR", 0.90, "2024.01.14"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.91, "2024.01.15"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.92, "2024.01.21"));
+  repo.Add(CurrencyRate("USD", "JPY", 150.0, "2024.01.16"));
+
+  auto aggregates = repo.Aggregate({}, {"2024.01.15", "2024.01.31"},
+                                   AggregationBucket::kWeek);
+  ASSERT_EQ(aggregates.size(), 2);
+  EXPECT_EQ(aggregates[0].pair, CurrencyPair("USD", "EUR"));
+  EXPECT_EQ(aggregates[0].bucket_start, "2024.01.15");
+  EXPECT_EQ(aggregates[0].count, 2);
+  EXPECT_EQ(aggregates[1].pair, CurrencyPair("USD", "JPY"));
+  EXPECT_EQ(aggregates[1].count, 1);
+}
+
+TEST(CurrencyRateRollingStatsTest, IncrementalIndicators) {
+  auto parser = make_unique<RegexCurrencyRateParser>();
+  MemoryCurrencyRateRepository repo(move(parser));
+
+  repo.Add(CurrencyRate("USD", "EUR", 1.0, "2024.01.01"));
+  repo.EnableRollingStatistics({2, 3});
+  repo.Add(CurrencyRate("USD", "EUR", 2.0, "2024.01.02"));
+  repo.Add(CurrencyRate("USD", "EUR", 4.0, "2024.01.03"));
+  repo.Add(CurrencyRate("USD", "EUR", 8.0, "2024.01.04"));
+
+  auto window2 = repo.GetRollingStatistics("USD", "EUR", 2);
+  ASSERT_TRUE(window2.has_value());
+  EXPECT_EQ(window2->count, 2);
+  EXPECT_DOUBLE_EQ(window2->sma, 6.0);
+  // Log returns are all log(2), so their deviation is zero.
+  EXPECT_NEAR(window2->volatility, 0.0, 1e-12);
+
+  auto window3 = repo.GetRollingStatistics("USD", "EUR", 3);
+  ASSERT_TRUE(window3.has_value());
+  EXPECT_DOUBLE_EQ(window3->sma, 14.0 / 3.0);
+  // EMA with alpha = 0.5: 1 -> 1.5 -> 2.75 -> 5.375.
+  EXPECT_DOUBLE_EQ(window3->ema, 5.375);
+
+  EXPECT_FALSE(repo.GetRollingStatistics("USD", "JPY", 2).has_value());
+  EXPECT_THROW(repo.GetRollingStatistics("USD", "EUR", 7), std::out_of_range);
+}
+
+TEST(CurrencyRateRollingStatsTest, VolatilityOfLogReturns) {
+  RollingWindowStatistics stats({10});
+  stats.Add(1.0);
+  stats.Add(std::exp(0.1));
+  stats.Add(std::exp(0.1) * std::exp(-0.1));
+
+  RollingIndicators indicators = stats.Get(10);
+  EXPECT_EQ(indicators.count, 3);
+  // Returns 0.1 and -0.1: sample deviation is sqrt(0.02).
+  EXPECT_NEAR(indicators.volatility, std::sqrt(0.02), 1e-12);
+  EXPECT_THROW(RollingStatisticsTracker({}), invalid_argument);
+  EXPECT_THROW(RollingStatisticsTracker({0}), invalid_argument);
+}
+
+TEST(CurrencyRateCacheTest, RepeatedQueriesHitCache) {
+  auto storage = std::make_shared<MemoryCurrencyRateRepository>(
+      make_unique<RegexCurrencyRateParser>());
+  CachingCurrencyRateRepository repo(storage);
+
+  repo.Add(CurrencyRate("USD", "EUR", 0.92, "2024.01.15"));
+  repo.Add(CurrencyRate("USD", "JPY", 150.0, "2024.01.16"));
+
+  EXPECT_EQ(repo.FilterByCurrency("USD").size(), 2);
+  EXPECT_EQ(repo.FilterByDate("2024.01.16").size(), 1);
+  auto first = repo.SharedFilterByCurrency("USD");
+  EXPECT_EQ(repo.SharedFilterByCurrency("USD"), first);
+  // Keys are not normalized, as the wrapped repository does not match
+  // untrimmed names either.
+  EXPECT_EQ(repo.FilterByCurrency(" USD ").size(),
+            storage->FilterByCurrency(" USD ").size());
+
+  QueryCacheStats stats = repo.stats();
+  EXPECT_EQ(stats.misses, 3);
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.entries, 3);
+}
+
+TEST(CurrencyRateCacheTest, ChangesBehindTheCacheInvalidateIt) {
+  string filename = "test_cache_load.txt";
+  ofstream(filename) << "USD EUR 0.92 2024.01.15\n";
+  auto storage = std::make_shared<MemoryCurrencyRateRepository>(
+      make_unique<RegexCurrencyRateParser>());
+  CachingCurrencyRateRepository repo(storage);
+
+  EXPECT_EQ(repo.FilterByCurrency("USD").size(), 0);
+  storage->AddFromFile(filename);
+  EXPECT_EQ(repo.FilterByCurrency("USD").size(), 1);
+
+  ofstream(filename, std::ios::app) << "USD JPY 150.0 2024.01.16\n";
+  storage->Refresh();
+  EXPECT_EQ(repo.FilterByCurrency("USD").size(), 2);
+  EXPECT_EQ(repo.FilterByCurrency("USD").size(), 2);
+
+  storage->AddFromFiles({filename}, 1);
+  EXPECT_EQ(repo.FilterByCurrency("USD").size(), 4);
+  EXPECT_EQ(repo.stats().hits, 1);
+  EXPECT_GE(repo.stats().invalidations, 3);
+
+  remove(filename.c_str());
+}
+
+TEST(CurrencyRateCacheTest, ConcurrentLookupsAgree) {
+  auto storage = std::make_shared<MemoryCurrencyRateRepository>(
+      make_unique<RegexCurrencyRateParser>());
+  CachingCurrencyRateRepository repo(storage, 4);
+  for (int i = 0; i < 200; ++i) {
+    repo.Add(CurrencyRate("C" + std::to_string(i % 10), "USD", 1.0 + i,
+                          "2024.01.01"));
+  }
+  // A sort rebuilds the index at once, so the first misses after it can
+  // share the repository.
+  repo.SortByCurrency();
+
+  std::atomic<int> wrong{0};
+  vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&repo, &wrong, t]() {
+      for (int i = 0; i < 500; ++i) {
+        string currency = "C" + std::to_string((i + t) % 10);
+        if (repo.SharedFilterByCurrency(currency)->size() != 20) {
+          ++wrong;
+        }
+      }
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(wrong.load(), 0);
+  QueryCacheStats stats = repo.stats();
+  EXPECT_EQ(stats.hits + stats.misses, 2000);
+  EXPECT_LE(stats.entries, 4);
+}
+
+TEST(CurrencyRateCacheTest, AddEvictsOnlyAffectedResults) {
+  auto storage = std::make_shared<MemoryCurrencyRateRepository>(
+      make_unique<RegexCurrencyRateParser>());
+  CachingCurrencyRateRepository repo(storage);
+
+  repo.Add(CurrencyRate("USD", "EUR", 0.92, "2024.01.15"));
+  repo.Add(CurrencyRate("GBP", "JPY", 190.0, "2024.01.16"));
+  repo.FilterByCurrency("EUR");
+  repo.FilterByCurrency("GBP");
+  repo.FilterByDate("2024.01.16");
+
+  repo.Add(CurrencyRate("USD", "EUR", 0.93, "2024.01.17"));
+  EXPECT_EQ(repo.stats().entries, 2);
+  EXPECT_EQ(repo.FilterByCurrency("EUR").size(), 2);
+  EXPECT_EQ(repo.FilterByCurrency("GBP").size(), 1);
+  EXPECT_EQ(repo.stats().hits, 1);
+
+  repo.SortByDate();
+  EXPECT_EQ(repo.stats().entries, 0);
+}
+
+TEST(CurrencyRateCacheTest, MemoryIsBounded) {
+  auto storage = std::make_shared<MemoryCurrencyRateRepository>(
+      make_unique<RegexCurrencyRateParser>());
+  CachingCurrencyRateRepository repo(storage, 2, 3);
+
+  repo.Add(CurrencyRate("USD", "EUR", 0.92, "2024.01.15"));
+  repo.Add(CurrencyRate("USD", "JPY", 150.0, "2024.01.15"));
+  repo.Add(CurrencyRate("GBP", "JPY", 190.0, "2024.01.16"));
+
+  repo.FilterByCurrency("USD");
+  repo.FilterByCurrency("JPY");
+  EXPECT_EQ(repo.stats().entries, 1);
+  EXPECT_LE(repo.stats().cached_records, 3);
+
+  repo.FilterByDate("2024.01.15");
+  repo.FilterByDate("2024.01.16");
+  EXPECT_EQ(repo.stats().entries, 2);
+  EXPECT_GE(repo.stats().evictions, 1);
+}
+
+TEST(CurrencyRateFilterTest, ParseExpression) {
+  FilterExpression expression = FilterExpression::Parse(
+      "pair in (USD/EUR, \"US Dollar\"/JPY) AND date >= 2023.01.01 "
+      "and rate > 1.1");
+  const auto& conditions = expression.conditions();
+  ASSERT_EQ(conditions.size(), 3);
+  EXPECT_EQ(conditions[0].field, FilterField::kPair);
+  EXPECT_EQ(conditions[0].op, FilterOperator::kIn);
+  ASSERT_EQ(conditions[0].pairs.size(), 2);
+  EXPECT_EQ(conditions[0].pairs[1], CurrencyPair("US Dollar", "JPY"));
+  EXPECT_EQ(conditions[1].field, FilterField::kDate);
+  EXPECT_EQ(conditions[1].op, FilterOperator::kGreaterEqual);
+  EXPECT_EQ(conditions[2].field, FilterField::kRate);
+  EXPECT_DOUBLE_EQ(conditions[2].number, 1.1);
+}
+
+TEST(CurrencyRateFilterTest, InvalidExpressions) {
+  EXPECT_THROW(FilterExpression::Parse(""), InvalidFilterException);
+  EXPECT_THROW(FilterExpression::Parse("color = red"), InvalidFilterException);
+  EXPECT_THROW(FilterExpression::Parse("rate > abc"), InvalidFilterException);
+  EXPECT_THROW(FilterExpression::Parse("date = 2024-01-01"),
+               InvalidFilterException);
+  EXPECT_THROW(FilterExpression::Parse("currency < USD"),
+               InvalidFilterException);
+  EXPECT_THROW(FilterExpression::Parse("pair = USD"), InvalidFilterException);
+  EXPECT_THROW(FilterExpression::Parse("currency = USD or date = 2024.01.01"),
+               InvalidFilterException);
+}
+
+TEST(CurrencyRateFilterTest, QueryRepository) {
+  auto parser = make_unique<RegexCurrencyRateParser>();
+  MemoryCurrencyRateRepository repo(move(parser));
+
+  repo.Add(CurrencyRate("USD", "EUR", 0.92, "2022.12.30"));
+  repo.Add(CurrencyRate("USD", "EUR", 1.15, "2023.01.02"));
+  repo.Add(CurrencyRate("USD", "JPY", 150.0, "2023.01.03"));
+  repo.Add(CurrencyRate("GBP", "USD", 1.25, "2023.01.04"));
+  repo.Add(CurrencyRate("EUR", "USD", 1.08, "2023.01.05"));
+
+  auto pairs = repo.Query(FilterExpression::Parse(
+      "pair in (USD/EUR, USD/JPY) and date >= 2023.01.01 and rate > 1.1"));
+  ASSERT_EQ(pairs.size(), 2);
+  EXPECT_EQ(pairs[0].date(), "2023.01.02");
+  EXPECT_EQ(pairs[1].currency2(), "JPY");
+
+  EXPECT_EQ(repo.Query(FilterExpression::Parse("currency = USD")).size(), 5);
+  EXPECT_EQ(repo.Query(FilterExpression::Parse("base = USD")).size(), 3);
+  EXPECT_EQ(repo.Query(FilterExpression::Parse(
+      "date > 2023.01.02 and date <= 2023.01.04")).size(), 2);
+  EXPECT_EQ(repo.Query(FilterExpression::Parse("rate < 1")).size(), 1);
+
+  repo.SortByCurrency();
+  auto sorted = repo.Query(FilterExpression::Parse("quote = USD"));
+  ASSERT_EQ(sorted.size(), 2);
+  EXPECT_EQ(sorted[0].currency1(), "EUR");
+  EXPECT_EQ(repo.FilterByDate("2023.01.03").size(), 1);
+  EXPECT_EQ(repo.FilterByCurrency("GBP").size(), 1);
+}
+
+TEST(CurrencyRateCanonicalPairsTest, BothDirectionsShareStorage) {
+  auto parser = make_unique<RegexCurrencyRateParser>();
+  MemoryCurrencyRateRepository repo(move(parser));
+  repo.SetCanonicalPairs(true);
+
+  repo.Add(CurrencyRate("USD", "EUR", 0.8, "2024.01.15"));
+  repo.Add(CurrencyRate("EUR", "USD", 1.25, "2024.01.15"));
+  repo.Add(CurrencyRate("EUR", "USD", 1.2, "2024.01.16"));
+
+  EXPECT_EQ(repo.Count(), 2);
+  EXPECT_EQ(repo.canonical_duplicates(), 1);
+  auto stored = repo.GetAll();
+  EXPECT_EQ(stored[0].currency1(), "EUR");
+  EXPECT_DOUBLE_EQ(stored[0].rate(), 1.25);
+
+  EXPECT_DOUBLE_EQ(*repo.GetRate("USD", "EUR", "2024.01.16"), 1.0 / 1.2);
+  EXPECT_DOUBLE_EQ(*repo.GetRate("EUR", "USD", "2024.01.16"), 1.2);
+  EXPECT_FALSE(repo.GetRate("USD", "EUR", "2024.01.17").has_value());
+  EXPECT_EQ(repo.FilterByCurrency("USD").size(), 2);
+
+  auto usd_eur = repo.Query(FilterExpression::Parse(
+      "pair = USD/EUR and rate < 0.81"));
+  ASSERT_EQ(usd_eur.size(), 1);
+  EXPECT_EQ(usd_eur[0].currency1(), "USD");
+  EXPECT_EQ(usd_eur[0].date(), "2024.01.15");
+}
+
+TEST(CurrencyRateCanonicalPairsTest, EnablingNormalizesExistingRates) {
+  auto parser = make_unique<RegexCurrencyRateParser>();
+  MemoryCurrencyRateRepository repo(move(parser));
+
+  repo.Add(CurrencyRate("USD", "EUR", 0.8, "2024.01.15"));
+  repo.Add(CurrencyRate("EUR", "USD", 1.25, "2024.01.15"));
+  EXPECT_EQ(repo.Count(), 2);
+  EXPECT_DOUBLE_EQ(*repo.GetRate("USD", "EUR", "2024.01.15"), 0.8);
+
+  repo.SetCanonicalPairs(true);
+  EXPECT_EQ(repo.Count(), 1);
+  EXPECT_EQ(repo.GetAll()[0].currency1(), "EUR");
+  EXPECT_NEAR(*repo.GetRate("USD", "EUR", "2024.01.15"), 0.8, 1e-12);
+}
+
+TEST(BatchCommandLineTest, ParseOptions) {
+  BatchOptions options = BatchCommandLine::Parse(
+      {"--load", "a.txt", "--load", "b.txt", "--sort", "date", "--filter",
+       "currency = USD", "--aggregate", "month"});
+  EXPECT_EQ(options.load_files, vector<string>({"a.txt", "b.txt"}));
+  EXPECT_EQ(options.sort, "date");
+  EXPECT_EQ(options.filter, "currency = USD");
+  EXPECT_TRUE(options.aggregate);
+  EXPECT_EQ(options.bucket, AggregationBucket::kMonth);
+  options = BatchCommandLine::Parse({"--export", "out.txt"});
+  EXPECT_EQ(options.export_file, "out.txt");
+  EXPECT_THROW(BatchCommandLine::Parse({"--aggregate", "month", "--export",
+                                        "out.txt"}),
+               invalid_argument);
+  for (const vector<string>& conflict : vector<vector<string>>{
+           {"--export", "out.txt", "--resample", "2024.01.01", "2024.01.31"},
+           {"--arbitrage", "0.01", "--export", "out.txt"},
+           {"--export", "out.txt", "--convert", "1", "USD", "EUR",
+            "2024.01.15"},
+           {"--diff", "a.txt", "b.txt", "--load", "c.txt"},
+           {"--load-dir", "rates", "--diff", "a.txt", "b.txt"},
+           {"--diff", "a.txt", "b.txt", "--filter", "currency = USD"},
+           {"--diff", "a.txt", "b.txt", "--latest", "5"},
+           {"--follow"},
+           {"--load", "a.txt", "--threads", "2"},
+           {"--append-log", "log.txt"}}) {
+    EXPECT_THROW(BatchCommandLine::Parse(conflict), invalid_argument)
+        << conflict[0];
+  }
+#ifdef CURRENCY_RATE_HAVE_SERVER
+  options = BatchCommandLine::Parse({"--threads", "2", "--serve", "s.sock",
+                                     "--follow"});
+  EXPECT_EQ(options.server_threads, 2);
+  EXPECT_TRUE(options.follow);
+#endif
+
+  EXPECT_THROW(BatchCommandLine::Parse({"--load"}), invalid_argument);
+  EXPECT_THROW(BatchCommandLine::Parse({"--sort", "rate"}), invalid_argument);
+  EXPECT_THROW(BatchCommandLine::Parse({"--convert", "x", "USD", "EUR",
+                                        "2024.01.15"}),
+               invalid_argument);
+  EXPECT_THROW(BatchCommandLine::Parse({"--bogus"}), invalid_argument);
+}
+
+TEST(BatchCommandLineTest, RunFilterSortAndConvert) {
+  ofstream test_file("test_batch.txt");
+  test_file << "USD JPY 150.0 2024.01.16\n";
+  test_file << "USD EUR 0.92 2024.01.15\n";
+  test_file << "GBP EUR 1.16 2024.01.15\n";
+  test_file.close();
+
+  std::ostringstream out;
+  std::ostringstream err;
+  BatchOptions options = BatchCommandLine::Parse(
+      {"--load", "test_batch.txt", "--sort", "date", "--filter",
+       "base = USD"});
+  EXPECT_EQ(BatchCommandLine::Run(options, out, err),
+            BatchCommandLine::kExitOk);
+  EXPECT_EQ(out.str(),
+            "USD/EUR | 0.9200 | 2024.01.15\n"
+            "USD/JPY | 150.0000 | 2024.01.16\n");
+
+  std::ostringstream converted;
+  options = BatchCommandLine::Parse(
+      {"--load", "test_batch.txt", "--convert", "10", "EUR", "USD",
+       "2024.01.15"});
+  EXPECT_EQ(BatchCommandLine::Run(options, converted, err),
+            BatchCommandLine::kExitOk);
+  EXPECT_EQ(converted.str(), "10.8696 USD\n");
+
+  options = BatchCommandLine::Parse(
+      {"--load", "test_batch.txt", "--convert", "10", "EUR", "CHF",
+       "2024.01.15"});
+  EXPECT_EQ(BatchCommandLine::Run(options, out, err),
+            BatchCommandLine::kExitNotFound);
+
+  options = BatchCommandLine::Parse({"--load", "nonexistent_file.txt"});
+  EXPECT_EQ(BatchCommandLine::Run(options, out, err),
+            BatchCommandLine::kExitFailure);
+
+  options = BatchCommandLine::Parse({"--load", "test_batch.txt", "--filter",
+                                     "rate >"});
+  EXPECT_EQ(BatchCommandLine::Run(options, out, err),
+            BatchCommandLine::kExitUsage);
+
+  remove("test_batch.txt");
+}
+
+TEST(CurrencyRateRepositoryTest, AsOfAndRangeLookups) {
+  auto parser = make_unique<RegexCurrencyRateParser>();
+  MemoryCurrencyRateRepository repo(move(parser));
+
+  repo.Add(CurrencyRate("USD", "EUR", 0.90, "2024.01.10"));
+  repo.Add(CurrencyRate("EUR", "USD", 1.25, "2024.01.12"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.92, "2024.01.15"));
+
+  auto as_of = repo.GetRateAsOf("USD", "EUR", "2024.01.13");
+  ASSERT_TRUE(as_of.has_value());
+  EXPECT_EQ(as_of->date(), "2024.01.12");
+  EXPECT_DOUBLE_EQ(as_of->rate(), 0.8);
+  EXPECT_FALSE(repo.GetRateAsOf("USD", "EUR", "2024.01.01").has_value());
+
+  auto range = repo.GetRange("USD", "EUR", {"2024.01.11", ""});
+  ASSERT_EQ(range.size(), 2);
+  EXPECT_EQ(range[0].date(), "2024.01.12");
+  EXPECT_EQ(range[1].date(), "2024.01.15");
+}
+
+#ifdef CURRENCY_RATE_HAVE_SERVER
+TEST(CurrencyRateServerTest, HandleRequests) {
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  repo.Add(CurrencyRate("USD", "EUR", 0.92, "2024.01.15"));
+  CurrencyRateServer server(&repo, ServerOptions());
+
+  EXPECT_EQ(server.HandleRequest("PING"), "OK 0\n");
+  EXPECT_EQ(server.HandleRequest("ASOF\tEUR\tUSD\t2024.02.01"),
+            "OK 1\nEUR USD 1.0869565217391304 2024.01.15\n");
+  EXPECT_EQ(server.HandleRequest("CONVERT\t100\tUSD\tEUR\t2024.01.20"),
+            "OK 1\n92.0000\n");
+  EXPECT_EQ(server.HandleRequest("ADD\tUSD JPY 150.0 2024.01.16"), "OK 0\n");
+  EXPECT_EQ(server.HandleRequest("COUNT"), "OK 1\n2\n");
+  EXPECT_EQ(server.HandleRequest("FILTER\tquote = JPY"),
+            "OK 1\nUSD JPY 150.0000 2024.01.16\n");
+  EXPECT_EQ(server.HandleRequest("FILTER\trate >").compare(0, 4, "ERR "), 0);
+  EXPECT_EQ(server.HandleRequest("BOGUS").compare(0, 4, "ERR "), 0);
+}
+
+TEST(CurrencyRateServerTest, ServesClientsOverUnixSocket) {
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  repo.Add(CurrencyRate("USD", "EUR", 0.92, "2024.01.15"));
+
+  ServerOptions options;
+  options.socket_path = "test_server.sock";
+  options.append_log = "test_server_log.txt";
+  options.worker_threads = 2;
+  remove(options.append_log.c_str());
+
+  CurrencyRateServer server(&repo, options);
+  server.Start();
+  {
+    CurrencyRateClient client(options.socket_path, 0);
+    auto response = client.Request({"ADD", "GBP USD 1.27 2024.01.15"});
+    EXPECT_EQ(response, vector<string>({"OK 0"}));
+
+    response = client.Request({"RANGE", "USD", "EUR", "", ""});
+    ASSERT_EQ(response.size(), 2);
+    EXPECT_EQ(response[1], "USD EUR 0.9200 2024.01.15");
+
+    CurrencyRateClient second(options.socket_path, 0);
+    response = second.Request({"COUNT"});
+    EXPECT_EQ(response, vector<string>({"OK 1", "2"}));
+  }
+  server.Stop();
+
+  ifstream log_file(options.append_log);
+  string line;
+  ASSERT_TRUE(getline(log_file, line));
+  EXPECT_EQ(line, "GBP USD 1.2700 2024.01.15");
+  log_file.close();
+  remove(options.append_log.c_str());
+}
+
+TEST(CurrencyRateServerTest, IdleClientsDoNotHoldWorkers) {
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  repo.Add(CurrencyRate("USD", "EUR", 0.92, "2024.01.15"));
+
+  ServerOptions options;
+  options.socket_path = "test_server_idle.sock";
+  options.worker_threads = 1;
+  CurrencyRateServer server(&repo, options);
+  server.Start();
+  {
+    vector<std::unique_ptr<CurrencyRateClient>> clients;
+    for (int i = 0; i < 5; ++i) {
+      clients.push_back(
+          make_unique<CurrencyRateClient>(options.socket_path, 0));
+    }
+    // Every client is answered by the single worker, in any order and
+    // while the others stay connected.
+    for (int round = 0; round < 2; ++round) {
+      for (size_t i = clients.size(); i-- > 0;) {
+        EXPECT_EQ(clients[i]->Request({"COUNT"}),
+                  vector<string>({"OK 1", "1"}));
+      }
+    }
+
+    EXPECT_THROW(clients[0]->Request({"ASOF", "USD", "EUR\t2024.01.15"}),
+                 invalid_argument);
+    EXPECT_THROW(clients[0]->Request({"ADD", "USD JPY 150 2024.01.15\n"}),
+                 invalid_argument);
+    EXPECT_EQ(clients[0]->Request({"PING"}), vector<string>({"OK 0"}));
+  }
+  server.Stop();
+}
+
+TEST(CurrencyRateServerTest, ClientsThatDoNotReadDoNotHoldWorkers) {
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  for (int day = 1; day <= 28; ++day) {
+    for (const char* quote : {"EUR", "GBP", "JPY", "CHF", "CAD"}) {
+      string date = (day < 10 ? "2024.01.0" : "2024.01.") + to_string(day);
+      repo.Add(CurrencyRate("USD", quote, 1.5, date));
+    }
+  }
+
+  ServerOptions options;
+  options.socket_path = "test_server_flood.sock";
+  options.worker_threads = 1;
+  CurrencyRateServer server(&repo, options);
+  server.Start();
+
+  // Pipelines far more replies than the socket buffers hold and never
+  // reads them.
+  int flood = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(flood, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, options.socket_path.c_str(),
+               sizeof(address.sun_path) - 1);
+  ASSERT_EQ(::connect(flood, reinterpret_cast<sockaddr*>(&address),
+                      sizeof(address)),
+            0);
+  string requests;
+  for (int i = 0; i < 500; ++i) {
+    requests += "FILTER\tbase = USD\n";
+  }
+  ASSERT_EQ(::send(flood, requests.data(), requests.size(), 0),
+            static_cast<ssize_t>(requests.size()));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  {
+    CurrencyRateClient client(options.socket_path, 0);
+    EXPECT_EQ(client.Request({"COUNT"}), vector<string>({"OK 1", "140"}));
+
+    auto response = client.Request({"FILTER", string(70 * 1024, 'x')});
+    ASSERT_EQ(response.size(), 1);
+    EXPECT_EQ(response[0], "ERR Request line too long");
+    EXPECT_THROW(client.Request({"PING"}), runtime_error);
+  }
+  server.Stop();
+  ::close(flood);
+}
+#endif
+
+TEST(CurrencyRateRefreshTest, ReadsOnlyAppendedLines) {
+  string filename = "test_refresh.txt";
+  ofstream(filename) << "USD EUR 0.92 2024.01.15\n";
+
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  repo.AddFromFile(filename);
+  EXPECT_EQ(repo.Count(), 1);
+  EXPECT_EQ(repo.GetCheckpoint(filename)->offset, 24);
+
+  ofstream(filename, std::ios::app) << "USD JPY 150.0 2024.01.16\nEUR GBP 0.8";
+  RefreshResult result = repo.Refresh();
+  EXPECT_EQ(result.records_added, 1);
+  EXPECT_EQ(result.bytes_read, 25);
+  EXPECT_EQ(repo.Count(), 2);
+
+  ofstream(filename, std::ios::app) << "6 2024.01.16\n";
+  result = repo.Refresh();
+  EXPECT_EQ(result.records_added, 1);
+  EXPECT_EQ(repo.Count(), 3);
+  EXPECT_EQ(repo.Refresh().records_added, 0);
+
+  remove(filename.c_str());
+}
+
+TEST(CurrencyRateRefreshTest, InitialLoadReadsUnterminatedLastLine) {
+  string first = "test_unterminated_first.txt";
+  string second = "test_unterminated_second.txt";
+  ofstream(first) << "USD EUR 0.92 2024.01.15\nUSD JPY 150.0 2024.01.15";
+  ofstream(second) << "GBP USD 1.27 2024.01.15\nCHF USD 1.12 2024.01.15";
+
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  repo.AddFromFile(first);
+  vector<FileLoadStats> stats = repo.AddFromFiles({second}, 1);
+  EXPECT_EQ(repo.Count(), 4);
+  EXPECT_EQ(repo.GetCheckpoint(first)->offset, 48);
+  EXPECT_EQ(stats[0].lines, 2);
+  EXPECT_EQ(stats[0].rejected, 0);
+
+  // Refreshes still leave an unterminated line for later.
+  ofstream(first, std::ios::app) << "\nUSD CHF 0.8";
+  EXPECT_EQ(repo.Refresh().records_added, 0);
+  ofstream(first, std::ios::app) << "6 2024.01.16\n";
+  EXPECT_EQ(repo.Refresh().records_added, 1);
+  auto rate = repo.GetRate("USD", "CHF", "2024.01.16");
+  ASSERT_TRUE(rate.has_value());
+  EXPECT_EQ(*rate, 0.86);
+
+  remove(first.c_str());
+  remove(second.c_str());
+}
+
+TEST(CurrencyRateRefreshTest, DetectsTruncationAndRotation) {
+  string filename = "test_rotate.txt";
+  ofstream(filename) << "USD EUR 0.92 2024.01.15\nUSD JPY 150.0 2024.01.16\n";
+
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  repo.AddFromFile(filename);
+  EXPECT_EQ(repo.Count(), 2);
+
+  ofstream(filename) << "GBP USD 1.27 2024.01.17\n";
+  RefreshResult result = repo.Refresh();
+  EXPECT_EQ(result.truncations, 1);
+  EXPECT_EQ(result.records_added, 1);
+
+  ofstream(filename) << "CHF USD 1.12 2024.01.18\nCHF EUR 1.05 2024.01.18\n";
+  result = repo.Refresh();
+  EXPECT_EQ(result.rotations, 1);
+  EXPECT_EQ(result.records_added, 2);
+  EXPECT_EQ(repo.Count(), 5);
+
+  remove(filename.c_str());
+}
+
+TEST(CurrencyRateRefreshTest, FollowerPicksUpAppends) {
+  string filename = "test_follow.txt";
+  ofstream(filename) << "USD EUR 0.92 2024.01.15\n";
+
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  repo.AddFromFile(filename);
+
+  for (bool use_inotify : {true, false}) {
+    FollowOptions options;
+    options.poll_interval = std::chrono::milliseconds(10);
+    options.use_inotify = use_inotify;
+
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> added(0);
+    CurrencyRateFollower follower(repo.SourceFiles(),
+                                  [&repo]() { return repo.Refresh(); },
+                                  options);
+    std::thread runner([&]() {
+      follower.Run(stop, [&added](const RefreshResult& result) {
+        added += result.records_added;
+      });
+    });
+
+    ofstream(filename, std::ios::app) << "USD JPY 150.0 2024.01.16\n";
+    for (int i = 0; i < 500 && added == 0; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    stop = true;
+    runner.join();
+    EXPECT_EQ(added, 1);
+  }
+
+  EXPECT_EQ(repo.Count(), 3);
+  remove(filename.c_str());
+}
+
+TEST(CurrencyRateRepositoryTest, AddFromFilesMergesInInputOrder) {
+  vector<string> filenames;
+  for (int i = 0; i < 12; ++i) {
+    string filename = "test_multi_" + std::to_string(i) + ".txt";
+    ofstream file(filename);
+    for (int j = 0; j < 50; ++j) {
+      file << "USD EUR " << (i + 1) << "." << (j + 10) << " 2024.01.15\n";
+    }
+    if (i == 3) {
+      file << "broken line\n";
+    }
+    filenames.push_back(filename);
+  }
+  filenames.push_back("test_multi_missing.txt");
+
+  MemoryCurrencyRateRepository serial(make_unique<RegexCurrencyRateParser>());
+  for (size_t i = 0; i + 1 < filenames.size(); ++i) {
+    serial.AddFromFile(filenames[i]);
+  }
+
+  MemoryCurrencyRateRepository parallel(
+      make_unique<RegexCurrencyRateParser>());
+  vector<FileLoadStats> stats = parallel.AddFromFiles(filenames, 3);
+
+  ASSERT_EQ(stats.size(), 13);
+  EXPECT_EQ(stats[0].records, 50);
+  EXPECT_EQ(stats[3].lines, 51);
+  EXPECT_EQ(stats[3].rejected, 1);
+  EXPECT_TRUE(stats[3].error.empty());
+  EXPECT_FALSE(stats[12].error.empty());
+
+  vector<CurrencyRate> expected = serial.GetAll();
+  vector<CurrencyRate> actual = parallel.GetAll();
+  ASSERT_EQ(actual.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(actual[i].ToFileString(), expected[i].ToFileString());
+  }
+  EXPECT_EQ(parallel.SourceFiles(), serial.SourceFiles());
+
+  for (size_t i = 0; i + 1 < filenames.size(); ++i) {
+    remove(filenames[i].c_str());
+  }
+}
+
+TEST(CurrencyRateRepositoryTest, AddFromDirectoryMatchesPattern) {
+  std::filesystem::path directory = "test_rates_dir";
+  std::filesystem::create_directory(directory);
+  ofstream(directory / "b.txt") << "USD JPY 150.0 2024.01.16\n";
+  ofstream(directory / "a.txt") << "USD EUR 0.92 2024.01.15\n";
+  ofstream(directory / "notes.md") << "not a rate file\n";
+
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  vector<FileLoadStats> stats = repo.AddFromDirectory(directory.string(),
+                                                      "*.txt");
+
+  ASSERT_EQ(stats.size(), 2);
+  ASSERT_EQ(repo.Count(), 2);
+  EXPECT_EQ(repo.GetAll()[0].currency2(), "EUR");
+  EXPECT_EQ(repo.GetAll()[1].currency2(), "JPY");
+
+  EXPECT_THROW(repo.AddFromDirectory("test_rates_dir_missing"),
+               std::runtime_error);
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST(CurrencyRateStreamTest, StreamsBatchesAcrossBufferBoundaries) {
+  string filename = "test_stream.txt";
+  {
+    ofstream file(filename);
+    for (int i = 0; i < 100; ++i) {
+      file << "USD EUR 0." << (10 + i) << " 2024.01.15\n";
+      if (i == 50) {
+        file << "\nnot a rate\n";
+      }
+    }
+    file << "USD JPY 150.0 2024.01.16\n";
+  }
+
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  repo.AddFromFile(filename);
+
+  StreamOptions options;
+  options.buffer_size = 7;
+  options.batch_size = 8;
+  vector<CurrencyRate> streamed;
+  size_t largest_batch = 0;
+  StreamStats stats = repo.StreamFile(
+      filename,
+      [&](const vector<CurrencyRate>& batch) {
+        largest_batch = std::max(largest_batch, batch.size());
+        streamed.insert(streamed.end(), batch.begin(), batch.end());
+        return true;
+      },
+      options);
+
+  EXPECT_EQ(stats.lines, 103);
+  EXPECT_EQ(stats.records, 101);
+  EXPECT_EQ(stats.rejected, 1);
+  EXPECT_FALSE(stats.stopped);
+  EXPECT_EQ(largest_batch, 8);
+
+  vector<CurrencyRate> loaded = repo.GetAll();
+  ASSERT_EQ(streamed.size(), loaded.size());
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    EXPECT_EQ(streamed[i].ToFileString(), loaded[i].ToFileString());
+  }
+
+  remove(filename.c_str());
+}
+
+TEST(CurrencyRateStreamTest, RejectsOverlongLinesWithoutBufferingThem) {
+  string filename = "test_stream_long.txt";
+  {
+    ofstream file(filename);
+    file << "USD EUR 0.92 2024.01.15\n"
+         << string(10000, 'x') << "\n"
+         << "USD JPY 150.0 2024.01.16\n"
+         << string(500, 'y');
+  }
+
+  RegexCurrencyRateParser parser;
+  StreamOptions options;
+  options.buffer_size = 64;
+  options.max_line_length = 100;
+  vector<CurrencyRate> streamed;
+  StreamStats stats = CurrencyRateStreamReader::StreamFile(
+      filename, parser,
+      [&streamed](const vector<CurrencyRate>& batch) {
+        streamed.insert(streamed.end(), batch.begin(), batch.end());
+        return true;
+      },
+      options);
+
+  EXPECT_EQ(stats.lines, 4);
+  EXPECT_EQ(stats.records, 2);
+  EXPECT_EQ(stats.rejected, 2);
+  ASSERT_EQ(streamed.size(), 2);
+  EXPECT_EQ(streamed[1].currency2(), "JPY");
+
+  remove(filename.c_str());
+}
+
+TEST(CurrencyRateStreamTest, SinkCanStopTheStream) {
+  string filename = "test_stream_stop.txt";
+  {
+    ofstream file(filename);
+    for (int i = 0; i < 1000; ++i) {
+      file << "USD EUR 0.92 2024.01.15\n";
+    }
+  }
+
+  RegexCurrencyRateParser parser;
+  StreamOptions options;
+  options.buffer_size = 64;
+  options.batch_size = 10;
+  size_t batches = 0;
+  StreamStats stats = CurrencyRateStreamReader::StreamFile(
+      filename, parser,
+      [&batches](const vector<CurrencyRate>&) { return ++batches < 3; },
+      options);
+
+  EXPECT_TRUE(stats.stopped);
+  EXPECT_EQ(batches, 3);
+  EXPECT_EQ(stats.records, 30);
+
+  EXPECT_THROW(CurrencyRateStreamReader::StreamFile(
+                   "test_stream_missing.txt", parser,
+                   [](const vector<CurrencyRate>&) { return true; }),
+               std::runtime_error);
+
+  remove(filename.c_str());
+}
+
+TEST(CurrencyRateParserTest, ParseBatchMatchesParse) {
+  RegexCurrencyRateParser parser;
+  string buffer =
+      "USD EUR 0.92 2024.01.15\n"
+      "\"US Dollar\" \"Euro\" 0.93 2024.01.16\n"
+      "  JPY\tUSD  0.0067 2024.01.17  \n"
+      "\n"
+      "USD EUR abc 2024.01.15\n"
+      "USD EUR 0.92 2024.01.15 extra\n"
+      "GBP USD 1.27 2024.01.18";
+
+  vector<std::string_view> lines;
+  size_t consumed = ICurrencyRateParser::SplitLines(buffer, &lines);
+  ASSERT_EQ(lines.size(), 6);
+  EXPECT_EQ(buffer.substr(consumed), "GBP USD 1.27 2024.01.18");
+
+  RateColumnBatch batch;
+  parser.ParseBatch(lines, &batch);
+  ASSERT_EQ(batch.size(), 6);
+  EXPECT_FALSE(batch.HasError(0));
+  EXPECT_FALSE(batch.HasError(1));
+  EXPECT_FALSE(batch.HasError(2));
+  EXPECT_TRUE(batch.HasError(3));
+  EXPECT_TRUE(batch.HasError(4));
+  EXPECT_TRUE(batch.HasError(5));
+
+  for (size_t i = 0; i < 3; ++i) {
+    CurrencyRate expected = parser.Parse(string(lines[i]));
+    CurrencyRate actual = batch.ToRate(i);
+    EXPECT_EQ(actual, expected);
+  }
+  EXPECT_EQ(batch.currency1[1], "US Dollar");
+  EXPECT_EQ(batch.currency1[2], "JPY");
+  EXPECT_THROW(batch.ToRate(4), InvalidFormatException);
+
+  vector<std::string_view> many(130, lines[0]);
+  many[129] = lines[4];
+  batch.Clear();
+  parser.ParseBatch(many, &batch);
+  EXPECT_FALSE(batch.HasError(128));
+  EXPECT_TRUE(batch.HasError(129));
+}
+
+TEST(RateFormatTest, ParsesAndPrintsExactly) {
+  double value = 0.0;
+  EXPECT_TRUE(RateFormat::Parse("0.92", &value));
+  EXPECT_DOUBLE_EQ(value, 0.92);
+  EXPECT_TRUE(RateFormat::Parse("1e3", &value));
+  EXPECT_DOUBLE_EQ(value, 1000.0);
+  EXPECT_FALSE(RateFormat::Parse("", &value));
+  EXPECT_FALSE(RateFormat::Parse("1.2.3", &value));
+  EXPECT_FALSE(RateFormat::Parse("0,92", &value));
+  EXPECT_FALSE(RateFormat::Parse("1e999", &value));
+
+  EXPECT_EQ(RateFormat::ToFixed(92.0), "92.0000");
+  EXPECT_EQ(RateFormat::ToFixed(0.00005, 2), "0.00");
+  EXPECT_EQ(RateFormat::ToExact(0.92), "0.9200");
+  EXPECT_EQ(RateFormat::ToExact(0.0067), "0.0067");
+  EXPECT_EQ(RateFormat::ToExact(0.123456), "0.123456");
+
+  for (double rate : {0.92, 1.0 / 0.92, 150.0, 0.1 + 0.2, 999999.99999}) {
+    double read_back = 0.0;
+    ASSERT_TRUE(RateFormat::Parse(RateFormat::ToExact(rate), &read_back));
+    EXPECT_EQ(read_back, rate);
+  }
+}
+
+TEST(RateFormatTest, FileLinesRoundTrip) {
+  RegexCurrencyRateParser parser;
+  CurrencyRate rate("USD", "EUR", 1.0 / 3.0, "2024.01.15");
+  CurrencyRate reloaded = parser.Parse(rate.ToFileString());
+  EXPECT_EQ(reloaded, rate);
+  EXPECT_EQ(CurrencyRate("USD", "EUR", 0.92, "2024.01.15").ToFileString(),
+            "USD EUR 0.9200 2024.01.15");
+  EXPECT_THROW(parser.Parse("USD EUR 1.2.3 2024.01.15"),
+               InvalidFormatException);
+}
+
+TEST(FixedRateTest, ParsesRoundsAndFormats) {
+  FixedRate rate;
+  ASSERT_TRUE(FixedRate::Parse("1.0870", 4, &rate));
+  EXPECT_EQ(rate.units(), 10870);
+  EXPECT_EQ(rate.ToString(), "1.0870");
+  EXPECT_DOUBLE_EQ(rate.ToDouble(), 1.087);
+
+  ASSERT_TRUE(FixedRate::Parse("0.123456789", 6, &rate));
+  EXPECT_EQ(rate.units(), 123457);
+  ASSERT_TRUE(FixedRate::Parse("0.00125", 4, &rate));
+  EXPECT_EQ(rate.units(), 12);
+  ASSERT_TRUE(FixedRate::Parse("0.00135", 4, &rate));
+  EXPECT_EQ(rate.units(), 14);
+  ASSERT_TRUE(FixedRate::Parse("150", 8, &rate));
+  EXPECT_EQ(rate.ToString(), "150.0000");
+  ASSERT_TRUE(FixedRate::Parse("0.12345", 8, &rate));
+  EXPECT_EQ(rate.ToString(), "0.12345");
+
+  EXPECT_FALSE(FixedRate::Parse("", 4, &rate));
+  EXPECT_FALSE(FixedRate::Parse("1.2.3", 4, &rate));
+  EXPECT_FALSE(FixedRate::Parse("99999999999999999999", 4, &rate));
+  EXPECT_THROW(FixedRate(1, FixedRate::kMaxScale + 1), std::invalid_argument);
+
+  EXPECT_EQ(FixedRate(9200, 4), FixedRate(920000, 6));
+  EXPECT_LT(FixedRate(9200, 4), FixedRate(920001, 6));
+  EXPECT_EQ(FixedRate(9200, 4).Inverse(), FixedRate(1086956522, 9));
+}
+
+TEST(FixedRateTest, InverseKeepsLargeRates) {
+  FixedRate yen;
+  ASSERT_TRUE(FixedRate::Parse("150.1234", 4, &yen));
+  EXPECT_EQ(yen.Inverse(), FixedRate(6661187, 9));
+  EXPECT_EQ(FixedRate::FromDouble(yen.Inverse().Inverse().ToDouble(), 4),
+            yen);
+  FixedRate won;
+  ASSERT_TRUE(FixedRate::Parse("1300.50", 2, &won));
+  EXPECT_EQ(won.Inverse().ToString(), "0.000768935");
+  EXPECT_EQ(FixedRate::FromDouble(won.Inverse().Inverse().ToDouble(), 2),
+            won);
+
+  // Canonical storage inverts these; they read back as loaded at their
+  // own scale.
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateFixedPointParser(4));
+  repo.SetCanonicalPairs(true);
+  repo.Add(CurrencyRate("USD", "JPY", yen, "2024.01.15"));
+  repo.Add(CurrencyRate("USD", "KRW", won, "2024.01.15"));
+  repo.Add(CurrencyRate("JPY", "USD", yen.Inverse(), "2024.01.15"));
+  ASSERT_EQ(repo.Count(), 2);
+  EXPECT_EQ(repo.canonical_duplicates(), 1);
+  auto rate = repo.GetRate("USD", "JPY", "2024.01.15");
+  ASSERT_TRUE(rate.has_value());
+  EXPECT_EQ(FixedRate::FromDouble(*rate, 4), yen);
+  rate = repo.GetRate("USD", "KRW", "2024.01.15");
+  ASSERT_TRUE(rate.has_value());
+  EXPECT_EQ(FixedRate::FromDouble(*rate, 2), won);
+}
+
+TEST(FixedRateTest, RecordsCompareExactlyAfterReload) {
+  auto parser = CurrencyRateParserFactory::CreateFixedPointParser(4);
+  CurrencyRate rate = parser->Parse("USD EUR 0.92 2024.01.15");
+  ASSERT_TRUE(rate.fixed_rate().has_value());
+  EXPECT_EQ(rate.ToFileString(), "USD EUR 0.9200 2024.01.15");
+  EXPECT_EQ(parser->Parse(rate.ToFileString()), rate);
+  EXPECT_EQ(rate.Inverse().ToFileString(),
+            "EUR USD 1.086956522 2024.01.15");
+
+  EXPECT_THROW(parser->Parse("USD EUR 0.00001 2024.01.15"),
+               InvalidFormatException);
+  EXPECT_THROW(RegexCurrencyRateParser(FixedRate::kMaxScale + 1),
+               std::invalid_argument);
+
+  vector<std::string_view> lines = {"USD EUR 0.9213 2024.01.15",
+                                    "USD EUR 0.9187 2024.01.16"};
+  RateColumnBatch batch;
+  parser->ParseBatch(lines, &batch);
+  ASSERT_EQ(batch.units.size(), 2);
+  EXPECT_EQ(batch.units[1], 9187);
+  EXPECT_EQ(batch.ToRate(0).fixed_rate()->units(), 9213);
+
+  vector<CurrencyRate> rates = {batch.ToRate(0), batch.ToRate(1)};
+  auto aggregates = CurrencyRateAggregator::Aggregate(
+      rates, PairFilter(), DateRange(), AggregationBucket::kMonth);
+  ASSERT_EQ(aggregates.size(), 1);
+  EXPECT_EQ(aggregates[0].high, 0.9213);
+  EXPECT_EQ(aggregates[0].low, 0.9187);
+  EXPECT_DOUBLE_EQ(aggregates[0].mean, 0.92);
+}
+
+TEST(CurrencyRateDialectTest, ParsesEachDialect) {
+  DelimitedCurrencyRateParser<CsvIsoDialect> csv;
+  CurrencyRate rate = csv.Parse(" USD , \"Euro\" ,0.92, 2024-01-15");
+  EXPECT_EQ(rate.currency2(), "Euro");
+  EXPECT_EQ(rate.date(), "2024.01.15");
+  EXPECT_FALSE(csv.CanParse("USD,EUR,0.92,2024.01.15"));
+  EXPECT_FALSE(csv.CanParse("USD,EUR,0.92,2024-01-15,extra"));
+  EXPECT_FALSE(csv.CanParse("from,to,rate,date"));
+
+  DelimitedCurrencyRateParser<SemicolonCommaDialect> semicolon(4);
+  rate = semicolon.Parse("USD;EUR;0,92;2024.01.15");
+  EXPECT_EQ(rate.ToFileString(), "USD EUR 0.9200 2024.01.15");
+  ASSERT_TRUE(rate.fixed_rate().has_value());
+
+  DelimitedCurrencyRateParser<SpaceIsoDialect> space;
+  rate = space.Parse("\"US Dollar\"\tEUR  0.92 2024-01-15");
+  EXPECT_EQ(rate.currency1(), "US Dollar");
+  EXPECT_THROW(space.Parse("USD EUR 0.92 2024.01.15"), InvalidFormatException);
+
+  vector<std::string_view> lines = {"USD;EUR;0.92;2024-01-15", "bad"};
+  RateColumnBatch batch;
+  DelimitedCurrencyRateParser<SemicolonIsoDialect>().ParseBatch(lines,
+                                                                &batch);
+  ASSERT_EQ(batch.size(), 2);
+  EXPECT_EQ(batch.date[0], "2024.01.15");
+  EXPECT_TRUE(batch.HasError(1));
+}
+
+TEST(CurrencyRateDialectTest, QuotedNamesMayContainTheDelimiter) {
+  DelimitedCurrencyRateParser<CsvDialect> csv;
+  vector<std::string_view> lines = {
+      "\"Euro, Member\" ,USD,1.09,2024.01.15",
+      "\"Euro, Member\" x,USD,1.09,2024.01.15",
+      "\"Euro, Member,USD,1.09,2024.01.15",
+      "\"\",USD,1.09,2024.01.15"};
+  RateColumnBatch batch;
+  csv.ParseBatch(lines, &batch);
+  ASSERT_EQ(batch.size(), 4);
+  EXPECT_FALSE(batch.HasError(0));
+  EXPECT_EQ(batch.currency1[0], "Euro, Member");
+  EXPECT_EQ(batch.currency2[0], "USD");
+  EXPECT_TRUE(batch.HasError(1));
+  EXPECT_TRUE(batch.HasError(2));
+  EXPECT_TRUE(batch.HasError(3));
+  EXPECT_TRUE(csv.CanParse(string(lines[0])));
+  // The split succeeds, but a comma is not valid in a currency name.
+  EXPECT_THROW(csv.Parse(string(lines[0])), InvalidFormatException);
+
+  DelimitedCurrencyRateParser<SemicolonCommaDialect> semicolon;
+  EXPECT_TRUE(semicolon.CanParse("USD;\"Dollar; Canadian\";1,36;2024.01.15"));
+  CurrencyRate rate = semicolon.Parse("\"US Dollar\" ; CAD ;1,36;2024.01.15");
+  EXPECT_EQ(rate.currency1(), "US Dollar");
+  EXPECT_EQ(rate.rate(), 1.36);
+}
+
+TEST(CurrencyRateDialectTest, DetectsFileFormat) {
+  auto detected = CurrencyRateParserFactory::DetectParser(
+      "from,to,rate,date\nUSD,EUR,0.92,2024-01-15\nUSD,JPY,150,2024-01-16\n");
+  EXPECT_NE(dynamic_cast<DelimitedCurrencyRateParser<CsvIsoDialect>*>(
+                detected.get()),
+            nullptr);
+
+  detected = CurrencyRateParserFactory::DetectParser(
+      "USD;EUR;0,92;2024.01.15");
+  EXPECT_NE(dynamic_cast<DelimitedCurrencyRateParser<SemicolonCommaDialect>*>(
+                detected.get()),
+            nullptr);
+
+  detected = CurrencyRateParserFactory::DetectParser("no rates here\n");
+  EXPECT_NE(dynamic_cast<RegexCurrencyRateParser*>(detected.get()), nullptr);
+
+  string filename = "test_detect.csv";
+  ofstream(filename) << "USD,EUR,0.92,2024-01-15\n\"US Dollar\",GBP,0.79,"
+                     << "2024-01-16\n";
+
+  MemoryCurrencyRateRepository repo(make_unique<RegexCurrencyRateParser>());
+  repo.SetFormatDetection(true);
+  repo.AddFromFile(filename);
+  ASSERT_EQ(repo.Count(), 2);
+  EXPECT_EQ(repo.GetAll()[1].currency1(), "US Dollar");
+  EXPECT_EQ(repo.GetAll()[1].date(), "2024.01.16");
+
+  ofstream(filename, std::ios::app) << "USD,JPY,150.5,2024-01-17\n";
+  EXPECT_EQ(repo.Refresh().records_added, 1);
+  EXPECT_EQ(repo.GetRate("USD", "JPY", "2024.01.17"), 150.5);
+
+  remove(filename.c_str());
+}
+
+TEST(RateDatasetGeneratorTest, DeterministicAndOrdersArePermutations) {
+  DatasetOptions options;
+  options.seed = 7;
+  options.pair_count = 5;
+  options.first_date = "2020.01.01";
+  options.last_date = "2020.01.31";
+  options.quoted_fraction = 0.2;
+
+  auto by_date = RateDatasetGenerator(options).GenerateLines();
+  EXPECT_EQ(by_date.size(), 5 * 31);
+  EXPECT_EQ(by_date, RateDatasetGenerator(options).GenerateLines());
+
+  options.order = DatasetOrder::kCurrency;
+  auto by_currency = RateDatasetGenerator(options).GenerateLines();
+  options.order = DatasetOrder::kShuffled;
+  options.shuffle_window = 16;
+  auto shuffled = RateDatasetGenerator(options).GenerateLines();
+  EXPECT_NE(shuffled, by_date);
+
+  std::sort(by_date.begin(), by_date.end());
+  std::sort(by_currency.begin(), by_currency.end());
+  std::sort(shuffled.begin(), shuffled.end());
+  EXPECT_EQ(by_currency, by_date);
+  EXPECT_EQ(shuffled, by_date);
+
+  auto parser = CurrencyRateParserFactory::CreateDefaultParser();
+  for (const auto& line : by_date) {
+    CurrencyRate rate = parser->Parse(line);
+    EXPECT_GE(rate.date(), "2020.01.01");
+    EXPECT_LE(rate.date(), "2020.01.31");
+  }
+
+  options.first_date = "2999.01.01";
+  EXPECT_THROW(RateDatasetGenerator{options}, invalid_argument);
+}
+
+TEST(RateDatasetGeneratorTest, MalformedLinesAreRejected) {
+  DatasetOptions options;
+  options.pair_count = 30;
+  options.records = 2000;
+  options.quoted_fraction = 0.5;
+  options.malformed_fraction = 0.1;
+
+  string filename = "test_generated_rates.txt";
+  DatasetStats stats = RateDatasetGenerator(options).WriteFile(filename);
+  EXPECT_EQ(stats.lines, 2000);
+  EXPECT_GT(stats.malformed, 100);
+  EXPECT_LT(stats.malformed, 300);
+
+  auto repo = make_unique<MemoryCurrencyRateRepository>(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  std::vector<FileLoadStats> loaded = repo->AddFromFiles({filename});
+  remove(filename.c_str());
+
+  EXPECT_EQ(loaded[0].rejected, stats.malformed);
+  EXPECT_EQ(repo->Count(), stats.lines - stats.malformed);
+  EXPECT_EQ(loaded[0].bytes, stats.bytes);
+}
+
+TEST(CurrencyRateMetricsTest, HistogramBucketsAndQuantiles) {
+  for (uint64_t value : std::vector<uint64_t>{0, 7, 8, 9, 1000, 123456789,
+                                             UINT64_MAX}) {
+    size_t index = LatencyHistogram::BucketIndex(value);
+    ASSERT_LT(index, LatencyHistogram::kBucketCount);
+    if (value != UINT64_MAX) {
+      EXPECT_LT(value, LatencyHistogram::BucketLimit(index));
+    }
+    if (index > 0) {
+      EXPECT_GE(value, LatencyHistogram::BucketLimit(index - 1));
+    }
+  }
+
+  MetricsRegistry& registry = MetricsRegistry::Global();
+  LatencyHistogram& histogram =
+      registry.Histogram("test_latency_seconds", "Test latencies.");
+  histogram.Reset();
+  for (uint64_t i = 1; i <= 1000; ++i) {
+    histogram.Record(i * 1000);
+  }
+
+  MetricsSnapshot snapshot = registry.Snapshot();
+  const HistogramSnapshot* recorded =
+      snapshot.FindHistogram("test_latency_seconds");
+  ASSERT_NE(recorded, nullptr);
+  EXPECT_EQ(recorded->count, 1000);
+  EXPECT_DOUBLE_EQ(recorded->MeanNanoseconds(), 500500.0);
+  uint64_t median = recorded->QuantileNanoseconds(0.5);
+  EXPECT_GE(median, 500000);
+  EXPECT_LE(median, 500000 * 1.125);
+
+  string text = snapshot.ToPrometheus();
+  EXPECT_NE(text.find("# TYPE test_latency_seconds histogram"),
+            string::npos);
+  EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"+Inf\"} 1000"),
+            string::npos);
+  EXPECT_NE(text.find("test_latency_seconds_count 1000"), string::npos);
+}
+
+#ifdef CURRENCY_RATE_ENABLE_METRICS
+TEST(CurrencyRateMetricsTest, LoadCountsLinesAndRejectsByType) {
+  string filename = "test_metrics_rates.txt";
+  {
+    ofstream file(filename);
+    file << "USD EUR 0.92 2024.01.15\n"
+         << "USD EUR 0.93 2024.02.30\n"
+         << "USD EUR 0 2024.01.16\n"
+         << "not a rate line\n";
+  }
+
+  MetricsRegistry& registry = MetricsRegistry::Global();
+  registry.Reset();
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  repo.AddFromFile(filename);
+  repo.SortByDate();
+  remove(filename.c_str());
+
+  MetricsSnapshot snapshot = registry.Snapshot();
+  auto counter = [&snapshot](const string& name) -> uint64_t {
+    const CounterSnapshot* found = snapshot.FindCounter(name);
+    return found == nullptr ? 0 : found->value;
+  };
+  EXPECT_EQ(counter("currency_rate_lines_read_total"), 4);
+  EXPECT_EQ(counter("currency_rate_records_loaded_total"), 1);
+  EXPECT_EQ(counter("currency_rate_bytes_read_total"), 85);
+  EXPECT_EQ(counter("currency_rate_rejected_lines_total"
+                    "{reason=\"InvalidDateException\"}"), 1);
+  EXPECT_EQ(counter("currency_rate_rejected_lines_total"
+                    "{reason=\"InvalidRateException\"}"), 1);
+  EXPECT_EQ(counter("currency_rate_rejected_lines_total"
+                    "{reason=\"InvalidFormatException\"}"), 1);
+
+  const HistogramSnapshot* sort =
+      snapshot.FindHistogram("currency_rate_sort_seconds");
+  ASSERT_NE(sort, nullptr);
+  EXPECT_EQ(sort->count, 1);
+  // Records are counted, not timed one by one.
+  EXPECT_EQ(snapshot.FindHistogram("currency_rate_parse_seconds"), nullptr);
+
+  string metrics_file = "test_metrics.prom";
+  registry.WritePrometheus(metrics_file);
+  ifstream dump(metrics_file);
+  string text((std::istreambuf_iterator<char>(dump)),
+              std::istreambuf_iterator<char>());
+  remove(metrics_file.c_str());
+  EXPECT_NE(text.find("# TYPE currency_rate_rejected_lines_total counter"),
+            string::npos);
+  EXPECT_NE(text.find("currency_rate_load_file_seconds_count 1"),
+            string::npos);
+}
+#endif
+
+TEST(CurrencyRateTraceTest, RecordsSpansPerThreadWhenEnabled) {
+  TraceRecorder::Clear();
+  { CURRENCY_RATE_TRACE_SPAN("Disabled"); }
+  EXPECT_EQ(TraceRecorder::RecordedCount(), 0);
+
+  TraceRecorder::Enable();
+  {
+    CURRENCY_RATE_TRACE_SPAN("Outer", "file \"a\".txt");
+    std::thread worker([]() {
+      TraceRecorder::SetThreadName("test worker");
+      CURRENCY_RATE_TRACE_SPAN("Inner");
+    });
+    worker.join();
+  }
+  TraceRecorder::Disable();
+
+  EXPECT_EQ(TraceRecorder::RecordedCount(), 2);
+  string trace = TraceRecorder::ToChromeTrace();
+  EXPECT_EQ(trace.find("Disabled"), string::npos);
+  EXPECT_NE(trace.find("\"name\":\"Outer\""), string::npos);
+  EXPECT_NE(trace.find("\"detail\":\"file \\\"a\\\".txt\""), string::npos);
+  EXPECT_NE(trace.find("\"name\":\"Inner\""), string::npos);
+  EXPECT_NE(trace.find("\"name\":\"test worker\""), string::npos);
+  EXPECT_EQ(trace.compare(trace.size() - 4, 4, "\n]}\n"), 0);
+  TraceRecorder::Clear();
+}
+
+TEST(CurrencyRateTraceTest, RingBufferKeepsNewestSpans) {
+  TraceRecorder::Clear();
+  TraceRecorder::SetBufferCapacity(4);
+  TraceRecorder::Enable();
+  std::thread worker([]() {
+    for (int i = 0; i < 10; ++i) {
+      TraceRecorder::Record(i < 6 ? "Old" : "New", "", 0, 1);
+    }
+  });
+  worker.join();
+
+  string filename = "test_trace.json";
+  auto repo = make_unique<MemoryCurrencyRateRepository>(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  repo->Add(CurrencyRate("USD", "EUR", 0.92, "2024.01.15"));
+  repo->SaveToFile(filename);
+  remove(filename.c_str());
+  TraceRecorder::Disable();
+  TraceRecorder::SetBufferCapacity(TraceRecorder::kDefaultBufferCapacity);
+
+  string trace = TraceRecorder::ToChromeTrace();
+  EXPECT_EQ(trace.find("\"name\":\"Old\""), string::npos);
+  size_t news = 0;
+  for (size_t at = trace.find("\"name\":\"New\""); at != string::npos;
+       at = trace.find("\"name\":\"New\"", at + 1)) {
+    ++news;
+  }
+  EXPECT_EQ(news, 4);
+  EXPECT_NE(trace.find("\"name\":\"SaveToFile\""), string::npos);
+  TraceRecorder::Clear();
+}
+
+TEST(CurrencyRateMemoryTest, ReportsStorageStringsAndIndexes) {
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  MemoryUsageReport empty = repo.MemoryUsage();
+  EXPECT_EQ(empty.records, 0);
+  EXPECT_EQ(empty.record_storage, 0);
+  EXPECT_EQ(empty.string_heap, 0);
+
+  const string long_name = "Special Drawing Rights (IMF)";
+  for (int day = 1; day <= 20; ++day) {
+    string date = "2024.01." + string(day < 10 ? "0" : "") +
+                  std::to_string(day);
+    repo.Add(CurrencyRate("USD", "EUR", 0.9, date));
+    repo.Add(CurrencyRate(long_name, "USD", 1.3, date));
+  }
+
+  MemoryUsageReport usage = repo.MemoryUsage();
+  EXPECT_EQ(usage.records, 40);
+  EXPECT_EQ(usage.record_storage, 40 * sizeof(CurrencyRate));
+  // Only the long name outgrows the inline buffer.
+  EXPECT_EQ(usage.string_heap, 20 * (long_name.size() + 1));
+  EXPECT_GT(usage.indexes, 0);
+  EXPECT_EQ(usage.caches, 0);
+  EXPECT_EQ(usage.Total(), usage.record_storage + usage.string_heap +
+                               usage.indexes + usage.caches + usage.slack);
+
+  repo.EnableRollingStatistics({5});
+  EXPECT_GT(repo.MemoryUsage().caches, 0);
+  EXPECT_NE(usage.ToString().find("total " + std::to_string(usage.Total())),
+            string::npos);
+}
+
+TEST(CurrencyRateMemoryTest, BudgetShrinksThenRebuildsIndex) {
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  for (int i = 0; i < 1000; ++i) {
+    repo.Add(CurrencyRate("C" + std::to_string(i % 50), "USD", 1.0 + i,
+                          "2024.01.01"));
+  }
+  MemoryUsageReport before = repo.MemoryUsage();
+  ASSERT_GT(before.slack, 0);
+
+  // A budget that only needs the spare capacity released keeps the index.
+  repo.SetMemoryBudget(before.Total() - before.slack / 2);
+  MemoryUsageReport shrunk = repo.MemoryUsage();
+  EXPECT_LE(shrunk.Total(), repo.memory_budget());
+  EXPECT_EQ(shrunk.indexes, before.indexes);
+
+  // The records alone still exceed a tiny budget; the index is rebuilt
+  // in place rather than dropped.
+  repo.SetMemoryBudget(1);
+  EXPECT_FALSE(repo.EnforceMemoryBudget());
+  MemoryUsageReport compacted = repo.MemoryUsage();
+  EXPECT_GT(compacted.indexes, 0);
+  EXPECT_LE(compacted.indexes, shrunk.indexes);
+  EXPECT_EQ(compacted.slack, 0);
+  EXPECT_EQ(compacted.record_storage, 1000 * sizeof(CurrencyRate));
+
+  // Lookups answer the same without touching the index.
+  EXPECT_EQ(repo.FilterByCurrency("C7").size(), 20);
+  EXPECT_EQ(repo.MemoryUsage().indexes, compacted.indexes);
+}
+
+TEST(CurrencyRateMemoryTest, LoadsApplyTheBudgetOnceTheEstimateExceedsIt) {
+  string filename = "test_budget_load.txt";
+  {
+    ofstream file(filename);
+    for (int i = 0; i < 100; ++i) {
+      file << "C" << i % 50 << " EUR 1.5 2024.01.02\n";
+    }
+  }
+
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  for (int i = 0; i < 1000; ++i) {
+    repo.Add(CurrencyRate("C" + std::to_string(i % 50), "USD", 1.0 + i,
+                          "2024.01.01"));
+  }
+  repo.SetMemoryBudget(repo.MemoryUsage().Total() + 1024);
+  ASSERT_GT(repo.MemoryUsage().slack, 0);
+
+  // A small file does not reach the budget and nothing is compacted.
+  ofstream("test_budget_small.txt") << "C1 EUR 1.5 2024.01.03\n";
+  repo.AddFromFile("test_budget_small.txt");
+  EXPECT_GT(repo.MemoryUsage().slack, 0);
+
+  repo.AddFromFile(filename);
+  EXPECT_EQ(repo.Count(), 1101);
+  EXPECT_EQ(repo.MemoryUsage().slack, 0);
+  EXPECT_EQ(repo.FilterByCurrency("C7").size(), 22);
+
+  remove(filename.c_str());
+  remove("test_budget_small.txt");
+}
+
+TEST(RateQueryRangeTest, PagesMatchTheEagerQuery) {
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  const char* const quotes[] = {"EUR", "JPY", "GBP"};
+  for (int i = 0; i < 90; ++i) {
+    string date = "2024.0" + std::to_string(1 + 2 * (i % 3)) + "." +
+                  (i / 3 < 9 ? "0" : "") + std::to_string(1 + i / 3);
+    repo.Add(CurrencyRate("USD", quotes[i % 3], 1.0 + i, date));
+  }
+
+  for (const char* literal : {"", "currency = EUR", "pair = USD/JPY",
+                              "pair in (USD/EUR, USD/GBP) and rate > 40",
+                              "date >= 2024.02.10 and date <= 2024.03.05",
+                              "date <= 2024.03.05 and rate < 60"}) {
+    string text = literal;
+    FilterExpression expression = text.empty()
+                                      ? FilterExpression()
+                                      : FilterExpression::Parse(text);
+    vector<CurrencyRate> eager = repo.Query(expression);
+    RateQueryRange all = repo.QueryRange(expression);
+    EXPECT_EQ(all.ToVector(), eager) << text;
+
+    vector<CurrencyRate> paged;
+    for (size_t offset = 0; offset < eager.size() + 7; offset += 7) {
+      vector<CurrencyRate> page = all.Page(offset, 7).ToVector();
+      EXPECT_LE(page.size(), 7);
+      paged.insert(paged.end(), page.begin(), page.end());
+    }
+    EXPECT_EQ(paged, eager) << text;
+  }
+
+  QueryOptions options;
+  options.offset = 2;
+  options.limit = 3;
+  vector<CurrencyRate> page =
+      repo.QueryRange(FilterExpression::Parse("currency = JPY"), options)
+          .ToVector();
+  ASSERT_EQ(page.size(), 3);
+  EXPECT_EQ(page[0].rate(), 8.0);
+  // Pages of a page stay inside it.
+  EXPECT_EQ(repo.QueryRange(FilterExpression(), options).Page(1, 10)
+                .ToVector().size(), 2);
+
+  // Newest first, stopping after the requested count.
+  vector<CurrencyRate> latest =
+      repo.Latest(FilterExpression::Parse("currency = EUR"), 4).ToVector();
+  ASSERT_EQ(latest.size(), 4);
+  EXPECT_EQ(latest[0].date(), "2024.01.30");
+  EXPECT_EQ(latest[1].date(), "2024.01.29");
+  EXPECT_EQ(latest[3].date(), "2024.01.27");
+  options = QueryOptions();
+  options.order = QueryOrder::kDateAscending;
+  vector<CurrencyRate> oldest =
+      repo.QueryRange(FilterExpression::Parse("date >= 2024.05.29"), options)
+          .ToVector();
+  ASSERT_EQ(oldest.size(), 2);
+  EXPECT_EQ(oldest[0].date(), "2024.05.29");
+  EXPECT_EQ(oldest[1].date(), "2024.05.30");
+}
+
+TEST(BatchCommandLineTest, OffsetLimitAndLatest) {
+  ofstream test_file("test_batch_page.txt");
+  test_file << "USD EUR 0.90 2024.01.15\n";
+  test_file << "USD EUR 0.91 2024.01.17\n";
+  test_file << "USD EUR 0.92 2024.01.16\n";
+  test_file << "GBP EUR 1.16 2024.01.15\n";
+  test_file.close();
+
+  std::ostringstream out;
+  std::ostringstream err;
+  BatchOptions options = BatchCommandLine::Parse(
+      {"--load", "test_batch_page.txt", "--offset", "1", "--limit", "2"});
+  EXPECT_EQ(BatchCommandLine::Run(options, out, err),
+            BatchCommandLine::kExitOk);
+  EXPECT_EQ(out.str(),
+            "USD/EUR | 0.9100 | 2024.01.17\n"
+            "USD/EUR | 0.9200 | 2024.01.16\n");
+
+  std::ostringstream latest;
+  options = BatchCommandLine::Parse({"--load", "test_batch_page.txt",
+                                     "--filter", "base = USD", "--latest",
+                                     "2"});
+  EXPECT_EQ(BatchCommandLine::Run(options, latest, err),
+            BatchCommandLine::kExitOk);
+  EXPECT_EQ(latest.str(),
+            "USD/EUR | 0.9100 | 2024.01.17\n"
+            "USD/EUR | 0.9200 | 2024.01.16\n");
+
+  EXPECT_THROW(BatchCommandLine::Parse({"--limit", "x"}), invalid_argument);
+  EXPECT_THROW(BatchCommandLine::Parse({"--limit", "-1"}), invalid_argument);
+  EXPECT_THROW(BatchCommandLine::Parse({"--offset", "+3"}), invalid_argument);
+  EXPECT_THROW(BatchCommandLine::Parse({"--latest", " 3"}), invalid_argument);
+  EXPECT_THROW(BatchCommandLine::Parse({"--limit", ""}), invalid_argument);
+  remove("test_batch_page.txt");
+}
+
+TEST(CurrencyRateDiffTest, MergeJoinReportsAddedRemovedAndChanged) {
+  MemoryCurrencyRateRepository before(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  MemoryCurrencyRateRepository after(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  before.Add(CurrencyRate("USD", "EUR", 0.9200, "2024.01.15"));
+  before.Add(CurrencyRate("GBP", "USD", 1.2700, "2024.01.15"));
+  before.Add(CurrencyRate("USD", "EUR", 0.9300, "2024.01.16"));
+  before.Add(CurrencyRate("USD", "JPY", 148.00, "2024.01.15"));
+  after.Add(CurrencyRate("USD", "EUR", 0.92001, "2024.01.15"));
+  after.Add(CurrencyRate("USD", "EUR", 0.9400, "2024.01.16"));
+  after.Add(CurrencyRate("GBP", "USD", 1.2700, "2024.01.15"));
+  after.Add(CurrencyRate("USD", "CHF", 0.8600, "2024.01.15"));
+
+  vector<RateDifference> differences;
+  RateDiffOptions options;
+  options.absolute_tolerance = 0.0001;
+  RateDiffStats stats = CurrencyRateDiff::Compare(
+      before, after,
+      [&differences](const RateDifference& difference) {
+        differences.push_back(difference);
+      },
+      options);
+
+  EXPECT_EQ(stats.before_records, 4);
+  EXPECT_EQ(stats.after_records, 4);
+  EXPECT_EQ(stats.unchanged, 2);
+  EXPECT_EQ(stats.changed, 1);
+  EXPECT_EQ(stats.added, 1);
+  EXPECT_EQ(stats.removed, 1);
+  EXPECT_FALSE(stats.identical());
+
+  // Reported in merge order.
+  ASSERT_EQ(differences.size(), 3);
+  EXPECT_EQ(differences[0].kind, RateDiffKind::kAdded);
+  EXPECT_EQ(differences[0].pair, CurrencyPair("USD", "CHF"));
+  EXPECT_TRUE(std::isnan(differences[0].before_rate));
+  EXPECT_EQ(differences[1].kind, RateDiffKind::kChanged);
+  EXPECT_EQ(differences[1].date, "2024.01.16");
+  EXPECT_EQ(differences[1].before_rate, 0.93);
+  EXPECT_EQ(differences[1].after_rate, 0.94);
+  EXPECT_EQ(differences[2].kind, RateDiffKind::kRemoved);
+  EXPECT_EQ(differences[2].pair, CurrencyPair("USD", "JPY"));
+
+  // Without a tolerance the small move counts too.
+  EXPECT_EQ(CurrencyRateDiff::Compare(before, after, nullptr).changed, 2);
+  EXPECT_TRUE(CurrencyRateDiff::Compare(before, before, nullptr).identical());
+}
+
+TEST(CurrencyRateDiffTest, CompareFilesDropsOverlongLines) {
+  // Lines spanning several blocks, one of them unterminated at the end.
+  ofstream("test_diff_long_before.txt")
+      << "GBP USD 1.27 2024.01.15\n" << string(3 << 20, 'x') << "\n"
+      << "USD EUR 0.92 2024.01.15\n";
+  ofstream("test_diff_long_after.txt")
+      << "GBP USD 1.27 2024.01.15\n" << "USD EUR 0.92 2024.01.15\n"
+      << string(1 << 21, 'y');
+
+  auto parser = CurrencyRateParserFactory::CreateDefaultParser();
+  RateDiffOptions options;
+  options.max_line_length = 1024;
+  RateDiffStats stats = CurrencyRateDiff::CompareFiles(
+      "test_diff_long_before.txt", "test_diff_long_after.txt", *parser,
+      RateDiffSink(), options);
+  EXPECT_TRUE(stats.identical());
+  EXPECT_EQ(stats.unchanged, 2);
+  EXPECT_EQ(stats.rejected, 2);
+
+  remove("test_diff_long_before.txt");
+  remove("test_diff_long_after.txt");
+}
+
+TEST(CurrencyRateDiffTest, ComparesSortedFilesAndRejectsUnsorted) {
+  ofstream before_file("test_diff_before.txt");
+  before_file << "GBP USD 1.27 2024.01.15\n"
+              << "USD EUR 0.92 2024.01.15\n"
+              << "garbage line\n"
+              << "USD EUR 0.93 2024.01.16\n";
+  before_file.close();
+  ofstream after_file("test_diff_after.txt");
+  after_file << "GBP USD 1.27 2024.01.15\n"
+             << "\n"
+             << "USD EUR 0.95 2024.01.16\n"
+             << "USD JPY 148.0 2024.01.16";
+  after_file.close();
+
+  auto parser = CurrencyRateParserFactory::CreateDefaultParser();
+  vector<RateDifference> differences;
+  RateDiffStats stats = CurrencyRateDiff::CompareFiles(
+      "test_diff_before.txt", "test_diff_after.txt", *parser,
+      [&differences](const RateDifference& difference) {
+        differences.push_back(difference);
+      });
+  EXPECT_EQ(stats.unchanged, 1);
+  EXPECT_EQ(stats.removed, 1);
+  EXPECT_EQ(stats.changed, 1);
+  EXPECT_EQ(stats.added, 1);
+  EXPECT_EQ(stats.rejected, 1);
+  ASSERT_EQ(differences.size(), 3);
+  EXPECT_EQ(differences[2].pair, CurrencyPair("USD", "JPY"));
+
+  std::ostringstream out;
+  std::ostringstream err;
+  BatchOptions options = BatchCommandLine::Parse(
+      {"--diff", "test_diff_before.txt", "test_diff_after.txt"});
+  EXPECT_EQ(BatchCommandLine::Run(options, out, err),
+            BatchCommandLine::kExitOk);
+  EXPECT_EQ(out.str(),
+            "- USD/EUR | 0.9200 | 2024.01.15\n"
+            "~ USD/EUR | 0.9300 -> 0.9500 | 2024.01.16\n"
+            "+ USD/JPY | 148.0000 | 2024.01.16\n");
+
+  // Each side is detected on its own.
+  ofstream("test_diff_after.csv") << "GBP,USD,1.27,2024-01-15\n"
+                                  << "USD,EUR,0.95,2024-01-16\n"
+                                  << "USD,JPY,148,2024-01-16\n";
+  out.str("");
+  options = BatchCommandLine::Parse({"--detect-format", "--diff",
+                                     "test_diff_before.txt",
+                                     "test_diff_after.csv"});
+  EXPECT_EQ(BatchCommandLine::Run(options, out, err),
+            BatchCommandLine::kExitOk);
+  EXPECT_EQ(out.str(),
+            "- USD/EUR | 0.9200 | 2024.01.15\n"
+            "~ USD/EUR | 0.9300 -> 0.9500 | 2024.01.16\n"
+            "+ USD/JPY | 148.0000 | 2024.01.16\n");
+  remove("test_diff_after.csv");
+
+  ofstream unsorted("test_diff_after.txt");
+  unsorted << "USD EUR 0.95 2024.01.16\n"
+           << "GBP USD 1.27 2024.01.15\n";
+  unsorted.close();
+  EXPECT_THROW(CurrencyRateDiff::CompareFiles("test_diff_before.txt",
+                                              "test_diff_after.txt",
+                                              *parser, nullptr),
+               std::runtime_error);
+
+  remove("test_diff_before.txt");
+  remove("test_diff_after.txt");
+}
+
+TEST(CurrencyRateResamplerTest, FillsWeekdayGapsPerPolicy) {
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  // 2024.01.05 is a Friday.
+  repo.Add(CurrencyRate("USD", "EUR", 0.90, "2024.01.03"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.91, "2024.01.05"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.92, "2024.01.06"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.96, "2024.01.10"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.97, "2024.01.10"));
+  repo.Add(CurrencyRate("GBP", "USD", 1.27, "2024.01.09"));
+
+  ResampleOptions options;
+  options.from = "2024.01.04";
+  options.to = "2024.01.10";
+  RateMatrix matrix = repo.Resample(options);
+
+  ASSERT_EQ(matrix.rows(), 2);
+  EXPECT_EQ(matrix.pairs[0], CurrencyPair("GBP", "USD"));
+  EXPECT_EQ(matrix.pairs[1], CurrencyPair("USD", "EUR"));
+  EXPECT_EQ(matrix.days, vector<string>({"2024.01.04", "2024.01.05",
+                                         "2024.01.08", "2024.01.09",
+                                         "2024.01.10"}));
+  ASSERT_EQ(matrix.values.size(), 10);
+
+  // Forward fill starts from the quote before the range and carries the
+  // Saturday quote into Monday; the last quote of a day wins.
+  const double* usd_eur = matrix.row(1);
+  EXPECT_EQ(usd_eur[0], 0.90);
+  EXPECT_EQ(usd_eur[1], 0.91);
+  EXPECT_EQ(usd_eur[2], 0.92);
+  EXPECT_EQ(usd_eur[3], 0.92);
+  EXPECT_EQ(usd_eur[4], 0.97);
+  EXPECT_TRUE(std::isnan(matrix.at(0, 0)));
+  EXPECT_EQ(matrix.at(0, 4), 1.27);
+
+  options.fill = GapFill::kLinear;
+  matrix = repo.Resample(options);
+  EXPECT_NEAR(matrix.at(1, 0), 0.905, 1e-12);
+  EXPECT_NEAR(matrix.at(1, 2), 0.92 + 0.05 * 2 / 4, 1e-12);
+  EXPECT_NEAR(matrix.at(1, 3), 0.92 + 0.05 * 3 / 4, 1e-12);
+  EXPECT_EQ(matrix.at(0, 3), 1.27);
+  EXPECT_TRUE(std::isnan(matrix.at(0, 4)));
+
+  options.fill = GapFill::kNaN;
+  options.calendar = ResampleCalendar::kAllDays;
+  options.pair_filter.currency1 = "USD";
+  matrix = repo.Resample(options);
+  ASSERT_EQ(matrix.rows(), 1);
+  ASSERT_EQ(matrix.columns(), 7);
+  EXPECT_TRUE(std::isnan(matrix.at(0, 0)));
+  EXPECT_EQ(matrix.at(0, 2), 0.92);
+  EXPECT_TRUE(std::isnan(matrix.at(0, 3)));
+
+  options.from = "2024.01.10";
+  options.to = "2024.01.04";
+  EXPECT_EQ(repo.Resample(options).columns(), 0);
+  options.to = "2024.13.01";
+  EXPECT_THROW(repo.Resample(options), InvalidDateException);
+}
+
+TEST(BatchCommandLineTest, ResampleWritesCsvMatrix) {
+  ofstream test_file("test_batch_resample.txt");
+  test_file << "USD EUR 0.90 2024.01.05\n";
+  test_file << "USD EUR 0.92 2024.01.09\n";
+  test_file << "GBP USD 1.27 2024.01.09\n";
+  test_file.close();
+
+  std::ostringstream out;
+  std::ostringstream err;
+  BatchOptions options = BatchCommandLine::Parse(
+      {"--load", "test_batch_resample.txt", "--resample", "2024.01.05",
+       "2024.01.09", "--fill", "linear"});
+  EXPECT_EQ(BatchCommandLine::Run(options, out, err),
+            BatchCommandLine::kExitOk);
+  EXPECT_EQ(out.str(),
+            "date,GBP/USD,USD/EUR\n"
+            "2024.01.05,,0.9000\n"
+            "2024.01.08,,0.9150\n"
+            "2024.01.09,1.2700,0.9200\n");
+
+  EXPECT_THROW(BatchCommandLine::Parse({"--fill", "cubic"}),
+               invalid_argument);
+  remove("test_batch_resample.txt");
+}
+
+TEST(CurrencyConverterTest, ResolvesEachGroupOnceByRoute) {
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  repo.Add(CurrencyRate("USD", "EUR", 0.90, "2024.01.02"));
+  repo.Add(CurrencyRate("GBP", "USD", 1.25, "2024.01.02"));
+  repo.Add(CurrencyRate("USD", "JPY", 140.0, "2024.01.02"));
+  CurrencyConverter converter(repo);
+
+  vector<double> amounts = {10, 20, 9, 100, 7, 5, 1, 3};
+  vector<string> from = {"USD", "USD", "EUR", "GBP", "CHF",
+                         "JPY", "EUR", "GBP"};
+  vector<string> to = {"EUR", "EUR", "USD", "EUR", "CHF",
+                       "GBP", "USD", "EUR"};
+  vector<string> dates(amounts.size(), "2024.01.02");
+  dates[6] = "2024.01.03";
+  vector<double> out(amounts.size());
+
+  ConversionStats stats = converter.Convert(amounts, from, to, dates,
+                                            out.data());
+  EXPECT_EQ(stats.rows, 8);
+  EXPECT_EQ(stats.groups, 6);
+  EXPECT_EQ(stats.direct, 2);
+  EXPECT_EQ(stats.inverse, 1);
+  EXPECT_EQ(stats.triangulated, 3);
+  EXPECT_EQ(stats.identity, 1);
+  EXPECT_EQ(stats.missing, 1);
+
+  EXPECT_DOUBLE_EQ(out[0], 9.0);
+  EXPECT_DOUBLE_EQ(out[1], 18.0);
+  EXPECT_DOUBLE_EQ(out[2], 10.0);
+  EXPECT_DOUBLE_EQ(out[3], 100 * 1.25 * 0.90);
+  EXPECT_EQ(out[4], 7.0);
+  EXPECT_DOUBLE_EQ(out[5], 5 / 140.0 / 1.25);
+  EXPECT_TRUE(std::isnan(out[6]));
+  EXPECT_DOUBLE_EQ(out[7], 3 * 1.25 * 0.90);
+
+  ConversionRoute route = ConversionRoute::kNone;
+  EXPECT_TRUE(converter.ResolveRate("EUR", "USD", "2024.01.02", &route));
+  EXPECT_EQ(route, ConversionRoute::kInverse);
+  EXPECT_FALSE(converter.ResolveRate("EUR", "CHF", "2024.01.02", &route));
+  EXPECT_EQ(route, ConversionRoute::kNone);
+
+  ConversionOptions options;
+  options.pivots.clear();
+  EXPECT_FALSE(CurrencyConverter(repo, options)
+                   .ResolveRate("GBP", "EUR", "2024.01.02"));
+}
+
+TEST(CurrencyConverterTest, SplitsLargeBatchesAcrossTasks) {
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  for (int day = 1; day <= 9; ++day) {
+    string date = "2024.03.0" + std::to_string(day);
+    repo.Add(CurrencyRate("USD", "EUR", 0.90 + day / 100.0, date));
+    repo.Add(CurrencyRate("USD", "GBP", 0.80 + day / 100.0, date));
+  }
+
+  vector<double> amounts;
+  vector<string> from;
+  vector<string> to;
+  vector<string> dates;
+  for (int i = 0; i < 1000; ++i) {
+    amounts.push_back(i * 0.5);
+    from.push_back(i % 3 == 0 ? "EUR" : "USD");
+    to.push_back(i % 2 == 0 ? "GBP" : "EUR");
+    dates.push_back("2024.03.0" + std::to_string(1 + i % 9));
+  }
+
+  ConversionOptions options;
+  options.rows_per_task = 7;
+  options.max_threads = 4;
+  CurrencyConverter converter(repo, options);
+  vector<double> out(amounts.size());
+  ConversionStats stats = converter.Convert(amounts, from, to, dates,
+                                            out.data());
+  EXPECT_EQ(stats.rows, 1000);
+  EXPECT_EQ(stats.missing, 0);
+  EXPECT_EQ(stats.direct + stats.inverse + stats.triangulated + stats.identity,
+            1000);
+  for (size_t i = 0; i < amounts.size(); ++i) {
+    std::optional<double> rate =
+        converter.ResolveRate(from[i], to[i], dates[i]);
+    ASSERT_TRUE(rate);
+    EXPECT_DOUBLE_EQ(out[i], amounts[i] * *rate);
+  }
+
+  from.pop_back();
+  EXPECT_THROW(converter.Convert(amounts, from, to, dates, out.data()),
+               std::invalid_argument);
+}
+
+TEST(KllSketchTest, TracksQuantilesWithinErrorAndMerges) {
+  KllSketch small;
+  for (int value = 1; value <= 5; ++value) {
+    small.Update(value);
+  }
+  EXPECT_EQ(small.Quantile(0.5), 3.0);
+  EXPECT_EQ(small.Quantile(0.0), 1.0);
+  EXPECT_EQ(small.Quantile(1.0), 5.0);
+  EXPECT_TRUE(std::isnan(KllSketch().Quantile(0.5)));
+
+  // Two halves of a shuffled 0..99999 sequence, merged.
+  constexpr int kCount = 100000;
+  vector<int> values(kCount);
+  for (int i = 0; i < kCount; ++i) {
+    values[i] = static_cast<int>((static_cast<int64_t>(i) * 7919) % kCount);
+  }
+  KllSketch first;
+  KllSketch second;
+  for (int i = 0; i < kCount; ++i) {
+    (i % 2 == 0 ? first : second).Update(values[i]);
+  }
+  EXPECT_LT(first.retained(), 1000);
+  first.Merge(second);
+  EXPECT_EQ(first.count(), kCount);
+  EXPECT_EQ(first.min(), 0.0);
+  EXPECT_EQ(first.max(), kCount - 1.0);
+  EXPECT_LT(first.retained(), 1000);
+
+  vector<double> fractions = {0.01, 0.25, 0.5, 0.75, 0.99};
+  vector<double> quantiles = first.Quantiles(fractions);
+  for (size_t i = 0; i < fractions.size(); ++i) {
+    EXPECT_NEAR(quantiles[i], fractions[i] * kCount, 0.02 * kCount);
+    EXPECT_EQ(quantiles[i], first.Quantile(fractions[i]));
+  }
+
+  EXPECT_THROW(KllSketch(4), std::invalid_argument);
+  EXPECT_THROW(first.Merge(KllSketch(100)), std::invalid_argument);
+}
+
+TEST(MemoryCurrencyRateRepositoryTest, QuantileSketchesMergeBuckets) {
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  repo.Add(CurrencyRate("USD", "EUR", 0.80, "2024.01.31"));
+  EXPECT_FALSE(repo.GetQuantileSketch("USD", "EUR"));
+
+  repo.EnableQuantileSketches(AggregationBucket::kMonth);
+  for (int day = 1; day <= 9; ++day) {
+    string suffix = ".0" + std::to_string(day);
+    repo.Add(CurrencyRate("USD", "EUR", 0.90 + day / 1000.0,
+                          "2024.02" + suffix));
+    repo.Add(CurrencyRate("USD", "EUR", 1.00 + day / 1000.0,
+                          "2024.03" + suffix));
+  }
+
+  auto all = repo.GetQuantileSketch("USD", "EUR");
+  ASSERT_TRUE(all);
+  EXPECT_EQ(all->count(), 19);
+  EXPECT_EQ(all->min(), 0.80);
+  EXPECT_EQ(all->Quantile(0.5), 0.909);
+
+  DateRange march;
+  march.from = "2024.03.05";
+  march.to = "2024.03.06";
+  auto whole_month = repo.GetQuantileSketch("USD", "EUR", march);
+  ASSERT_TRUE(whole_month);
+  EXPECT_EQ(whole_month->count(), 9);
+  EXPECT_EQ(whole_month->min(), 1.001);
+  EXPECT_EQ(whole_month->Quantile(0.5), 1.005);
+
+  DateRange later;
+  later.from = "2024.04.01";
+  EXPECT_FALSE(repo.GetQuantileSketch("USD", "EUR", later));
+  EXPECT_FALSE(repo.GetQuantileSketch("EUR", "USD"));
+  later.from = "2024.02.30";
+  EXPECT_THROW(repo.GetQuantileSketch("USD", "EUR", later),
+               InvalidDateException);
+
+  MemoryUsageReport with_sketches = repo.MemoryUsage();
+  repo.DisableQuantileSketches();
+  EXPECT_LT(repo.MemoryUsage().caches, with_sketches.caches);
+  EXPECT_FALSE(repo.GetQuantileSketch("USD", "EUR"));
+}
+
+TEST(ArbitrageDetectorTest, FindsInconsistentCyclesPerDate) {
+  MemoryCurrencyRateRepository repo(
+      CurrencyRateParserFactory::CreateDefaultParser());
+  repo.Add(CurrencyRate("USD", "EUR", 0.90, "2024.01.02"));
+  repo.Add(CurrencyRate("EUR", "GBP", 0.85, "2024.01.02"));
+  repo.Add(CurrencyRate("GBP", "USD", 1.40, "2024.01.02"));
+  // Consistent once the later USD/EUR quote replaces the earlier one.
+  repo.Add(CurrencyRate("USD", "EUR", 0.95, "2024.01.03"));
+  repo.Add(CurrencyRate("EUR", "GBP", 0.50, "2024.01.03"));
+  repo.Add(CurrencyRate("GBP", "USD", 2.50, "2024.01.03"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.80, "2024.01.03"));
+  repo.Add(CurrencyRate("USD", "JPY", 150.0, "2024.01.03"));
+  // Both orientations quoted and disagreeing.
+  repo.Add(CurrencyRate("EUR", "USD", 1.20, "2024.01.04"));
+  repo.Add(CurrencyRate("USD", "EUR", 0.90, "2024.01.04"));
+  // Off by 0.035% only.
+  repo.Add(CurrencyRate("USD", "EUR", 0.90, "2024.01.05"));
+  repo.Add(CurrencyRate("EUR", "USD", 1.1115, "2024.01.05"));
+
+  vector<ArbitrageCycle> cycles = repo.DetectArbitrage();
+  ASSERT_EQ(cycles.size(), 2);
+  EXPECT_EQ(cycles[0].date, "2024.01.02");
+  EXPECT_EQ(cycles[0].currencies, vector<string>({"EUR", "GBP", "USD"}));
+  EXPECT_NEAR(cycles[0].product, 0.90 * 0.85 * 1.40, 1e-12);
+  EXPECT_EQ(cycles[0].ToString(),
+            "2024.01.02 | EUR -> GBP -> USD -> EUR | 1.071000");
+  EXPECT_EQ(cycles[1].date, "2024.01.04");
+  EXPECT_EQ(cycles[1].currencies, vector<string>({"EUR", "USD"}));
+  EXPECT_NEAR(cycles[1].product, 1.08, 1e-12);
+
+  ArbitrageOptions options;
+  options.threshold = 1e-4;
+  options.date_range.from = "2024.01.03";
+  options.max_threads = 2;
+  cycles = repo.DetectArbitrage(options);
+  ASSERT_EQ(cycles.size(), 2);
+  EXPECT_EQ(cycles[0].date, "2024.01.04");
+  EXPECT_EQ(cycles[1].date, "2024.01.05");
+  EXPECT_NEAR(cycles[1].product, 0.90 * 1.1115, 1e-12);
+
+  options.max_cycles_per_date = 0;
+  EXPECT_TRUE(repo.DetectArbitrage(options).empty());
+  options.threshold = 0.0;
+  EXPECT_THROW(repo.DetectArbitrage(options), std::invalid_argument);
+}
+
+TEST(BatchCommandLineTest, ArbitrageListsCycles) {
+  ofstream test_file("test_batch_arbitrage.txt");
+  test_file << "USD EUR 0.90 2024.01.02\n";
+  test_file << "EUR GBP 0.85 2024.01.02\n";
+  test_file << "GBP USD 1.40 2024.01.02\n";
+  test_file << "USD EUR 0.90 2024.01.03\n";
+  test_file.close();
+
+  std::ostringstream out;
+  std::ostringstream err;
+  BatchOptions options = BatchCommandLine::Parse(
+      {"--load", "test_batch_arbitrage.txt", "--arbitrage", "0.01"});
+  EXPECT_EQ(BatchCommandLine::Run(options, out, err),
+            BatchCommandLine::kExitOk);
+  EXPECT_EQ(out.str(), "2024.01.02 | EUR -> GBP -> USD -> EUR | 1.071000\n");
+  EXPECT_EQ(err.str(), "1 inconsistent cycles\n");
+
+  EXPECT_THROW(BatchCommandLine::Parse({"--arbitrage", "0"}),
+               invalid_argument);
+  remove("test_batch_arbitrage.txt");
+}
+
 int main(int argc, char** argv) {
   system("chcp 65001 > nul");
   ::testing::InitGoogleTest(&argc, argv);